@@ -11,7 +11,7 @@ echo "   $ ./bin/terminal_app"
 echo ""
 
 echo "2. GRAPHICAL GUI (X11):"
-echo "   $ ./gui_terminal"
+echo "   $ make gui && ./bin/gui_terminal"
 echo ""
 
 echo "════════════════════════════════════════════════════════════════"
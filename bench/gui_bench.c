@@ -0,0 +1,253 @@
+// gui_bench.c
+// Headless benchmark for the GUI output pipeline. Replays output streams
+// through the same terminal model (vt.c) and row layout (layout.c) the X11
+// GUI uses, frame by frame, without a display.
+//
+// Usage:
+//   bin/gui_bench                 built-in synthetic streams
+//   bin/gui_bench FILE...         recorded streams (raw child output)
+//   bin/gui_bench --dump DIR      write the synthetic streams to DIR/*.raw
+//                                 (for end-to-end runs: gui_terminal --replay)
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "../src/gui/vt.h"
+#include "../src/gui/layout.h"
+
+#define ROWS 23                  /* default 800x500 window */
+#define COLS 95
+#define SCROLLBACK_LINES 1000
+#define FRAME_BYTES 65536        /* one reader batch per frame */
+#define STREAM_BYTES (16 * 1024 * 1024)
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} Stream;
+
+static void stream_append(Stream *s, const char *data, size_t n) {
+    if (s->len + n > s->cap) {
+        s->cap = (s->len + n) * 2;
+        s->data = realloc(s->data, s->cap);
+        if (!s->data) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    memcpy(s->data + s->len, data, n);
+    s->len += n;
+}
+
+static void stream_add(Stream *s, const char *text) {
+    stream_append(s, text, strlen(text));
+}
+
+/* Deterministic pseudo-random numbers so runs are comparable */
+static unsigned int rng_state = 12345;
+static unsigned int rng(void) {
+    rng_state = rng_state * 1103515245u + 12345u;
+    return (rng_state >> 16) & 0x7fff;
+}
+
+/* `ls --color` style: colored names in columns */
+static void gen_colored_ls(Stream *s) {
+    static const char *colors[] = { "01;34", "01;32", "0", "01;36", "01;31" };
+    char line[512];
+    while (s->len < STREAM_BYTES) {
+        line[0] = '\0';
+        for (int c = 0; c < 5; c++) {
+            char item[96];
+            snprintf(item, sizeof(item), "\033[%sm%-14.*s\033[0m ",
+                     colors[rng() % 5], 6 + (int)(rng() % 8), "entry_name_with_suffix");
+            strcat(line, item);
+        }
+        strcat(line, "\n");
+        stream_add(s, line);
+    }
+}
+
+/* gcc-style diagnostics with colored severities and caret lines */
+static void gen_compiler_log(Stream *s) {
+    char line[512];
+    while (s->len < STREAM_BYTES) {
+        int ln = rng() % 2000;
+        snprintf(line, sizeof(line),
+                 "\033[01msrc/module_%u.c:%d:%u:\033[m \033[01;35mwarning: \033[m"
+                 "unused variable '\033[01mtmp%u\033[m' [\033[01;35m-Wunused-variable\033[m]\n"
+                 " %4d |     int tmp%u = compute(%u);\n"
+                 "      |         \033[01;35m^~~~\033[m\n",
+                 rng() % 40, ln, rng() % 30, rng() % 100, ln, rng() % 100, rng());
+        stream_add(s, line);
+    }
+}
+
+/* Carriage-return progress bar redrawn in place, with erase-line */
+static void gen_progress(Stream *s) {
+    char line[256];
+    int pct = 0;
+    while (s->len < STREAM_BYTES) {
+        char bar[41];
+        int fill = pct * 40 / 100;
+        memset(bar, '#', fill);
+        memset(bar + fill, ' ', 40 - fill);
+        bar[40] = '\0';
+        snprintf(line, sizeof(line), "\r\033[32m[%s]\033[0m %3d%% %u/50000 files\033[K",
+                 bar, pct, rng() % 50000);
+        stream_add(s, line);
+        if (++pct > 100) {
+            pct = 0;
+            stream_add(s, "\n");
+        }
+    }
+}
+
+/* Plain text, like `cat` of a source file */
+static void gen_plain(Stream *s) {
+    static const char *words[] = { "static", "int", "return", "buffer", "if", "(", ")",
+                                   "{", "}", "state->len", "=", "0;", "while", "char" };
+    char line[512];
+    while (s->len < STREAM_BYTES) {
+        int n = 3 + rng() % 12;
+        line[0] = '\0';
+        for (int w = 0; w < n; w++) {
+            strcat(line, words[rng() % 14]);
+            strcat(line, " ");
+        }
+        strcat(line, "\n");
+        stream_add(s, line);
+    }
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Replay a stream: parse-only throughput, then frame-by-frame parse+layout */
+static void run_stream(const char *name, const Stream *s) {
+    VtTerm term;
+    static RowLayout lay;
+
+    /* 1. Parser throughput */
+    if (vt_init(&term, ROWS, COLS, SCROLLBACK_LINES) != 0) {
+        fprintf(stderr, "gui_bench: cannot allocate terminal\n");
+        exit(1);
+    }
+    term.newline_mode = 1;
+    double t0 = now_sec();
+    vt_feed(&term, s->data, s->len);
+    double parse = now_sec() - t0;
+    vt_free(&term);
+
+    /* 2. Frames: one batch fed, then every dirty row laid out */
+    vt_init(&term, ROWS, COLS, SCROLLBACK_LINES);
+    term.newline_mode = 1;
+    int nframes = (int)((s->len + FRAME_BYTES - 1) / FRAME_BYTES);
+    double *frame_us = malloc(sizeof(double) * nframes);
+    long runs = 0;
+    double total = 0;
+    for (int f = 0; f < nframes; f++) {
+        size_t off = (size_t)f * FRAME_BYTES;
+        size_t n = s->len - off < FRAME_BYTES ? s->len - off : FRAME_BYTES;
+        double f0 = now_sec();
+        vt_feed(&term, s->data + off, n);
+        for (int r = 0; r < term.rows; r++) {
+            if (!term.dirty[r]) continue;
+            layout_row(&lay, vt_view_line(&term, 0, r), term.cols);
+            runs += lay.ntext + lay.nbg;
+        }
+        memset(term.dirty, 0, term.rows);
+        frame_us[f] = (now_sec() - f0) * 1e6;
+        total += frame_us[f];
+    }
+    vt_free(&term);
+
+    qsort(frame_us, nframes, sizeof(double), cmp_double);
+    double mb = s->len / (1024.0 * 1024.0);
+    printf("%-16s %8.1f %10.1f %10.1f %8d %10.1f %10.1f %10.1f\n",
+           name, mb, parse > 0 ? mb / parse : 0.0, total > 0 ? mb / (total / 1e6) : 0.0,
+           nframes, total / nframes, frame_us[(int)(nframes * 0.99)], (double)runs / nframes);
+    free(frame_us);
+}
+
+static int load_file(const char *path, Stream *s) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        stream_append(s, buf, n);
+    }
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    struct {
+        const char *name;
+        void (*gen)(Stream *);
+    } synthetic[] = {
+        { "colored-ls", gen_colored_ls },
+        { "compiler-log", gen_compiler_log },
+        { "progress-bar", gen_progress },
+        { "plain-text", gen_plain },
+    };
+    const int nsynthetic = sizeof(synthetic) / sizeof(synthetic[0]);
+
+    if (argc == 3 && strcmp(argv[1], "--dump") == 0) {
+        mkdir(argv[2], 0755);
+        for (int i = 0; i < nsynthetic; i++) {
+            Stream s = { 0 };
+            char path[1024];
+            synthetic[i].gen(&s);
+            snprintf(path, sizeof(path), "%s/%s.raw", argv[2], synthetic[i].name);
+            FILE *f = fopen(path, "wb");
+            if (!f || fwrite(s.data, 1, s.len, f) != s.len) {
+                perror(path);
+                return 1;
+            }
+            fclose(f);
+            printf("%s\n", path);
+            free(s.data);
+        }
+        return 0;
+    }
+
+    printf("grid %dx%d, %d bytes per frame\n", COLS, ROWS, FRAME_BYTES);
+    printf("%-16s %8s %10s %10s %8s %10s %10s %10s\n",
+           "stream", "MB", "parse MB/s", "frame MB/s", "frames", "avg us", "p99 us", "runs/frame");
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            Stream s = { 0 };
+            if (load_file(argv[i], &s) == 0 && s.len > 0) {
+                const char *base = strrchr(argv[i], '/');
+                run_stream(base ? base + 1 : argv[i], &s);
+            }
+            free(s.data);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < nsynthetic; i++) {
+        Stream s = { 0 };
+        synthetic[i].gen(&s);
+        run_stream(synthetic[i].name, &s);
+        free(s.data);
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+// serve_load.c
+// Load test for terminal_app --serve. Starts a daemon on a private socket,
+// then runs CLIENTS concurrent sessions (one thread each) that every
+// issue ROUNDS commands and check the output they get back:
+//
+//   cd DIR            each session has its own directory with a marker file
+//   ls                must list this session's marker (cwd isolation)
+//   count MARKER      a builtin run inside the daemon
+//   echo ID           an external command
+//
+// One session then runs the same commands alone, and the same ls/echo jobs
+// are run the old way, one fresh terminal_app process per job, for
+// comparison. Prints throughput and latency
+// percentiles; exits non-zero if any reply is wrong.
+//
+// Usage: bin/serve_load [terminal_app] [clients] [rounds]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "../include/server.h"
+
+#define DEFAULT_CLIENTS 300
+#define DEFAULT_ROUNDS 5
+#define CMDS_PER_ROUND 3         /* ls, count, echo (cd is set-up) */
+
+static const char *app = "bin/terminal_app";
+static char sock_path[108];
+static char base_dir[64];
+static int rounds = DEFAULT_ROUNDS;
+
+typedef struct {
+    int id;
+    double *latency;     /* one per command */
+    int count;
+    int errors;
+} Client;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Send one command with stdout on a pipe; returns status, output in out */
+static int run(int fd, const char *command, char *out, size_t size) {
+    char msg[4096];
+    ServeHeader hdr = { SERVE_RUN, 0 };
+    size_t len = sizeof(hdr) + strlen(command) + 1;
+    memcpy(msg, &hdr, sizeof(hdr));
+    memcpy(msg + sizeof(hdr), command, strlen(command) + 1);
+
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) != 0) return -1;
+    int null_fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+    int stdio[3] = { null_fd, pfd[1], null_fd };
+
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    memset(cbuf, 0, sizeof(cbuf));
+    struct iovec iov = { msg, len };
+    struct msghdr mh = { 0 };
+    mh.msg_iov = &iov;
+    mh.msg_iovlen = 1;
+    mh.msg_control = cbuf;
+    mh.msg_controllen = sizeof(cbuf);
+    struct cmsghdr *c = CMSG_FIRSTHDR(&mh);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(c), stdio, sizeof(stdio));
+
+    int status = -1;
+    if (sendmsg(fd, &mh, 0) >= 0) {
+        close(pfd[1]);
+        pfd[1] = -1;
+        /* Output is small: the daemon's reply comes after all of it */
+        size_t got = 0;
+        ssize_t n;
+        while (got + 1 < size && (n = read(pfd[0], out + got, size - 1 - got)) > 0) got += (size_t)n;
+        out[got] = '\0';
+        if (recv(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) && hdr.type == SERVE_STATUS) {
+            status = hdr.arg;
+        }
+    }
+    if (pfd[1] >= 0) close(pfd[1]);
+    close(pfd[0]);
+    close(null_fd);
+    return status;
+}
+
+static void *client_main(void *arg) {
+    Client *cl = arg;
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    strcpy(addr.sun_path, sock_path);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        cl->errors++;
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    char msg[256], out[4096], cmd[256], count_cmd[256], echo_cmd[64], want[64];
+    ServeHeader hdr = { SERVE_HELLO, 0 };
+    memcpy(msg, &hdr, sizeof(hdr));
+    size_t len = sizeof(hdr);
+    len += (size_t)sprintf(msg + len, "/") + 1;
+    len += (size_t)sprintf(msg + len, "PATH=/usr/bin:/bin") + 1;
+    send(fd, msg, len, 0);
+
+    snprintf(cmd, sizeof(cmd), "cd %s/c%d", base_dir, cl->id);
+    if (run(fd, cmd, out, sizeof(out)) != 0) cl->errors++;
+
+    snprintf(want, sizeof(want), "marker%d", cl->id);
+    snprintf(count_cmd, sizeof(count_cmd), "count %s", want);
+    snprintf(echo_cmd, sizeof(echo_cmd), "echo %d", cl->id);
+    const char *cmds[CMDS_PER_ROUND] = { "ls", count_cmd, echo_cmd };
+    for (int r = 0; r < rounds; r++) {
+        for (int k = 0; k < CMDS_PER_ROUND; k++) {
+            double t0 = now();
+            int st = run(fd, cmds[k], out, sizeof(out));
+            cl->latency[cl->count++] = now() - t0;
+            int ok = st == 0;
+            if (k == 0) ok = ok && strncmp(out, want, strlen(want)) == 0 && out[strlen(want)] == '\n';
+            if (k == 1) ok = ok && strstr(out, want) != NULL;
+            if (k == 2) ok = ok && atoi(out) == cl->id;
+            if (!ok) cl->errors++;
+        }
+    }
+    close(fd);
+    return NULL;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, double *lat, int n, double wall) {
+    qsort(lat, (size_t)n, sizeof(double), cmp_double);
+    printf("%-22s %7d %9.0f %9.2f %9.2f %9.2f\n", name, n, n / wall,
+           lat[n / 2] * 1e3, lat[n * 99 / 100] * 1e3, lat[n - 1] * 1e3);
+}
+
+/* One fresh terminal_app per job, fed the command on stdin */
+static double spawn_job(const char *command) {
+    double t0 = now();
+    int pfd[2];
+    if (pipe(pfd) != 0) return -1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(pfd[0], STDIN_FILENO);
+        close(pfd[0]);
+        close(pfd[1]);
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execl(app, app, (char *)NULL);
+        _exit(127);
+    }
+    close(pfd[0]);
+    if (write(pfd[1], command, strlen(command)) < 0 || write(pfd[1], "\n", 1) < 0) perror("write");
+    close(pfd[1]);
+    waitpid(pid, NULL, 0);
+    return now() - t0;
+}
+
+int main(int argc, char **argv) {
+    int clients = DEFAULT_CLIENTS;
+    if (argc > 1) app = argv[1];
+    if (argc > 2) clients = atoi(argv[2]);
+    if (argc > 3) rounds = atoi(argv[3]);
+    if (clients < 1 || rounds < 1) {
+        fprintf(stderr, "Usage: %s [terminal_app] [clients] [rounds]\n", argv[0]);
+        return 2;
+    }
+
+    snprintf(base_dir, sizeof(base_dir), "/tmp/serve_load.%d", (int)getpid());
+    snprintf(sock_path, sizeof(sock_path), "%s/sock", base_dir);
+    mkdir(base_dir, 0700);
+    for (int i = 0; i < clients; i++) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/c%d", base_dir, i);
+        mkdir(path, 0700);
+        snprintf(path, sizeof(path), "%s/c%d/marker%d", base_dir, i, i);
+        FILE *f = fopen(path, "w");
+        if (f) {
+            fprintf(f, "session %d\n", i);
+            fclose(f);
+        }
+    }
+
+    pid_t daemon = fork();
+    if (daemon == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        execl(app, app, "--serve", sock_path, (char *)NULL);
+        _exit(127);
+    }
+    for (int i = 0; i < 500 && access(sock_path, F_OK) != 0; i++) usleep(10000);
+
+    Client *cls = calloc((size_t)clients, sizeof(Client));
+    pthread_t *tids = calloc((size_t)clients, sizeof(pthread_t));
+    int per = rounds * CMDS_PER_ROUND;
+    double *lat = calloc((size_t)clients * (size_t)per, sizeof(double));
+    for (int i = 0; i < clients; i++) {
+        cls[i].id = i;
+        cls[i].latency = lat + (size_t)i * (size_t)per;
+    }
+
+    printf("%d concurrent sessions x %d rounds (%d commands each)\n", clients, rounds, per);
+    printf("%-22s %7s %9s %9s %9s %9s\n", "mode", "jobs", "jobs/s", "p50 ms", "p99 ms", "max ms");
+
+    double t0 = now();
+    for (int i = 0; i < clients; i++) pthread_create(&tids[i], NULL, client_main, &cls[i]);
+    int errors = 0, total = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(tids[i], NULL);
+        errors += cls[i].errors;
+        total += cls[i].count;
+    }
+    double wall = now() - t0;
+    /* Pack the latencies of every session together */
+    int k = 0;
+    for (int i = 0; i < clients; i++) {
+        for (int j = 0; j < cls[i].count; j++) lat[k++] = cls[i].latency[j];
+    }
+    if (total > 0) report("daemon, concurrent", lat, total, wall);
+
+    /* One session at a time: the per-job cost without queueing */
+    Client single = { 0, lat, 0, 0 };
+    t0 = now();
+    client_main(&single);
+    errors += single.errors;
+    if (single.count > 0) report("daemon, 1 session", lat, single.count, now() - t0);
+
+    /* Baseline: a fresh process per job, as automation does today */
+    int spawn_jobs = clients < 100 ? clients : 100;
+    double *slat = calloc((size_t)spawn_jobs, sizeof(double));
+    t0 = now();
+    for (int i = 0; i < spawn_jobs; i++) slat[i] = spawn_job(i % 2 ? "echo 1" : "ls /");
+    report("process per job", slat, spawn_jobs, now() - t0);
+
+    kill(daemon, SIGTERM);
+    waitpid(daemon, NULL, 0);
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", base_dir);
+    if (system(cmd) != 0) fprintf(stderr, "serve_load: could not remove %s\n", base_dir);
+
+    printf("%d wrong replies\n", errors);
+    free(cls);
+    free(tids);
+    free(lat);
+    free(slat);
+    return errors ? 1 : 0;
+}
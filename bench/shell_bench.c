@@ -0,0 +1,256 @@
+// shell_bench.c
+// Benchmark suite for the shell core, linked against the same objects as
+// terminal_app. Each case runs warmup iterations, then REPS timed
+// repetitions; the report is JSON (median, min and max per case) so two
+// builds can be compared with a script or a diff.
+//
+//   parse            parse_line + node_free per line, for typical lines
+//   execute_noop     execute_command of in-process lines (cached parse)
+//   spawn_true       execute_command("/bin/true"): fork + exec + wait
+//   pipeline_N       cat FILE | cat ... > /dev/null with N stages, MB/s
+//   pipeline_4_*     the 4-stage pipeline with PIPE_BUFFER=1M, with
+//                    PIPE_AFFINITY=adjacent, and with both (pipe_sched.h)
+//   history_append   add_command_to_history (includes the file append)
+//   count            the count builtin over a generated file, MB/s
+//
+// Usage: bin/shell_bench [-o out.json] [-r reps] [-s file_mb]
+// Command output goes to /dev/null; HOME points at a scratch directory so
+// history appends do not touch the real history file.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "executor.h"
+#include "parser.h"
+#include "interp.h"
+
+#ifndef BENCH_BUILD
+#define BENCH_BUILD "default"
+#endif
+
+#define DEFAULT_REPS 7
+#define DEFAULT_FILE_MB 32
+#define MAX_REPS 101
+
+typedef struct {
+    const char *name;
+    const char *unit;    /* what one result measures */
+    double values[MAX_REPS];
+    int reps;
+} Result;
+
+static int reps = DEFAULT_REPS;
+static size_t file_size;
+static char scratch[64];
+static char data_file[128];
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void emit(FILE *out, Result *r, int last) {
+    qsort(r->values, (size_t)r->reps, sizeof(double), cmp_double);
+    fprintf(out, "    {\"name\": \"%s\", \"unit\": \"%s\", \"reps\": %d, "
+                 "\"median\": %.3f, \"min\": %.3f, \"max\": %.3f}%s\n",
+            r->name, r->unit, r->reps, r->values[r->reps / 2], r->values[0],
+            r->values[r->reps - 1], last ? "" : ",");
+}
+
+/* ---- cases: each returns one measurement ---- */
+
+static const char *const parse_lines[] = {
+    "ls -la /tmp",
+    "cat file.txt | grep error | sort | uniq -c > out.txt",
+    "make && ./bin/app --flag value || echo failed",
+    "for f in *.c src/*.h; do count $f; done",
+    "i=0; while ((i < 10)); do x=$((x + i * 2)); ((i++)); done; echo $x",
+    "if test -d build; then cd build; elif [ -f Makefile ]; then make; else echo none; fi",
+    "echo $(date) `whoami` ${HOME}/notes <<< text",
+};
+#define NUM_PARSE_LINES ((int)(sizeof(parse_lines) / sizeof(parse_lines[0])))
+
+/* ns per parsed line */
+static double bench_parse(void) {
+    const int rounds = 20000;
+    double t0 = now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < NUM_PARSE_LINES; i++) node_free(parse_line(parse_lines[i]));
+    }
+    return (now() - t0) / (rounds * NUM_PARSE_LINES) * 1e9;
+}
+
+/* ns per executed line that stays in the shell process */
+static double bench_execute_noop(void) {
+    static const char *const lines[] = { "x=1", "true", "((y = x + 1))", ": && true" };
+    const int rounds = 20000;
+    double t0 = now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < 4; i++) execute_command(lines[i]);
+    }
+    return (now() - t0) / (rounds * 4) * 1e9;
+}
+
+/* us per external command */
+static double bench_spawn(void) {
+    const int rounds = 200;
+    double t0 = now();
+    for (int r = 0; r < rounds; r++) execute_command("/bin/true");
+    return (now() - t0) / rounds * 1e6;
+}
+
+/* MB/s through an N-stage pipeline */
+static double bench_pipeline(int stages) {
+    char line[512];
+    size_t len = (size_t)snprintf(line, sizeof(line), "cat %s", data_file);
+    for (int i = 1; i < stages; i++) len += (size_t)snprintf(line + len, sizeof(line) - len, " | cat");
+    snprintf(line + len, sizeof(line) - len, " > /dev/null");
+    double t0 = now();
+    execute_command(line);
+    return file_size / (now() - t0) / 1e6;
+}
+
+/* MB/s through a 4-stage pipeline under PIPE_* settings */
+static double bench_pipeline_sched(int which) {
+    if (which & 1) shell_var_set("PIPE_BUFFER", "1M", 0);
+    if (which & 2) shell_var_set("PIPE_AFFINITY", "adjacent", 0);
+    double mbs = bench_pipeline(4);
+    shell_var_unset("PIPE_BUFFER");
+    shell_var_unset("PIPE_AFFINITY");
+    return mbs;
+}
+
+/* ns per history entry (memory + persisted file append) */
+static double bench_history(void) {
+    /* The history holds 50 entries; start empty so every add is stored */
+    const int entries = 50, rounds = 20;
+    double total = 0;
+    for (int r = 0; r < rounds; r++) {
+        history_set(NULL, 0);
+        double t0 = now();
+        for (int i = 0; i < entries; i++) add_command_to_history("make -j8 && ./bin/terminal_app");
+        total += now() - t0;
+    }
+    history_set(NULL, 0);
+    return total / (entries * rounds) * 1e9;
+}
+
+/* MB/s for the count builtin */
+static double bench_count(void) {
+    char *args[] = { "count", data_file, NULL };
+    double t0 = now();
+    exec_count(args);
+    return file_size / (now() - t0) / 1e6;
+}
+
+/* ---- driver ---- */
+
+static void run_case(Result *r, const char *name, const char *unit, double (*fn)(int), int arg) {
+    r->name = name;
+    r->unit = unit;
+    r->reps = reps;
+    fn(arg);             /* warmup: page cache, parse cache, allocator */
+    for (int i = 0; i < reps; i++) r->values[i] = fn(arg);
+}
+
+static double parse_case(int arg) { (void)arg; return bench_parse(); }
+static double noop_case(int arg) { (void)arg; return bench_execute_noop(); }
+static double spawn_case(int arg) { (void)arg; return bench_spawn(); }
+static double history_case(int arg) { (void)arg; return bench_history(); }
+static double count_case(int arg) { (void)arg; return bench_count(); }
+
+static int make_data_file(size_t mb) {
+    snprintf(data_file, sizeof(data_file), "%s/data.txt", scratch);
+    FILE *f = fopen(data_file, "w");
+    if (f == NULL) return -1;
+    static const char *const words[] = { "alpha", "beta", "gamma", "delta", "epsilon", "zeta" };
+    unsigned seed = 1;
+    size_t written = 0;
+    while (written < mb << 20) {
+        char line[128];
+        int n = 0, nw = 4 + (int)(seed % 8);
+        for (int w = 0; w < nw; w++) {
+            seed = seed * 1103515245u + 12345u;
+            n += snprintf(line + n, sizeof(line) - (size_t)n, "%s%s", w ? " " : "", words[(seed >> 16) % 6]);
+        }
+        line[n++] = '\n';
+        fwrite(line, 1, (size_t)n, f);
+        written += (size_t)n;
+    }
+    file_size = written;
+    return fclose(f);
+}
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    size_t file_mb = DEFAULT_FILE_MB;
+    int opt;
+    while ((opt = getopt(argc, argv, "o:r:s:")) != -1) {
+        if (opt == 'o') out_path = optarg;
+        else if (opt == 'r') reps = atoi(optarg);
+        else if (opt == 's') file_mb = (size_t)atol(optarg);
+        else {
+            fprintf(stderr, "Usage: %s [-o out.json] [-r reps] [-s file_mb]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (reps < 1 || reps > MAX_REPS || file_mb < 1) {
+        fprintf(stderr, "%s: reps must be 1..%d and file_mb at least 1\n", argv[0], MAX_REPS);
+        return 2;
+    }
+
+    snprintf(scratch, sizeof(scratch), "/tmp/shell_bench.%d", (int)getpid());
+    if (mkdir(scratch, 0700) != 0 || make_data_file(file_mb) != 0) {
+        perror(scratch);
+        return 1;
+    }
+    setenv("HOME", scratch, 1);
+
+    /* Commands print to stdout: keep it for the report, send theirs away */
+    fflush(stdout);
+    int report_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+
+    Result results[11];
+    int n = 0;
+    run_case(&results[n++], "parse", "ns/line", parse_case, 0);
+    run_case(&results[n++], "execute_noop", "ns/line", noop_case, 0);
+    run_case(&results[n++], "spawn_true", "us/command", spawn_case, 0);
+    run_case(&results[n++], "pipeline_1", "MB/s", bench_pipeline, 1);
+    run_case(&results[n++], "pipeline_2", "MB/s", bench_pipeline, 2);
+    run_case(&results[n++], "pipeline_4", "MB/s", bench_pipeline, 4);
+    run_case(&results[n++], "pipeline_4_buf1m", "MB/s", bench_pipeline_sched, 1);
+    run_case(&results[n++], "pipeline_4_adjacent", "MB/s", bench_pipeline_sched, 2);
+    run_case(&results[n++], "pipeline_4_tuned", "MB/s", bench_pipeline_sched, 3);
+    run_case(&results[n++], "history_append", "ns/entry", history_case, 0);
+    run_case(&results[n++], "count", "MB/s", count_case, 0);
+
+    fflush(stdout);
+    FILE *out = out_path ? fopen(out_path, "w") : fdopen(report_fd, "w");
+    if (out == NULL) {
+        perror(out_path);
+        return 1;
+    }
+    fprintf(out, "{\n  \"build\": \"%s\",\n  \"file_mb\": %zu,\n  \"results\": [\n", BENCH_BUILD, file_mb);
+    for (int i = 0; i < n; i++) emit(out, &results[i], i == n - 1);
+    fprintf(out, "  ]\n}\n");
+    fclose(out);
+
+    char cmd[128];
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", scratch);
+    if (system(cmd) != 0) fprintf(stderr, "shell_bench: could not remove %s\n", scratch);
+    return 0;
+}
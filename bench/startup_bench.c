@@ -0,0 +1,131 @@
+// startup_bench.c
+// Startup cost of terminal_app, as automation sees it:
+//
+//   exec floor       /bin/true spawned the same way (process creation cost)
+//   -c true          spawn, run one builtin, exit (SPAWNS times)
+//   first prompt     spawn interactively (stdin/stdout on pipes) and wait
+//                    for the first "$ " prompt to appear
+//
+// Prints mean, p50, p99 and max per case in milliseconds.
+//
+// Usage: bin/startup_bench [terminal_app] [spawns]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define DEFAULT_SPAWNS 1000
+
+extern char **environ;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report(const char *name, double *lat, int n) {
+    double sum = 0;
+    for (int i = 0; i < n; i++) sum += lat[i];
+    qsort(lat, (size_t)n, sizeof(double), cmp_double);
+    printf("%-16s %6d %9.3f %9.3f %9.3f %9.3f\n", name, n, sum / n * 1e3,
+           lat[n / 2] * 1e3, lat[n * 99 / 100] * 1e3, lat[n - 1] * 1e3);
+}
+
+/* Spawn argv with stdin and stdout on /dev/null and wait; returns seconds */
+static double run_once(char *const argv[]) {
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&fa, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    double t0 = now();
+    pid_t pid;
+    int status = -1;
+    if (posix_spawn(&pid, argv[0], &fa, NULL, argv, environ) == 0) waitpid(pid, &status, 0);
+    double t = now() - t0;
+    posix_spawn_file_actions_destroy(&fa);
+    if (status != 0) fprintf(stderr, "startup_bench: %s exited with status %d\n", argv[0], status);
+    return t;
+}
+
+/* Spawn the shell interactively and time until its first prompt */
+static double first_prompt(const char *app) {
+    int in[2], out[2];
+    if (pipe2(in, O_CLOEXEC) != 0 || pipe2(out, O_CLOEXEC) != 0) return -1;
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, in[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, out[1], STDOUT_FILENO);
+    char *argv[] = { (char *)app, NULL };
+
+    double t0 = now(), t = -1;
+    pid_t pid;
+    if (posix_spawn(&pid, app, &fa, NULL, argv, environ) == 0) {
+        close(in[0]);
+        close(out[1]);
+        /* The prompt ends in "$ " */
+        char buf[4096];
+        size_t got = 0;
+        ssize_t n;
+        while (got + 1 < sizeof(buf) && (n = read(out[0], buf + got, sizeof(buf) - 1 - got)) > 0) {
+            got += (size_t)n;
+            buf[got] = '\0';
+            if (strstr(buf, "$ ") != NULL) {
+                t = now() - t0;
+                break;
+            }
+        }
+        close(in[1]);    /* EOF: the shell exits */
+        while (read(out[0], buf, sizeof(buf)) > 0) {
+        }
+        close(out[0]);
+        waitpid(pid, NULL, 0);
+    }
+    posix_spawn_file_actions_destroy(&fa);
+    return t;
+}
+
+int main(int argc, char **argv) {
+    const char *app = argc > 1 ? argv[1] : "bin/terminal_app";
+    int spawns = argc > 2 ? atoi(argv[2]) : DEFAULT_SPAWNS;
+    if (spawns < 1) {
+        fprintf(stderr, "Usage: %s [terminal_app] [spawns]\n", argv[0]);
+        return 2;
+    }
+    double *lat = calloc((size_t)spawns, sizeof(double));
+    if (lat == NULL) return 1;
+
+    printf("%-16s %6s %9s %9s %9s %9s\n", "case", "runs", "mean ms", "p50 ms", "p99 ms", "max ms");
+
+    char *floor_argv[] = { "/bin/true", NULL };
+    for (int i = 0; i < spawns; i++) lat[i] = run_once(floor_argv);
+    report("exec floor", lat, spawns);
+
+    char *c_argv[] = { (char *)app, "-c", "true", NULL };
+    run_once(c_argv);    /* warm the page cache */
+    for (int i = 0; i < spawns; i++) lat[i] = run_once(c_argv);
+    report("-c true", lat, spawns);
+
+    int prompts = spawns < 200 ? spawns : 200;
+    int ok = 0;
+    for (int i = 0; i < prompts; i++) {
+        double t = first_prompt(app);
+        if (t >= 0) lat[ok++] = t;
+    }
+    if (ok > 0) report("first prompt", lat, ok);
+    if (ok < prompts) fprintf(stderr, "startup_bench: %d runs showed no prompt\n", prompts - ok);
+
+    free(lat);
+    return ok < prompts;
+}
@@ -2,15 +2,29 @@
  * C X11 GUI for Terminal App - Simple Version
  * Spawns ./bin/terminal_app and displays output in an X11 window.
  * 
- * Compile:
- *   gcc -o gui_terminal gui_terminal.c -lX11 -lpthread
+ * Compile (core X fonts):
+ *   gcc -o bin/gui_terminal gui_terminal.c src/gui/vt.c src/gui/layout.c -lX11
+ *
+ * Compile (antialiased Xft text, font from $GUI_TERMINAL_FONT):
+ *   gcc -DHAVE_XFT -o bin/gui_terminal gui_terminal.c src/gui/vt.c src/gui/layout.c $(pkg-config --cflags --libs xft) -lX11
  * 
- * Run:
- *   ./gui_terminal
+ * Run (from the repository root, which has bin/terminal_app):
+ *   ./bin/gui_terminal
+ *   ./bin/gui_terminal --replay FILE   (draw a recorded output stream, print timing, exit)
+ *
+ * Tabs: Ctrl+Shift+T opens a session, Ctrl+Shift+W closes the current one,
+ * Ctrl+PageUp/PageDown switch. Every tab owns its child, its pipes and its
+ * scrollback; one epoll loop serves the X connection and all children.
+ * Background tabs keep parsing their output into their grid but are only
+ * drawn once they are shown.
  */
 
+#define _GNU_SOURCE
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#ifdef HAVE_XFT
+#include <X11/Xft/Xft.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,372 +34,598 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <signal.h>
-#include <pthread.h>
 #include <pwd.h>
 #include <limits.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include "src/gui/vt.h"
+#include "src/gui/layout.h"
 
+static const unsigned long palette_rgb[COL_COUNT] = {
+    0x555555, 0xff5555, 0x55ff55, 0xffff55,  /* black, red, green, yellow */
+    0x5555ff, 0xff55ff, 0x55ffff, 0xffffff,  /* blue, magenta, cyan, white */
+    0xd4d4d4,  /* default light text */
+    0x1e1e1e,  /* window background */
+    0x0099cc,  /* title */
+    0x333333,  /* output box */
+    0x666666,  /* box borders */
+    0x2d2d2d,  /* input box */
+    0x66ff66,  /* prompt user@host */
+    0x66a3ff,  /* prompt cwd */
+    0x1a1a1a,  /* status bar */
+    0x888888   /* status text */
+};
+
+#define GLYPH_CACHE_SIZE 256
+
+#define SCROLLBACK_LINES 1000            /* lines kept above the screen */
+#define LINE_HEIGHT 15
+#define OUTPUT_TOP 58                    /* top of the first output row */
+#define TEXT_LEFT 20
+#define READ_CHUNK 65536
+#define READS_PER_WAKEUP 4               /* per tab, so one busy tab can't starve the others */
+#define DEFAULT_FPS 60
+#define MAX_TABS 16
+#define TAB_WIDTH 120
+#define TAB_CLOSE_WAIT_MS 100            /* SIGTERM grace before SIGKILL */
+
+/* Text renderer state, built once at startup. Every palette color has its
+ * own GC so drawing never calls XSetForeground; with Xft the colors are
+ * allocated up front and glyph indices are memoized on first use. */
 typedef struct {
-    Display *display;
-    int screen;
-    Window window;
-    GC gc;
-    Atom wm_delete;
-    
-    char output[65536];
-    int output_len;
+    GC gc[COL_COUNT];
+    XFontStruct *font;
+    int cell_w;
+    int ascent;
+#ifdef HAVE_XFT
+    XftDraw *xft_draw;
+    XftFont *xft_font;
+    XftColor xft_color[COL_COUNT];
+    FT_UInt glyph_index[GLYPH_CACHE_SIZE];
+    unsigned char glyph_cached[GLYPH_CACHE_SIZE];
+#endif
+} Renderer;
+
+/* One session: a child shell, its pipes and its own terminal grid */
+typedef struct {
+    VtTerm term;             /* child output as a cell grid */
+    int view_offset;         /* lines scrolled back with Shift+PageUp */
     char input_line[256];
     int input_len;
-    
+
     pid_t child_pid;
     int stdin_fd;
-    int stdout_fd;
-    pthread_t reader_thread;
-    int running;
-    
+    int stdout_fd;           /* -1 once the child closed it */
+    int number;              /* shown on the tab, stable while it lives */
+} Tab;
+
+typedef struct {
+    Display *display;
+    int screen;
+    Window window;
+    Renderer render;
+    RowLayout layout;        /* scratch space for the row being drawn */
+    Atom wm_delete;
+    char user_host[320];
+
+    Tab *tabs[MAX_TABS];
+    int ntabs;
+    int active;
+    int next_number;
+    int epoll_fd;
+    int dirty;               /* something changed since the last frame */
+    int full_redraw;         /* window chrome must be repainted too */
+
+    /* --replay: the child is `cat FILE` and the run is timed end to end */
+    const char *replay_path;
+    size_t bytes_fed;
+    int frames;
+
     int width;
     int height;
 } AppState;
 
-/* Read from child process in background thread */
-static void *reader_thread_func(void *arg) {
-    AppState *state = (AppState *)arg;
-    char buf[512];
-    ssize_t n;
-    
-    while (state->running) {
-        /* Use non-blocking read with proper error handling */
-        n = read(state->stdout_fd, buf, sizeof(buf) - 1);
+/* Tag for the X connection in epoll; tabs are tagged with their Tab* */
+static char x_connection_tag;
+
+/* Echo GUI-side text (typed commands, status notes) into a tab */
+static void term_write(AppState *state, Tab *tab, const char *text) {
+    vt_feed(&tab->term, text, strlen(text));
+    if (tab == state->tabs[state->active]) state->dirty = 1;
+}
+
+/* Report a tab's shell once it has exited; never blocks */
+static void tab_reap(AppState *state, Tab *tab) {
+    int status = 0;
+    if (state->replay_path || tab->child_pid <= 0) return;
+    if (waitpid(tab->child_pid, &status, WNOHANG) != tab->child_pid) return;
+    char msg[64];
+    snprintf(msg, sizeof(msg), "[Process exited with status %d]\n", WEXITSTATUS(status));
+    term_write(state, tab, msg);
+    tab->child_pid = 0;
+}
+
+/* Read what the child wrote and parse it into the tab's grid. Only the
+ * shown tab asks for a frame; the others are drawn when switched to. */
+static void tab_ingest(AppState *state, Tab *tab) {
+    static char buf[READ_CHUNK];
+    for (int i = 0; i < READS_PER_WAKEUP; i++) {
+        ssize_t n = read(tab->stdout_fd, buf, sizeof(buf));
         if (n > 0) {
-            buf[n] = '\0';
-            
-            /* Check for clear screen ANSI escape code */
-            if (strstr(buf, "\033[2J\033[H") != NULL) {
-                /* Clear the output buffer */
-                state->output[0] = '\0';
-                state->output_len = 0;
-                /* Continue to avoid adding the escape code itself */
-                usleep(50000);
-                continue;
-            }
-            
-            if (state->output_len + n < (int)sizeof(state->output) - 1) {
-                /* Handle ANSI clear code specially (also handle from subprocess) */
-                if (strstr(buf, "\033[2J") != NULL || strstr(buf, "\033[H") != NULL) {
-                    state->output[0] = '\0';
-                    state->output_len = 0;
-                }
-                strcat(state->output, buf);
-                state->output_len += n;
-            }
-        } else if (n == 0) {
-            /* EOF — process closed stdout */
-            break;
-        } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
-            /* Real error */
-            break;
+            vt_feed(&tab->term, buf, (size_t)n);
+            state->bytes_fed += (size_t)n;
+            if (tab == state->tabs[state->active]) state->dirty = 1;
+            if ((size_t)n < sizeof(buf)) return;
+            continue;
         }
-        usleep(50000); /* 50ms */
+        if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+        /* EOF or a real error: the session is over */
+        epoll_ctl(state->epoll_fd, EPOLL_CTL_DEL, tab->stdout_fd, NULL);
+        close(tab->stdout_fd);
+        tab->stdout_fd = -1;
+        /* Every writer is gone, so the shell has exited or is about to: the
+         * event loop keeps trying until it can be reaped */
+        tab_reap(state, tab);
+        state->full_redraw = 1;      /* the tab's label changes */
+        if (tab == state->tabs[state->active]) state->dirty = 1;
+        return;
     }
-    return NULL;
 }
 
-/* Spawn terminal app subprocess */
-static int spawn_app(AppState *state) {
+/* Spawn a terminal app subprocess in a new tab and make it current */
+static Tab *tab_open(AppState *state) {
     int stdin_pipe[2], stdout_pipe[2];
     pid_t pid;
-    
-    if (pipe(stdin_pipe) == -1 || pipe(stdout_pipe) == -1) {
+
+    if (state->ntabs == MAX_TABS) return NULL;
+    Tab *tab = calloc(1, sizeof(Tab));
+    if (!tab) return NULL;
+    /* Terminal grid sized to the output box; the child writes through a
+     * pipe, not a tty, so LF must also return the carriage */
+    if (vt_init(&tab->term, (state->height - 160) / LINE_HEIGHT,
+                (state->width - 2 * TEXT_LEFT) / state->render.cell_w, SCROLLBACK_LINES) != 0) {
+        free(tab);
+        return NULL;
+    }
+    tab->term.newline_mode = 1;
+
+    if (pipe2(stdin_pipe, O_CLOEXEC) == -1) {
         perror("pipe");
-        return 0;
+        vt_free(&tab->term);
+        free(tab);
+        return NULL;
     }
-    
+    if (pipe2(stdout_pipe, O_CLOEXEC) == -1) {
+        perror("pipe");
+        close(stdin_pipe[0]);
+        close(stdin_pipe[1]);
+        vt_free(&tab->term);
+        free(tab);
+        return NULL;
+    }
+
     pid = fork();
     if (pid == -1) {
         perror("fork");
-        return 0;
-    }
-    
-    if (pid == 0) {
-        /* Child process */
+        close(stdin_pipe[0]);
         close(stdin_pipe[1]);
         close(stdout_pipe[0]);
-        
+        close(stdout_pipe[1]);
+        vt_free(&tab->term);
+        free(tab);
+        return NULL;
+    }
+
+    if (pid == 0) {
+        /* Child process: dup2 clears close-on-exec on 0, 1 and 2 */
         dup2(stdin_pipe[0], STDIN_FILENO);
         dup2(stdout_pipe[1], STDOUT_FILENO);
         dup2(stdout_pipe[1], STDERR_FILENO);
-        
-        close(stdin_pipe[0]);
-        close(stdout_pipe[1]);
-        
-        execl("./bin/terminal_app", "terminal_app", NULL);
+
+        if (state->replay_path) {
+            execlp("cat", "cat", state->replay_path, (char *)NULL);
+        } else {
+            execl("./bin/terminal_app", "terminal_app", NULL);
+        }
         perror("execl");
-        exit(1);
+        _exit(1);
     }
-    
+
     /* Parent process */
     close(stdin_pipe[0]);
     close(stdout_pipe[1]);
-    
-    state->child_pid = pid;
-    state->stdin_fd = stdin_pipe[1];
-    state->stdout_fd = stdout_pipe[0];
-    
-    fcntl(state->stdout_fd, F_SETFL, O_NONBLOCK);
-    
-    state->running = 1;
-    pthread_create(&state->reader_thread, NULL, reader_thread_func, state);
-    
-    return 1;
+    tab->child_pid = pid;
+    tab->stdin_fd = stdin_pipe[1];
+    tab->stdout_fd = stdout_pipe[0];
+    tab->number = ++state->next_number;
+    fcntl(tab->stdout_fd, F_SETFL, O_NONBLOCK);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = tab };
+    epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, tab->stdout_fd, &ev);
+
+    state->tabs[state->ntabs] = tab;
+    state->active = state->ntabs++;
+    state->full_redraw = 1;
+    state->dirty = 1;
+    return tab;
 }
 
-/* Helper: map ANSI color codes to X11 colors */
-static unsigned long ansi_to_xcolor(int ansi_code) {
-    switch (ansi_code) {
-        case 30: case 90: return 0x555555;  /* black/bright black */
-        case 31: case 91: return 0xff5555;  /* red/bright red */
-        case 32: case 92: return 0x55ff55;  /* green/bright green */
-        case 33: case 93: return 0xffff55;  /* yellow/bright yellow */
-        case 34: case 94: return 0x5555ff;  /* blue/bright blue */
-        case 35: case 95: return 0xff55ff;  /* magenta/bright magenta */
-        case 36: case 96: return 0x55ffff;  /* cyan/bright cyan */
-        case 37: case 97: return 0xffffff;  /* white/bright white */
-        default: return 0xd4d4d4;  /* default light text */
+/* End a tab's session and drop it */
+static void tab_close(AppState *state, int index) {
+    Tab *tab = state->tabs[index];
+    if (tab->stdout_fd >= 0) {
+        epoll_ctl(state->epoll_fd, EPOLL_CTL_DEL, tab->stdout_fd, NULL);
+        close(tab->stdout_fd);
+    }
+    /* EOF on stdin ends the shell; SIGTERM covers a busy one and SIGKILL
+     * one that ignores it, so closing never hangs the window */
+    close(tab->stdin_fd);
+    if (tab->child_pid > 0) {
+        kill(tab->child_pid, SIGTERM);
+        for (int ms = 0; waitpid(tab->child_pid, NULL, WNOHANG) == 0; ms++) {
+            if (ms == TAB_CLOSE_WAIT_MS) {
+                kill(tab->child_pid, SIGKILL);
+                waitpid(tab->child_pid, NULL, 0);
+                break;
+            }
+            usleep(1000);
+        }
     }
+    vt_free(&tab->term);
+    free(tab);
+
+    memmove(&state->tabs[index], &state->tabs[index + 1], (size_t)(state->ntabs - index - 1) * sizeof(Tab *));
+    state->ntabs--;
+    if (state->active >= state->ntabs) state->active = state->ntabs - 1;
+    state->full_redraw = 1;
+    state->dirty = 1;
 }
 
-/* Draw a line with possible ANSI color codes embedded */
-static void draw_line_with_ansi(Display *display, Drawable window, GC gc, 
-                                 int x, int y, const char *line, int line_len) {
-    unsigned long current_color = 0xd4d4d4;
-    int i = 0;
-    char buf[512];
-    int buf_len = 0;
-
-    while (i < line_len) {
-        if (line[i] == '\x1b' && i + 1 < line_len && line[i+1] == '[') {
-            /* Found ANSI escape sequence */
-            /* Flush current buffer */
-            if (buf_len > 0) {
-                XSetForeground(display, gc, current_color);
-                XDrawString(display, window, gc, x, y, buf, buf_len);
-                x += (buf_len * 8);
-                buf_len = 0;
-            }
-            
-            /* Parse escape sequence */
-            i += 2;
-            int code = 0;
-            while (i < line_len && line[i] >= '0' && line[i] <= '9') {
-                code = code * 10 + (line[i] - '0');
-                i++;
-            }
-            
-            /* Handle 'm' (SGR - Select Graphic Rendition) */
-            if (i < line_len && line[i] == 'm') {
-                if (code == 0) {
-                    current_color = 0xd4d4d4;  /* reset */
-                } else if (code >= 30 && code <= 97) {
-                    current_color = ansi_to_xcolor(code);
+static void tab_switch(AppState *state, int index) {
+    if (state->ntabs == 0) return;
+    state->active = (index + state->ntabs) % state->ntabs;
+    state->full_redraw = 1;
+    state->dirty = 1;
+}
+
+#ifdef HAVE_XFT
+/* Glyph index for a code point, memoized for the first 256 code points.
+ * Only the charmap lookup is cached here: the rasterized glyphs are kept
+ * by Xft itself (per XftFont, uploaded to the server's glyph set once), so
+ * drawing by index never renders a glyph twice. */
+static FT_UInt glyph_for(AppState *state, unsigned int cp) {
+    Renderer *r = &state->render;
+    if (cp < GLYPH_CACHE_SIZE) {
+        if (!r->glyph_cached[cp]) {
+            r->glyph_index[cp] = XftCharIndex(state->display, r->xft_font, cp);
+            r->glyph_cached[cp] = 1;
+        }
+        return r->glyph_index[cp];
+    }
+    return XftCharIndex(state->display, r->xft_font, cp);
+}
+#endif
+
+/* Draw the text runs of a laid-out row. Runs are grouped per color, so
+ * every color used on the row costs exactly one multi-item draw request. */
+static void draw_runs(AppState *state, int x, int y, const RowLayout *lay) {
+    Renderer *r = &state->render;
+
+#ifdef HAVE_XFT
+    if (r->xft_draw) {
+        XftGlyphSpec specs[MAX_LINE_CELLS];
+        for (int c = 0; c < COL_COUNT; c++) {
+            if (lay->color_count[c] == 0) continue;
+            int k = 0;
+            const LayoutRun *run = &lay->text[lay->color_first[c]];
+            for (int j = 0; j < lay->color_count[c]; j++, run++) {
+                for (int i = run->col; i < run->col + run->len; i++) {
+                    specs[k].glyph = glyph_for(state, lay->cells[i].cp);
+                    specs[k].x = (short)(x + i * r->cell_w);
+                    specs[k].y = (short)y;
+                    k++;
                 }
-                i++;
             }
-        } else if (line[i] == '\n') {
-            break;  /* stop at newline */
-        } else {
-            /* Regular character */
-            if (buf_len < (int)sizeof(buf) - 1) {
-                buf[buf_len++] = line[i];
-            }
-            i++;
+            XftDrawGlyphSpec(r->xft_draw, &r->xft_color[c], r->xft_font, specs, k);
         }
+        return;
     }
+#endif
 
-    /* Flush remaining buffer */
-    if (buf_len > 0) {
-        XSetForeground(display, gc, current_color);
-        XDrawString(display, window, gc, x, y, buf, buf_len);
+    char text[MAX_LINE_CELLS];
+    XTextItem items[MAX_LINE_CELLS];
+    for (int i = 0; i < lay->ncells; i++) {
+        text[i] = lay->cells[i].cp < 256 ? (char)lay->cells[i].cp : '?';
+    }
+
+    for (int c = 0; c < COL_COUNT; c++) {
+        if (lay->color_count[c] == 0) continue;
+        int pen = 0;  /* column the server-side pen is at after the last item */
+        const LayoutRun *run = &lay->text[lay->color_first[c]];
+        for (int j = 0; j < lay->color_count[c]; j++, run++) {
+            items[j].chars = &text[run->col];
+            items[j].nchars = run->len;
+            items[j].delta = (run->col - pen) * r->cell_w;
+            items[j].font = None;
+            pen = run->col + run->len;
+        }
+        XDrawText(state->display, state->window, r->gc[c], x, y, items, lay->color_count[c]);
     }
 }
 
-/* Draw the window contents */
-static void draw_window(AppState *state) {
-    /* Dark background (dark gray) */
-    unsigned long dark_bg = 0x1e1e1e;
-    unsigned long light_text = 0xd4d4d4;
-    unsigned long title_color = 0x0099cc;
-    
-    XSetForeground(state->display, state->gc, dark_bg);
-    XFillRectangle(state->display, state->window, state->gc, 0, 0, state->width, state->height);
-    
-    /* Draw title */
-    XSetForeground(state->display, state->gc, title_color);
-    XDrawString(state->display, state->window, state->gc, 10, 25, "C Terminal App - X11 GUI", 24);
-    
-    /* Draw output box (dark with border) */
-    XSetForeground(state->display, state->gc, 0x333333);
-    XFillRectangle(state->display, state->window, state->gc, 10, 50, state->width - 20, state->height - 150);
-    XSetForeground(state->display, state->gc, 0x666666);
-    XDrawRectangle(state->display, state->window, state->gc, 10, 50, state->width - 20, state->height - 150);
-    
-    /* Draw output text (light text on dark background, with ANSI color support) */
-    const char *text = state->output;
-    int y = 70;
-    const int max_visible_lines = (state->height - 150) / 15;
-    int text_len = strlen(text);
-    
-    if (text_len > 0) {
-        /* Count total lines to determine starting position */
-        int total_lines = 0;
-        for (int i = 0; i < text_len; i++) {
-            if (text[i] == '\n') total_lines++;
+/* Draw a plain string in a single palette color */
+static void draw_text(AppState *state, int x, int y, int color, const char *s, int len) {
+    layout_string(&state->layout, s, len, color);
+    draw_runs(state, x, y, &state->layout);
+}
+
+/* Create the per-color GCs (and Xft colors/font) once at startup */
+static void renderer_init(AppState *state) {
+    Renderer *r = &state->render;
+
+    r->font = XLoadQueryFont(state->display, "fixed");
+    for (int c = 0; c < COL_COUNT; c++) {
+        XGCValues v;
+        unsigned long mask = GCForeground | GCBackground | GCGraphicsExposures;
+        v.foreground = palette_rgb[c];
+        v.background = palette_rgb[COL_BG];
+        v.graphics_exposures = False;
+        if (r->font) {
+            v.font = r->font->fid;
+            mask |= GCFont;
         }
-        
-        /* Calculate which line to start from */
-        int skip_lines = (total_lines > max_visible_lines) ? (total_lines - max_visible_lines) : 0;
-        int current_line = 0;
-        int i = 0;
-        
-        /* Skip to the starting line */
-        while (i < text_len && current_line < skip_lines) {
-            if (text[i] == '\n') current_line++;
-            i++;
+        r->gc[c] = XCreateGC(state->display, state->window, mask, &v);
+    }
+
+    if (r->font) {
+        r->cell_w = r->font->max_bounds.width;
+        r->ascent = r->font->ascent;
+    } else {
+        r->cell_w = 8;
+        r->ascent = 11;
+    }
+
+#ifdef HAVE_XFT
+    const char *name = getenv("GUI_TERMINAL_FONT");
+    r->xft_font = XftFontOpenName(state->display, state->screen, name ? name : "monospace:size=10");
+    if (r->xft_font) {
+        Visual *visual = DefaultVisual(state->display, state->screen);
+        Colormap cmap = DefaultColormap(state->display, state->screen);
+        r->xft_draw = XftDrawCreate(state->display, state->window, visual, cmap);
+        for (int c = 0; c < COL_COUNT; c++) {
+            XRenderColor rc;
+            rc.red = (unsigned short)(((palette_rgb[c] >> 16) & 0xff) * 0x101);
+            rc.green = (unsigned short)(((palette_rgb[c] >> 8) & 0xff) * 0x101);
+            rc.blue = (unsigned short)((palette_rgb[c] & 0xff) * 0x101);
+            rc.alpha = 0xffff;
+            XftColorAllocValue(state->display, visual, cmap, &rc, &r->xft_color[c]);
+        }
+        r->cell_w = r->xft_font->max_advance_width;
+        r->ascent = r->xft_font->ascent;
+    }
+#endif
+}
+
+static void renderer_free(AppState *state) {
+    Renderer *r = &state->render;
+#ifdef HAVE_XFT
+    if (r->xft_draw) {
+        Visual *visual = DefaultVisual(state->display, state->screen);
+        Colormap cmap = DefaultColormap(state->display, state->screen);
+        for (int c = 0; c < COL_COUNT; c++) {
+            XftColorFree(state->display, visual, cmap, &r->xft_color[c]);
         }
+        XftDrawDestroy(r->xft_draw);
+    }
+    if (r->xft_font) XftFontClose(state->display, r->xft_font);
+#endif
+    for (int c = 0; c < COL_COUNT; c++) {
+        XFreeGC(state->display, r->gc[c]);
+    }
+    if (r->font) XFreeFont(state->display, r->font);
+}
+
+/* Paint one row of the output box from the terminal grid */
+static void draw_term_row(AppState *state, int row, const VtCell *line) {
+    Renderer *r = &state->render;
+    RowLayout *lay = &state->layout;
+    int top = OUTPUT_TOP + row * LINE_HEIGHT;
+
+    layout_row(lay, line, state->tabs[state->active]->term.cols);
+
+    /* Backgrounds first, then the text goes on top */
+    XFillRectangle(state->display, state->window, r->gc[COL_PANEL], 11, top, state->width - 22, LINE_HEIGHT);
+    for (int k = 0; k < lay->nbg; k++) {
+        XFillRectangle(state->display, state->window, r->gc[lay->bg[k].color],
+                       TEXT_LEFT + lay->bg[k].col * r->cell_w, top, lay->bg[k].len * r->cell_w, LINE_HEIGHT);
+    }
+
+    int baseline = top + LINE_HEIGHT - 3;
+    draw_runs(state, TEXT_LEFT, baseline, lay);
+
+    for (int k = 0; k < lay->nunderline; k++) {
+        const LayoutRun *u = &lay->underline[k];
+        XDrawLine(state->display, state->window, r->gc[u->color],
+                  TEXT_LEFT + u->col * r->cell_w, baseline + 1,
+                  TEXT_LEFT + (u->col + u->len) * r->cell_w - 1, baseline + 1);
+    }
+}
+
+/* Draw the window contents. Only rows the terminal marked dirty are
+ * repainted unless the whole window was exposed or resized. */
+static void draw_window(AppState *state) {
+    if (state->ntabs == 0) return;
+    Renderer *r = &state->render;
+    Tab *tab = state->tabs[state->active];
+    VtTerm *term = &tab->term;
+    int full = state->full_redraw || tab->view_offset > 0;
+
+    if (state->full_redraw) {
+        XFillRectangle(state->display, state->window, r->gc[COL_BG], 0, 0, state->width, state->height);
         
-        /* Now draw the visible lines */
-        while (i < text_len && y < state->height - 90) {
-            /* Find the end of this line */
-            int line_start = i;
-            while (i < text_len && text[i] != '\n') {
-                i++;
-            }
-            
-            /* Draw the line with ANSI color support */
-            int line_len = i - line_start;
-            if (line_len > 0) {
-                if (line_len > 255) line_len = 255;
-                char buf[512];
-                strncpy(buf, &text[line_start], line_len);
-                buf[line_len] = '\0';
-                draw_line_with_ansi(state->display, state->window, state->gc, 20, y, buf, line_len);
-            }
-            
-            y += 15;
-            
-            /* Skip the newline */
-            if (i < text_len && text[i] == '\n') {
-                i++;
-            }
+        /* Draw title and the tab strip after it */
+        draw_text(state, 10, 25, COL_TITLE, "C Terminal App", 14);
+        for (int i = 0; i < state->ntabs; i++) {
+            char label[32];
+            int x = 10 + 16 * r->cell_w + i * TAB_WIDTH;
+            int len = snprintf(label, sizeof(label), " %d: %s", state->tabs[i]->number,
+                               state->tabs[i]->stdout_fd >= 0 ? "shell" : "exited");
+            XFillRectangle(state->display, state->window, r->gc[i == state->active ? COL_PANEL : COL_STATUS_BG],
+                           x, 10, TAB_WIDTH - 4, 22);
+            draw_text(state, x, 25, i == state->active ? COL_TITLE : COL_STATUS_TEXT, label, len);
         }
+        
+        /* Draw output box (dark with border) */
+        XFillRectangle(state->display, state->window, r->gc[COL_PANEL], 10, 50, state->width - 20, state->height - 150);
+        XDrawRectangle(state->display, state->window, r->gc[COL_BORDER], 10, 50, state->width - 20, state->height - 150);
+
+        /* Draw status bar */
+        XFillRectangle(state->display, state->window, r->gc[COL_STATUS_BG], 0, state->height - 15, state->width, 15);
+        const char *help = "Enter runs a command. Ctrl+Shift+T new tab, Ctrl+Shift+W close, Ctrl+PgUp/PgDn switch.";
+        draw_text(state, 10, state->height - 3, COL_STATUS_TEXT, help, (int)strlen(help));
     }
     
+    /* Draw output rows from the terminal grid (scrolled back if requested) */
+    for (int row = 0; row < term->rows; row++) {
+        if (!full && !term->dirty[row]) continue;
+        draw_term_row(state, row, vt_view_line(term, tab->view_offset, row));
+    }
+    memset(term->dirty, 0, term->rows);
+    
     /* Draw input prompt and entry box (dark with border) */
-    XSetForeground(state->display, state->gc, 0x2d2d2d);
-    XFillRectangle(state->display, state->window, state->gc, 10, state->height - 70, state->width - 20, 30);
-    XSetForeground(state->display, state->gc, 0x666666);
-    XDrawRectangle(state->display, state->window, state->gc, 10, state->height - 70, state->width - 20, 30);
+    XFillRectangle(state->display, state->window, r->gc[COL_INPUT_BG], 10, state->height - 70, state->width - 20, 30);
+    XDrawRectangle(state->display, state->window, r->gc[COL_BORDER], 10, state->height - 70, state->width - 20, 30);
     
     /* Build prompt: user@host:cwd$  - render user@host in green, cwd in blue */
-    char host[256];
     char cwd[1024];
-    const char *user = "user";
-    struct passwd *pw = getpwuid(getuid());
-    if (pw) user = pw->pw_name;
-    if (gethostname(host, sizeof(host)) != 0) strncpy(host, "host", sizeof(host));
     if (getcwd(cwd, sizeof(cwd)) == NULL) strncpy(cwd, "~", sizeof(cwd));
 
-    char prompt1[256];
-    char prompt2[256];
-    snprintf(prompt1, sizeof(prompt1), "%s@%s:", user, host);
+    char prompt2[sizeof(cwd) + 3];
     snprintf(prompt2, sizeof(prompt2), "%s$ ", cwd);
+    int len1 = strlen(state->user_host);
+    int len2 = strlen(prompt2);
 
     /* user@host in green */
-    XSetForeground(state->display, state->gc, 0x66ff66);
-    XDrawString(state->display, state->window, state->gc, 20, state->height - 48, prompt1, strlen(prompt1));
+    draw_text(state, 20, state->height - 48, COL_PROMPT_USER, state->user_host, len1);
     /* cwd in blue */
-    XSetForeground(state->display, state->gc, 0x66a3ff);
-    XDrawString(state->display, state->window, state->gc, 20 + (strlen(prompt1) * 8), state->height - 48, prompt2, strlen(prompt2));
+    draw_text(state, 20 + len1 * r->cell_w, state->height - 48, COL_PROMPT_CWD, prompt2, len2);
     /* input text in light color */
-    XSetForeground(state->display, state->gc, light_text);
-    XDrawString(state->display, state->window, state->gc, 20 + ((strlen(prompt1) + strlen(prompt2)) * 8), state->height - 48, state->input_line, state->input_len);
+    int input_x = 20 + (len1 + len2) * r->cell_w;
+    draw_text(state, input_x, state->height - 48, COL_TEXT, tab->input_line, tab->input_len);
     
     /* Draw cursor (blinking line) */
     if ((time(NULL) % 2) == 0) {  /* Simple blink every 2 seconds */
-        XDrawLine(state->display, state->window, state->gc, 
-                  40 + (state->input_len * 8), state->height - 55,
-                  40 + (state->input_len * 8), state->height - 42);
+        XDrawLine(state->display, state->window, r->gc[COL_TEXT], 
+                  input_x + (tab->input_len * r->cell_w), state->height - 55,
+                  input_x + (tab->input_len * r->cell_w), state->height - 42);
     }
     
-    /* Draw status bar */
-    XSetForeground(state->display, state->gc, 0x1a1a1a);
-    XFillRectangle(state->display, state->window, state->gc, 0, state->height - 15, state->width, 15);
-    XSetForeground(state->display, state->gc, 0x888888);
-    XDrawString(state->display, state->window, state->gc, 10, state->height - 3, "Type commands and press Enter. Close window or type 'exit' to quit.", 66);
-    
+    state->full_redraw = 0;
     XFlush(state->display);
 }
 
+/* Fit every tab's terminal grid to the output box */
+static void resize_term(AppState *state) {
+    if (state->ntabs == 0) return;
+    int rows = (state->height - 160) / LINE_HEIGHT;
+    int cols = (state->width - 2 * TEXT_LEFT) / state->render.cell_w;
+    if (cols > MAX_LINE_CELLS) cols = MAX_LINE_CELLS;
+    for (int i = 0; i < state->ntabs; i++) {
+        vt_resize(&state->tabs[i]->term, rows, cols);
+        state->tabs[i]->view_offset = 0;
+    }
+}
+
 /* Handle keyboard input */
-static void handle_key(AppState *state, KeySym key, char *str) {
+static void handle_key(AppState *state, KeySym key, unsigned int mods, char *str) {
+    if (state->ntabs == 0) return;
+    Tab *tab = state->tabs[state->active];
+
+    /* Tab management */
+    if ((mods & ControlMask) && (mods & ShiftMask) && (key == XK_T || key == XK_t)) {
+        if (!tab_open(state)) term_write(state, tab, "[Error: cannot open another tab]\n");
+        return;
+    }
+    if ((mods & ControlMask) && (mods & ShiftMask) && (key == XK_W || key == XK_w)) {
+        tab_close(state, state->active);
+        return;
+    }
+    if ((mods & ControlMask) && (key == XK_Prior || key == XK_Next)) {
+        tab_switch(state, state->active + (key == XK_Next ? 1 : -1));
+        return;
+    }
+
+    /* Shift+PageUp/PageDown scroll through lines that left the screen */
+    if ((mods & ShiftMask) && (key == XK_Prior || key == XK_Next)) {
+        int page = tab->term.rows > 1 ? tab->term.rows - 1 : 1;
+        tab->view_offset += (key == XK_Prior) ? page : -page;
+        if (tab->view_offset > tab->term.sb_count) tab->view_offset = tab->term.sb_count;
+        if (tab->view_offset < 0) tab->view_offset = 0;
+        memset(tab->term.dirty, 1, tab->term.rows);
+        state->dirty = 1;
+        return;
+    }
+    if (tab->view_offset > 0) {
+        /* Typing jumps back to the live screen */
+        tab->view_offset = 0;
+        memset(tab->term.dirty, 1, tab->term.rows);
+    }
+
     if (key == XK_Return) {
         /* Send command */
-        if (state->input_len > 0) {
+        if (tab->input_len > 0) {
             char buf[512];
-            snprintf(buf, sizeof(buf), "%s\n", state->input_line);
+            snprintf(buf, sizeof(buf), "%s\n", tab->input_line);
             
             /* Check if child process is still running */
-            if (state->child_pid > 0) {
+            if (tab->child_pid > 0) {
                 int status = 0;
-                pid_t result = waitpid(state->child_pid, &status, WNOHANG);
+                pid_t result = waitpid(tab->child_pid, &status, WNOHANG);
                 
                 if (result == 0) {
                     /* Process still running */
-                    ssize_t n = write(state->stdin_fd, buf, strlen(buf));
+                    ssize_t n = write(tab->stdin_fd, buf, strlen(buf));
                     if (n < 0) {
                         perror("write to stdin");
-                        char errmsg[256];
-                        snprintf(errmsg, sizeof(errmsg), "[Error: failed to send command]\n");
-                        if (state->output_len + strlen(errmsg) < (int)sizeof(state->output) - 1) {
-                            strcat(state->output, errmsg);
-                            state->output_len += strlen(errmsg);
-                        }
+                        const char *errmsg = "[Error: failed to send command]\n";
+                        term_write(state, tab, errmsg);
                     } else {
-                        /* Successfully wrote — flush */
-                        fsync(state->stdin_fd);
-                        
                         /* Add command to output display immediately */
-                        if (state->output_len + strlen(state->input_line) + 1 < (int)sizeof(state->output) - 1) {
-                            strcat(state->output, state->input_line);
-                            strcat(state->output, "\n");
-                            state->output_len += strlen(state->input_line) + 1;
-                        }
+                        term_write(state, tab, buf);
                     }
                 } else {
                     /* Process has exited */
                     char msg[256];
                     snprintf(msg, sizeof(msg), "[Process exited with status %d]\n", WEXITSTATUS(status));
-                    if (state->output_len + strlen(msg) < (int)sizeof(state->output) - 1) {
-                        strcat(state->output, msg);
-                        state->output_len += strlen(msg);
-                    }
+                    term_write(state, tab, msg);
+                    tab->child_pid = 0;
                 }
             }
             
-            state->input_line[0] = '\0';
-            state->input_len = 0;
+            tab->input_line[0] = '\0';
+            tab->input_len = 0;
         }
     } else if (key == XK_BackSpace) {
-        if (state->input_len > 0) {
-            state->input_line[--state->input_len] = '\0';
+        if (tab->input_len > 0) {
+            tab->input_line[--tab->input_len] = '\0';
         }
-    } else if (str && strlen(str) > 0 && state->input_len < (int)sizeof(state->input_line) - 2) {
-        state->input_line[state->input_len++] = str[0];
-        state->input_line[state->input_len] = '\0';
+    } else if (str && strlen(str) > 0 && tab->input_len < (int)sizeof(tab->input_line) - 2) {
+        tab->input_line[tab->input_len++] = str[0];
+        tab->input_line[tab->input_len] = '\0';
     }
     
-    draw_window(state);
+    state->dirty = 1;
+}
+
+/* Monotonic clock in milliseconds, for frame pacing */
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
 }
 
-int main() {
+int main(int argc, char **argv) {
     /* Ignore SIGPIPE to prevent process death on broken pipe */
     signal(SIGPIPE, SIG_IGN);
     
@@ -393,7 +633,18 @@ int main() {
     memset(state, 0, sizeof(AppState));
     state->width = 800;
     state->height = 500;
-    state->running = 1;
+    if (argc == 3 && strcmp(argv[1], "--replay") == 0) {
+        state->replay_path = argv[2];
+    } else if (argc > 1) {
+        fprintf(stderr, "Usage: %s [--replay FILE]\n", argv[0]);
+        return 1;
+    }
+
+    /* Redraws are capped at the display refresh rate (override: GUI_TERMINAL_FPS) */
+    int fps = DEFAULT_FPS;
+    const char *fps_env = getenv("GUI_TERMINAL_FPS");
+    if (fps_env && atoi(fps_env) > 0) fps = atoi(fps_env);
+    const long frame_ms = 1000 / fps > 0 ? 1000 / fps : 1;
     
     /* Open X11 display */
     state->display = XOpenDisplay(NULL);
@@ -428,10 +679,25 @@ int main() {
     state->wm_delete = XInternAtom(state->display, "WM_DELETE_WINDOW", False);
     XSetWMProtocols(state->display, state->window, &state->wm_delete, 1);
     
-    /* Create graphics context */
-    state->gc = XCreateGC(state->display, state->window, 0, NULL);
-    XSetForeground(state->display, state->gc, 0);
-    XSetBackground(state->display, state->gc, WhitePixel(state->display, state->screen));
+    /* Create per-color graphics contexts and fonts */
+    renderer_init(state);
+
+    /* The prompt identity never changes; resolve it once instead of per frame */
+    const char *user = "user";
+    char host[256];
+    struct passwd *pw = getpwuid(getuid());
+    if (pw) user = pw->pw_name;
+    if (gethostname(host, sizeof(host)) != 0) strncpy(host, "host", sizeof(host));
+    host[sizeof(host) - 1] = '\0';
+    snprintf(state->user_host, sizeof(state->user_host), "%s@%s:", user, host);
+
+    /* One epoll set for the X connection and every tab's output */
+    state->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &x_connection_tag };
+    if (state->epoll_fd < 0 || epoll_ctl(state->epoll_fd, EPOLL_CTL_ADD, ConnectionNumber(state->display), &ev) != 0) {
+        perror("epoll");
+        return 1;
+    }
     
     /* Select input events */
     XSelectInput(state->display, state->window, ExposureMask | KeyPressMask | StructureNotifyMask | ClientMessage);
@@ -439,35 +705,44 @@ int main() {
     /* Map (show) window */
     XMapWindow(state->display, state->window);
     
-    /* Spawn terminal app */
-    if (!spawn_app(state)) {
+    /* Spawn terminal app in the first tab */
+    if (!tab_open(state)) {
         fprintf(stderr, "Failed to spawn terminal app\n");
         return 1;
     }
     
-    /* Event loop */
+    long start_ms = now_ms();
+
+    /* Event loop: X events and child output only mark the window dirty;
+     * a frame is drawn at most once per frame interval */
     XEvent event;
     int done = 0;
+    long next_frame = 0;
+    time_t last_blink = time(NULL);
+    struct epoll_event events[MAX_TABS + 1];
     
     while (!done) {
-        if (XPending(state->display) > 0) {
+        while (XPending(state->display) > 0) {
             XNextEvent(state->display, &event);
             
             switch (event.type) {
                 case Expose:
-                    draw_window(state);
+                    state->full_redraw = 1;
+                    state->dirty = 1;
                     break;
                 case KeyPress: {
                     char buf[32];
                     KeySym key;
                     int count = XLookupString(&event.xkey, buf, sizeof(buf), &key, NULL);
-                    handle_key(state, key, count > 0 ? buf : NULL);
+                    handle_key(state, key, event.xkey.state, count > 0 ? buf : NULL);
                     break;
                 }
                 case ConfigureNotify:
                     state->width = event.xconfigure.width;
                     state->height = event.xconfigure.height;
-                    draw_window(state);
+                    resize_term(state);
+                    state->full_redraw = 1;
+                    state->dirty = 1;
                     break;
                 case ClientMessage:
                     if ((Atom)event.xclient.data.l[0] == state->wm_delete) {
@@ -475,25 +750,59 @@ int main() {
                     }
                     break;
             }
-        } else {
+            /* Closing the last tab closes the window: drop the events
+             * still queued */
+            if (state->ntabs == 0) {
+                done = 1;
+                break;
+            }
+        }
+        if (done) break;
+
+        long now = now_ms();
+        if (state->dirty && now >= next_frame) {
             draw_window(state);
-            usleep(100000); /* 100ms */
+            state->dirty = 0;
+            state->frames++;
+            next_frame = now + frame_ms;
+        }
+
+        /* Replay mode: stop once the whole recording has been drawn */
+        if (state->replay_path && state->tabs[0]->stdout_fd < 0 && !state->dirty) {
+            XSync(state->display, False);
+            double secs = (now_ms() - start_ms) / 1000.0;
+            fprintf(stderr, "replay: %zu bytes, %d frames, %.3f s, %.2f MB/s\n",
+                    state->bytes_fed, state->frames, secs,
+                    secs > 0 ? state->bytes_fed / secs / (1024.0 * 1024.0) : 0.0);
+            break;
+        }
+
+        /* Sleep until input arrives, the next frame is due, or the cursor blinks */
+        int timeout = 1000;
+        if (state->dirty) {
+            timeout = (int)(next_frame - now_ms());
+            if (timeout < 0) timeout = 0;
+        }
+        int n = epoll_wait(state->epoll_fd, events, MAX_TABS + 1, timeout);
+        for (int i = 0; i < n; i++) {
+            /* X events are read by XPending at the top of the loop */
+            if (events[i].data.ptr != &x_connection_tag) tab_ingest(state, events[i].data.ptr);
+        }
+        for (int i = 0; i < state->ntabs; i++) {
+            if (state->tabs[i]->stdout_fd < 0) tab_reap(state, state->tabs[i]);
+        }
+
+        if (time(NULL) != last_blink) {
+            last_blink = time(NULL);
+            state->dirty = 1;
         }
     }
     
     /* Cleanup */
-    state->running = 0;
-    pthread_join(state->reader_thread, NULL);
-    
-    if (state->stdin_fd >= 0) close(state->stdin_fd);
-    if (state->stdout_fd >= 0) close(state->stdout_fd);
-    
-    if (state->child_pid > 0) {
-        kill(state->child_pid, SIGTERM);
-        waitpid(state->child_pid, NULL, WNOHANG);
-    }
+    while (state->ntabs > 0) tab_close(state, state->ntabs - 1);
+    close(state->epoll_fd);
     
-    XFreeGC(state->display, state->gc);
+    renderer_free(state);
     XDestroyWindow(state->display, state->window);
     XCloseDisplay(state->display);
     
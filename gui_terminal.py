@@ -9,9 +9,78 @@ import tkinter as tk
 from tkinter import scrolledtext, messagebox
 import subprocess
 import threading
+import queue
+import codecs
+import re
 import os
 import signal
 
+# Output is drained from the reader queue on a fixed tick and applied as one
+# batched Text update; the widget keeps at most MAX_LINES lines.
+TICK_MS = 33
+READ_CHUNK = 65536
+MAX_LINES = 5000
+
+ANSI_TAGS = ['ansi_black', 'ansi_red', 'ansi_green', 'ansi_yellow',
+             'ansi_blue', 'ansi_magenta', 'ansi_cyan', 'ansi_white']
+
+try:
+    # C extension built with `make pyext`: same parser as the X11 GUI
+    import gui_ansi
+    AnsiParser = gui_ansi.Parser
+    OP_CR, OP_CLEAR = gui_ansi.CR, gui_ansi.CLEAR
+except ImportError:
+    gui_ansi = None
+    OP_CR, OP_CLEAR = 1, 2
+
+    class AnsiParser:
+        """Pure-Python fallback with the same feed() contract as gui_ansi.Parser."""
+        _seq = re.compile(r'\x1b\[([0-9;?]*)([@-~])|\x1b\][^\x07\x1b]*(?:\x07|\x1b\\)?|\r(?!\n)|\r\n')
+        # A chunk may end inside a CR LF pair or an escape sequence: that tail
+        # waits for the next chunk, like the C parser's state machine
+        _partial = re.compile(r'(?:\x1b(?:\[[0-9;?]*|\][^\x07\x1b]*\x1b?)?|\r)\Z')
+        _partial_max = 4096
+
+        def __init__(self):
+            self._decoder = codecs.getincrementaldecoder('utf-8')('replace')
+            self._tag = ''
+            self._held = ''
+
+        def _sgr(self, params):
+            for code in (int(p) if p.isdigit() else 0 for p in (params or '0').split(';')):
+                if code == 0 or code == 39:
+                    self._tag = ''
+                elif 30 <= code <= 37:
+                    self._tag = ANSI_TAGS[code - 30]
+                elif 90 <= code <= 97:
+                    self._tag = ANSI_TAGS[code - 90]
+
+        def feed(self, data):
+            text = self._held + self._decoder.decode(data)
+            self._held = ''
+            m = self._partial.search(text)
+            if m and len(text) - m.start() <= self._partial_max:
+                self._held = text[m.start():]
+                text = text[:m.start()]
+            out = []
+            pos = 0
+            for m in self._seq.finditer(text):
+                if m.start() > pos:
+                    out.append((text[pos:m.start()], self._tag))
+                pos = m.end()
+                token = m.group(0)
+                if token == '\r\n':
+                    out.append(('\n', self._tag))
+                elif token == '\r':
+                    out.append(OP_CR)
+                elif m.group(2) == 'm':
+                    self._sgr(m.group(1))
+                elif m.group(2) == 'J' and m.group(1) in ('2', '3'):
+                    out = [OP_CLEAR]
+            if pos < len(text):
+                out.append((text[pos:], self._tag))
+            return out
+
 class GUITerminal:
     def __init__(self, root):
         self.root = root
@@ -31,6 +100,8 @@ class GUITerminal:
         
         self.process = None
         self.reader_thread = None
+        self.output_queue = queue.Queue()
+        self.ansi_parser = AnsiParser()
         self.setup_ui()
         self.start_terminal()
     
@@ -82,6 +153,7 @@ class GUITerminal:
         self.output_text.tag_config("error", foreground="#f48771")
         
         # Configure ANSI color tags
+        self.output_text.tag_config('ansi_black', foreground='#555555')
         self.output_text.tag_config('ansi_red', foreground='#ff5555')
         self.output_text.tag_config('ansi_green', foreground='#55ff55')
         self.output_text.tag_config('ansi_yellow', foreground='#ffff55')
@@ -170,109 +242,91 @@ class GUITerminal:
                 stdin=subprocess.PIPE,
                 stdout=subprocess.PIPE,
                 stderr=subprocess.STDOUT,
-                text=True,
-                bufsize=1
+                bufsize=0
             )
             self.update_status("Status: Running")
             
-            # Start reader thread to capture output
+            # Start reader thread to capture output; the Tk side drains it per tick
             self.reader_thread = threading.Thread(target=self.read_output, daemon=True)
             self.reader_thread.start()
+            self.root.after(TICK_MS, self._drain_output)
         except Exception as e:
             messagebox.showerror("Error", f"Failed to start terminal: {e}")
             self.root.destroy()
     
     def read_output(self):
-        """Read output from the terminal app in a separate thread."""
+        """Read raw output in a separate thread and queue it for the next tick."""
+        fd = self.process.stdout.fileno()
         try:
-            while self.process and self.process.poll() is None:
-                try:
-                    line = self.process.stdout.readline()
-                    if line:
-                        # Handle ANSI clear sequences by clearing the widget
-                        if "\x1b[2J" in line or "\x1b[H" in line:
-                            self.root.after(0, self._clear_output)
-                            clean = line.replace("\x1b[2J", "").replace("\x1b[H", "")
-                            if clean.strip():
-                                self.display_output(clean, is_error=False)
-                        else:
-                            self.display_output(line, is_error=False)
-                except:
+            while True:
+                chunk = os.read(fd, READ_CHUNK)
+                if not chunk:
                     break
-            
-            # Read any remaining output after process exits
-            if self.process:
-                remaining = self.process.stdout.read()
-                if remaining:
-                    self.display_output(remaining, is_error=False)
-            
-            self.update_status("Status: Terminated")
-        except Exception as e:
+                self.output_queue.put(chunk)
+        except OSError as e:
             self.display_output(f"[Error reading output: {e}]\n", is_error=True)
+        self.output_queue.put(None)  # EOF marker
+
+    def _drain_output(self):
+        """Tick: parse everything queued since the last tick and show it at once."""
+        chunks = []
+        eof = False
+        while True:
+            try:
+                chunk = self.output_queue.get_nowait()
+            except queue.Empty:
+                break
+            if chunk is None:
+                eof = True
+                break
+            chunks.append(chunk)
+
+        if chunks:
+            self._apply_segments(self.ansi_parser.feed(b"".join(chunks)))
+
+        if eof:
+            self.status_label.config(text="Status: Terminated")
+        else:
+            self.root.after(TICK_MS, self._drain_output)
+
+    def _apply_segments(self, segments):
+        """Insert parsed (text, tag) pairs with as few Text calls as possible."""
+        widget = self.output_text
+        widget.config(state=tk.NORMAL)
+        args = []
+        for seg in segments:
+            if isinstance(seg, tuple):
+                args.extend(seg)
+                continue
+            if args:
+                widget.insert(tk.END, *args)
+                args = []
+            if seg == OP_CLEAR:
+                widget.delete("1.0", tk.END)
+            elif seg == OP_CR:
+                widget.delete("end-1c linestart", "end-1c")
+        if args:
+            widget.insert(tk.END, *args)
+
+        # Trim the oldest lines so the widget never grows without bound
+        last_line = int(widget.index("end-1c").split(".")[0])
+        if last_line > MAX_LINES:
+            widget.delete("1.0", f"{last_line - MAX_LINES + 1}.0")
+
+        widget.see(tk.END)
+        widget.config(state=tk.DISABLED)
     
     def display_output(self, text, is_error=False):
-        """Thread-safe method to display output in the text widget."""
+        """Thread-safe method to display a GUI-side message in the text widget."""
         self.root.after(0, self._display_output_main, text, is_error)
     
     def _display_output_main(self, text, is_error):
-        """Main thread method to update output text with ANSI color support."""
+        """Main thread method to show a message (errors are highlighted)."""
         self.output_text.config(state=tk.NORMAL)
-        if is_error:
-            self.output_text.insert(tk.END, text, "error")
-        else:
-            self._insert_with_ansi_colors(text)
+        self.output_text.insert(tk.END, text, "error" if is_error else ())
         self.output_text.see(tk.END)
         self.output_text.config(state=tk.DISABLED)
     
-    def _insert_with_ansi_colors(self, text):
-        """Insert text with ANSI color code support."""
-        i = 0
-        current_tags = []
-        buf = ""
-        
-        while i < len(text):
-            if text[i:i+2] == '\x1b[':
-                # Found ANSI escape sequence, flush buffer first
-                if buf:
-                    self.output_text.insert(tk.END, buf, tuple(current_tags) if current_tags else ())
-                    buf = ""
-                
-                # Parse the escape code
-                i += 2
-                code_str = ""
-                while i < len(text) and text[i].isdigit():
-                    code_str += text[i]
-                    i += 1
-                
-                # Handle 'm' (SGR - Select Graphic Rendition)
-                if i < len(text) and text[i] == 'm':
-                    code = int(code_str) if code_str else 0
-                    if code == 0:
-                        current_tags = []  # reset
-                    elif code == 31:
-                        current_tags = ['ansi_red']
-                    elif code == 32:
-                        current_tags = ['ansi_green']
-                    elif code == 33:
-                        current_tags = ['ansi_yellow']
-                    elif code == 34:
-                        current_tags = ['ansi_blue']
-                    elif code == 35:
-                        current_tags = ['ansi_magenta']
-                    elif code == 36:
-                        current_tags = ['ansi_cyan']
-                    elif code == 37:
-                        current_tags = ['ansi_white']
-                    i += 1
-            else:
-                # Regular character
-                buf += text[i]
-                i += 1
-        
-        # Flush remaining buffer
-        if buf:
-            self.output_text.insert(tk.END, buf, tuple(current_tags) if current_tags else ())
-    
     def on_input_enter(self, event=None):
         """Handle input when user presses Enter or clicks Send."""
         command = self.input_entry.get().strip()
@@ -287,7 +341,7 @@ class GUITerminal:
         # Send command to terminal app
         try:
             if self.process and self.process.poll() is None:
-                self.process.stdin.write(command + "\n")
+                self.process.stdin.write((command + "\n").encode())
                 self.process.stdin.flush()
         except BrokenPipeError:
             self.display_output("[Process terminated]\n", is_error=True)
@@ -295,14 +349,6 @@ class GUITerminal:
         except Exception as e:
             self.display_output(f"[Error sending command: {e}]\n", is_error=True)
 
-    def _clear_output(self):
-        try:
-            self.output_text.config(state=tk.NORMAL)
-            self.output_text.delete("1.0", tk.END)
-            self.output_text.config(state=tk.DISABLED)
-        except:
-            pass
-
     def _display_command_with_prompt(self, command):
         # Insert colored prompt pieces then the command
         try:
@@ -0,0 +1,71 @@
+// executor.h
+// Declarations shared by the command executor (executor.c), the built-in
+// commands (commands/exec_builtin.c) and external execution
+// (commands/exec_external.c).
+
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+struct HereDocs;
+
+/* A redirection after expansion: the operator and its target */
+typedef struct {
+    int kind;            /* RedirKind (parser.h) */
+    const char *target;
+} Redirect;
+
+/* Parse a command line and run it; returns the exit status */
+int execute_command(const char *command);
+
+/* Run one expanded simple command (builtin or external) with its
+ * redirections; source is its text, for history */
+int execute_argv(const char *source, char **argv, const Redirect *redirs, int nredirs,
+                 struct HereDocs *docs);
+
+/* Pipeline stage helpers, used by the interpreter (interp.c) */
+int take_heredocs(const Redirect *redirs, int nredirs, struct HereDocs *docs);
+void apply_redirections(const Redirect *redirs, int nredirs, int docfd);
+void exec_in_child(char **argv);   /* never returns */
+
+/* Run argv as an external program (fork/exec) */
+int exec_external(char **args);
+
+/* Run a built-in command in the shell process */
+int exec_builtin(char **args);
+
+/* Names of the built-in commands, NULL-terminated */
+extern const char *const builtin_commands[];
+int is_builtin(const char *name);
+
+/* Command history */
+void add_command_to_history(const char *command);
+void add_argv_to_history(char **args);
+void history_set(char *const *entries, int count);
+int history_get(char *const **entries);
+/* While muted (calls nest), commands are not added to history */
+void history_mute(int on);
+/* Daemon sessions keep their history in the session, not the shared file */
+void history_persist(int on);
+
+/* Built-in commands */
+int exec_about(char **args);
+int exec_help(char **args);
+int exec_clear(char **args);
+int exec_count(char **args);
+int exec_history(char **args);
+int exec_cd(char **args);
+int exec_exit(char **args);
+int exec_ls(char **args);
+int exec_ffind(char **args);
+int exec_fgrep(char **args);
+int exec_memo(char **args);
+int exec_limit(char **args);
+int exec_watch(char **args);
+int exec_echo(char **args);
+int exec_true(char **args);
+int exec_false(char **args);
+int exec_test(char **args);
+int exec_export(char **args);
+int exec_unset(char **args);
+
+#endif // EXECUTOR_H
@@ -0,0 +1,35 @@
+// interp.h
+// Interpreter: runs the syntax trees built by parser.c. Loops, conditions,
+// variables, arithmetic and builtins all run in the shell process; only
+// external commands and pipelines fork. Parsed lines are cached, so a line
+// run again (or a $(...) inside a loop body) is not parsed again.
+
+#ifndef INTERP_H
+#define INTERP_H
+
+#include <stddef.h>
+
+struct HereDocs;
+
+/* Parse (or fetch from the cache) and run one command line. docs supplies
+ * the bodies of its << operators and may be NULL. Returns the exit status. */
+int interp_run(const char *line, struct HereDocs *docs);
+
+/* Exit status of the last command ($?) */
+int interp_last_status(void);
+
+/* ---- shell variables ---- */
+
+/* Value of a shell variable, falling back to the environment; NULL if unset */
+const char *shell_var_get(const char *name);
+
+/* Set a variable. Variables that are exported (or came from the
+ * environment) are updated in the environment too. */
+int shell_var_set(const char *name, const char *value, int exported);
+
+void shell_var_unset(const char *name);
+
+/* Is name a valid variable name? */
+int shell_var_valid(const char *name, size_t len);
+
+#endif // INTERP_H
@@ -0,0 +1,115 @@
+// parser.h
+// Command-line parser: turns a line into a syntax tree once, so the
+// interpreter (interp.c) can run loops over it without looking at the text
+// again.
+//
+// Grammar (one line; ';' separates commands):
+//
+//   list      := and_or { ';' and_or } [';']
+//   and_or    := pipeline { ('&&' | '||') pipeline }
+//   pipeline  := command { '|' command }
+//   command   := simple | for | while | until | if | '((' expr '))'
+//   for       := 'for' NAME 'in' word... ';' 'do' list 'done'
+//   while     := 'while' list 'do' list 'done'         (until: same)
+//   if        := 'if' list 'then' list { 'elif' list 'then' list }
+//                ['else' list] 'fi'
+//   simple    := { NAME=word } { word | redir }
+//   redir     := ('<' | '>' | '<<' | '<<-' | '<<<') word
+//
+// Words are compiled into parts (literal text, $NAME / ${NAME} / $?,
+// $((expr)), $(cmd) / `cmd`) and arithmetic into expression trees, so
+// expanding a word is a walk over its parts. Quotes are removed at
+// compile time: '...' is literal, "..." expands $ and ` only, \x is x.
+// Redirection operators are only recognized unquoted, so "<" or '>' is an
+// ordinary argument.
+
+#ifndef PARSER_H
+#define PARSER_H
+
+typedef struct ArithNode ArithNode;
+
+typedef enum {
+    PART_LIT,            /* text as written */
+    PART_VAR,            /* $NAME, ${NAME}, $? and $$ (name "?" / "$") */
+    PART_ARITH,          /* $((expr)) */
+    PART_SUBST           /* $(cmd) or `cmd`: text is cmd */
+} PartKind;
+
+typedef struct {
+    PartKind kind;
+    int quoted;          /* from '...', "..." or \x: not split or globbed */
+    char *text;
+    ArithNode *arith;
+} WordPart;
+
+typedef struct {
+    WordPart *parts;
+    int nparts;
+    char *raw;           /* the word as written */
+} Word;
+
+typedef enum {
+    REDIR_IN,            /* < file */
+    REDIR_OUT,           /* > file */
+    REDIR_HEREDOC,       /* <<WORD, <<-WORD: the body comes with the line */
+    REDIR_HERESTRING     /* <<<word */
+} RedirKind;
+
+typedef struct {
+    RedirKind kind;
+    Word target;         /* file name, here-string or delimiter */
+} Redir;
+
+typedef enum {
+    NODE_SIMPLE,
+    NODE_PIPELINE,
+    NODE_AND,            /* kids[0] && kids[1] */
+    NODE_OR,             /* kids[0] || kids[1] */
+    NODE_SEQ,
+    NODE_FOR,
+    NODE_WHILE,
+    NODE_UNTIL,
+    NODE_IF,             /* cond, then, [cond, then]..., [else] */
+    NODE_ARITH
+} NodeKind;
+
+typedef struct Node {
+    NodeKind kind;
+    struct Node **kids;
+    int nkids;
+    Word *words;         /* SIMPLE: arguments; FOR: the list */
+    int nwords;
+    char **assign_names; /* SIMPLE: NAME=value prefixes */
+    Word *assign_values;
+    int nassigns;
+    Redir *redirs;       /* SIMPLE: redirections, in order */
+    int nredirs;
+    char *name;          /* FOR: loop variable */
+    ArithNode *arith;    /* ARITH */
+    char *source;        /* SIMPLE: text of the command (for history) */
+} Node;
+
+/* Parse one command line. Returns NULL (and prints why) on a syntax error;
+ * an empty line gives an empty NODE_SEQ. */
+Node *parse_line(const char *line);
+
+void node_free(Node *node);
+
+/* ---- arithmetic ---- */
+
+/* Compile an arithmetic expression; NULL (and a message) if malformed */
+ArithNode *arith_parse(const char *expr);
+
+void arith_free(ArithNode *node);
+
+/* Variable access for arith_eval: names are looked up and assigned
+ * through these */
+typedef struct {
+    long long (*get)(const char *name);
+    void (*set)(const char *name, long long value);
+} ArithEnv;
+
+/* Evaluate; *err is set on division by zero */
+long long arith_eval(const ArithNode *node, const ArithEnv *env, int *err);
+
+#endif // PARSER_H
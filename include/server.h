@@ -0,0 +1,37 @@
+// server.h
+// Daemon mode (terminal_app --serve SOCKET) and the protocol spoken with
+// the thin client (client.c).
+//
+// The socket is a UNIX SOCK_SEQPACKET socket, so every message arrives
+// whole. Each message starts with a ServeHeader:
+//
+//   client -> daemon  SERVE_HELLO  cwd\0 VAR=value\0 ...    opens the session
+//                     SERVE_RUN    command line\0           + 3 fds (SCM_RIGHTS)
+//   daemon -> client  SERVE_STATUS (header only, status in arg)
+//
+// A connection is one session with its own cwd, environment and history.
+// Its commands run one at a time, each in a forked copy of the daemon with
+// the client's stdin/stdout/stderr.
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdint.h>
+
+#define SERVE_MAX_MESSAGE (256 * 1024)
+
+enum {
+    SERVE_HELLO = 1,
+    SERVE_RUN = 2,
+    SERVE_STATUS = 3
+};
+
+typedef struct {
+    uint32_t type;
+    int32_t arg;         /* SERVE_STATUS: exit status */
+} ServeHeader;
+
+/* Run the daemon on socket path until SIGINT/SIGTERM; returns the exit code */
+int serve_main(const char *path);
+
+#endif // SERVER_H
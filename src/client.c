@@ -0,0 +1,142 @@
+// client.c
+// terminal_client: thin client for terminal_app --serve (see server.h).
+//
+//   terminal_client SOCKET command [args...]   run one command line
+//   terminal_client SOCKET                     run each line read from stdin
+//                                              in one session
+//
+// The client opens a session with its cwd and environment, then hands its
+// own stdin/stdout/stderr to the daemon with every command, so output goes
+// straight to wherever the client's output goes. Exits with the status of
+// the last command.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "server.h"
+
+extern char **environ;
+
+static char message[SERVE_MAX_MESSAGE];
+
+static int connect_daemon(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "terminal_client: socket path too long\n");
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "terminal_client: cannot connect to %s: %s\n", path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* Append s and its NUL to message at *len; 0 if it fit */
+static int put_string(size_t *len, const char *s) {
+    size_t n = strlen(s) + 1;
+    if (*len + n > sizeof(message)) return -1;
+    memcpy(message + *len, s, n);
+    *len += n;
+    return 0;
+}
+
+static int send_hello(int fd) {
+    ServeHeader hdr = { SERVE_HELLO, 0 };
+    char cwd[4096];
+    size_t len = sizeof(hdr);
+    memcpy(message, &hdr, sizeof(hdr));
+    put_string(&len, getcwd(cwd, sizeof(cwd)) ? cwd : "/");
+    /* Variables that do not fit are left out rather than failing */
+    for (int i = 0; environ[i] != NULL; i++) put_string(&len, environ[i]);
+    return send(fd, message, len, 0) < 0 ? -1 : 0;
+}
+
+/* Run one command line with the given stdio; returns its exit status */
+static int run_remote(int fd, const char *command, const int stdio[3]) {
+    ServeHeader hdr = { SERVE_RUN, 0 };
+    size_t len = sizeof(hdr);
+    memcpy(message, &hdr, sizeof(hdr));
+    if (put_string(&len, command) != 0) {
+        fprintf(stderr, "terminal_client: command too long\n");
+        return 1;
+    }
+
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    memset(cbuf, 0, sizeof(cbuf));
+    struct iovec iov = { message, len };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    struct cmsghdr *c = CMSG_FIRSTHDR(&msg);
+    c->cmsg_level = SOL_SOCKET;
+    c->cmsg_type = SCM_RIGHTS;
+    c->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(c), stdio, 3 * sizeof(int));
+
+    if (sendmsg(fd, &msg, 0) < 0) {
+        perror("terminal_client: send");
+        return 1;
+    }
+    ssize_t n;
+    while ((n = recv(fd, &hdr, sizeof(hdr), 0)) < 0 && errno == EINTR) {
+    }
+    if (n != (ssize_t)sizeof(hdr) || hdr.type != SERVE_STATUS) {
+        fprintf(stderr, "terminal_client: daemon closed the session\n");
+        return 1;
+    }
+    return hdr.arg < 0 ? 1 : hdr.arg & 0xff;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <socket> [command [args...]]\n", argv[0]);
+        return 2;
+    }
+    int fd = connect_daemon(argv[1]);
+    if (fd < 0 || send_hello(fd) != 0) return 1;
+
+    int status = 0;
+    if (argc > 2) {
+        /* One command: the words are joined back into a command line */
+        char line[SERVE_MAX_MESSAGE / 2];
+        size_t len = 0;
+        line[0] = '\0';
+        for (int i = 2; i < argc; i++) {
+            int n = snprintf(line + len, sizeof(line) - len, "%s%s", i > 2 ? " " : "", argv[i]);
+            if (n < 0 || (size_t)n >= sizeof(line) - len) {
+                fprintf(stderr, "terminal_client: command too long\n");
+                return 1;
+            }
+            len += (size_t)n;
+        }
+        int stdio[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+        status = run_remote(fd, line, stdio);
+    } else {
+        /* Script mode: stdin carries the commands, so they get /dev/null */
+        int null_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        int stdio[3] = { null_fd, STDOUT_FILENO, STDERR_FILENO };
+        char line[4096];
+        while (fgets(line, sizeof(line), stdin) != NULL) {
+            line[strcspn(line, "\n")] = '\0';
+            if (line[0] == '\0') continue;
+            if (strcmp(line, "exit") == 0) break;
+            fflush(stdout);
+            status = run_remote(fd, line, stdio);
+        }
+        if (null_fd >= 0) close(null_fd);
+    }
+    close(fd);
+    return status;
+}
@@ -4,40 +4,145 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include "executor.h"
+#include "interp.h"
+#include "../utils/file_io.h"
+#include "../utils/json_records.h"
 
 #define MAX_HISTORY 50
 
-/* Global history buffer */
+/* Global history buffer: the last MAX_HISTORY commands, oldest first */
 static char *command_history[MAX_HISTORY];
 static int history_count = 0;
+static int history_muted = 0;
+/* Commands are appended to ~/.terminal_history unless this is cleared */
+static int history_persisted = 1;
+/* The persisted history is read when it is first shown, not at startup */
+static int history_loaded = 0;
 /* forward declaration for persistence helper */
 static void persist_history_to_file(const char *command);
+
+/* Append an entry (taking ownership), dropping the oldest when full */
+static void history_push(char *entry) {
+    if (history_count == MAX_HISTORY) {
+        free(command_history[0]);
+        memmove(command_history, command_history + 1, (MAX_HISTORY - 1) * sizeof(char *));
+        history_count--;
+    }
+    command_history[history_count++] = entry;
+}
+
 /* Add command to history - can be called from external functions */
 void add_command_to_history(const char *command) {
-    if (command == NULL || strlen(command) == 0) return;
+    if (command == NULL || strlen(command) == 0 || history_muted > 0) return;
     
     /* Skip history and cd commands in history display (meta commands) */
     if (strcmp(command, "history") == 0 || strcmp(command, "cd") == 0) {
         return;
     }
     
-    if (history_count < MAX_HISTORY) {
-        command_history[history_count] = malloc(strlen(command) + 1);
-        if (command_history[history_count]) {
-            strcpy(command_history[history_count], command);
-            history_count++;
-            /* Also persist to file */
-            persist_history_to_file(command);
-        }
+    char *entry = strdup(command);
+    if (entry) {
+        history_push(entry);
+        /* Also persist to file */
+        persist_history_to_file(command);
+    }
+}
+
+/* Add an argv-style command to history, arguments included */
+void add_argv_to_history(char **args) {
+    if (args == NULL || args[0] == NULL || history_muted > 0) return;
+    /* cd and history stay out whatever their arguments */
+    if (strcmp(args[0], "history") == 0 || strcmp(args[0], "cd") == 0) return;
+
+    size_t len = 0;
+    for (int i = 0; args[i] != NULL; i++) len += strlen(args[i]) + 1;
+    char *cmdstr = malloc(len + 1);
+    if (cmdstr == NULL) return;
+    cmdstr[0] = '\0';
+    for (int i = 0; args[i] != NULL; i++) {
+        if (i) strcat(cmdstr, " ");
+        strcat(cmdstr, args[i]);
+    }
+    add_command_to_history(cmdstr);
+    free(cmdstr);
+}
+
+/* Replace the whole history (daemon sessions carry their own between
+ * commands) */
+void history_set(char *const *entries, int count) {
+    for (int i = 0; i < history_count; i++) free(command_history[i]);
+    history_count = 0;
+    history_loaded = 1;
+    for (int i = 0; i < count && history_count < MAX_HISTORY; i++) {
+        char *entry = strdup(entries[i]);
+        if (entry) history_push(entry);
+    }
+}
+
+/* Path of the persisted history file; 0 when HOME is not set */
+static int history_path(char *path, size_t size) {
+    const char *home = getenv("HOME");
+    if (!home) return 0;
+    snprintf(path, size, "%s/.terminal_history", home);
+    return 1;
+}
+
+/* Load the last MAX_HISTORY entries of the history file, once. They
+ * replace the in-memory list: this session's commands were appended to
+ * the file as they ran, so they are among them. */
+static void history_load(void) {
+    if (history_loaded) return;
+    history_loaded = 1;
+
+    char path[512];
+    FILE *f = history_path(path, sizeof(path)) ? fopen(path, "r") : NULL;
+    if (!f) return; /* keep what this session has */
+
+    char *tail[MAX_HISTORY] = { NULL };
+    char *line = NULL;
+    size_t cap = 0;
+    ssize_t len;
+    int total = 0;
+    while ((len = getline(&line, &cap, f)) > 0) {
+        if (line[len - 1] == '\n') line[--len] = '\0';
+        if (len == 0) continue;
+        int slot = total % MAX_HISTORY;
+        free(tail[slot]);
+        tail[slot] = strdup(line);
+        total++;
+    }
+    free(line);
+    fclose(f);
+    if (total == 0) return;
+
+    for (int i = 0; i < history_count; i++) free(command_history[i]);
+    history_count = 0;
+    for (int k = total > MAX_HISTORY ? total - MAX_HISTORY : 0; k < total; k++) {
+        if (tail[k % MAX_HISTORY]) history_push(tail[k % MAX_HISTORY]);
     }
 }
 
+/* Current history entries; returns how many there are */
+int history_get(char *const **entries) {
+    history_load();
+    *entries = command_history;
+    return history_count;
+}
+
+/* Stop (on) or resume recording history; calls nest */
+void history_mute(int on) {
+    history_muted += on ? 1 : -1;
+}
+
+/* Keep (on) or stop appending commands to the history file */
+void history_persist(int on) {
+    history_persisted = on;
+}
+
 /* Persist history to a file in the user's home directory */
 static void persist_history_to_file(const char *command) {
-    const char *home = getenv("HOME");
-    if (!home) return;
     char path[512];
-    snprintf(path, sizeof(path), "%s/.terminal_history", home);
+    if (!history_persisted || !history_path(path, sizeof(path))) return;
 
     FILE *f = fopen(path, "a");
     if (!f) return; /* best-effort */
@@ -82,8 +187,21 @@ int exec_help(char **args) {
     printf("  help                 - Display this help message\n");
     printf("  clear                - Clear the terminal screen\n");
     printf("  cd <directory>       - Change the current directory\n");
-    printf("  count <file>         - Count lines, words, and characters in a file\n");
+    printf("  count <file>...      - Count lines, words, and characters in files\n");
     printf("  history              - Display command history\n");
+    printf("  ls [-aAlhtSrR1d]     - List directory contents (other flags run /bin/ls)\n");
+    printf("  ffind [path] [-name pattern] [-type f|d|l] - Find files (parallel)\n");
+    printf("  fgrep [-inlcrHh] text [path...]           - Search files for text (parallel)\n");
+    printf("  memo <command>       - Run a command, replaying cached output while its inputs are unchanged\n");
+    printf("  memo --clear         - Empty the memo cache\n");
+    printf("  limit [-m SIZE] [-c CPU%%] [-p N] [-t SECS] <command> - Run a command under resource limits\n");
+    printf("  watch [-n SECS] [-f PATH]... [-p PID] <command> - Re-run a command on a timer or when files change\n");
+    printf("  echo [-neE] [text]   - Print text\n");
+    printf("  test EXPR, [ EXPR ]  - Check files, strings and numbers (-f, -d, -z, =, -lt, ...)\n");
+    printf("  true, false, :       - Do nothing, successfully or not\n");
+    printf("  export NAME[=value]  - Set a variable and pass it to commands\n");
+    printf("  unset NAME...        - Remove variables\n");
+    printf("  break [n], continue [n] - Leave or restart the enclosing loop\n");
     printf("  exit                 - Exit the terminal application\n");
     printf("\nEXTERNAL COMMANDS:\n");
     printf("  You can run any Linux command available on your system.\n");
@@ -92,6 +210,12 @@ int exec_help(char **args) {
     printf("  > echo Hello World\n");
     printf("  > ls -la\n");
     printf("  > count /path/to/file.txt\n");
+    printf("  > count $(ls *.txt)\n");
+    printf("  > echo '$HOME is' \"$HOME\"\n");
+    printf("  > tr a-z A-Z <<< hello\n");
+    printf("  > for f in *.c; do count $f; done\n");
+    printf("  > i=0; while ((i < 3)); do echo $i; ((i++)); done\n");
+    printf("  > if test -d src; then echo yes; else echo no; fi\n");
     printf("  > history\n");
     printf("\n════════════════════════════════════════════════════════════════\n");
     printf("\n");
@@ -107,63 +231,92 @@ int exec_clear(char **args) {
     return 0;  /* Return 0 on success for && operator compatibility */
 }
 
-/* Function to count lines, words, and characters in a file */
-int exec_count(char **args) {
-    if (args[1] == NULL) {
-        fprintf(stderr, "count: missing argument - please provide a filename\n");
-        fprintf(stderr, "Usage: count <filename>\n");
-        return 1;
-    }
-    
-    FILE *fp = fopen(args[1], "r");
-    if (!fp) {
-        fprintf(stderr, "count: cannot open file '%s'\n", args[1]);
-        perror("fopen");
-        return 1;
-    }
-    
-    int lines = 0, words = 0, chars = 0;
-    int in_word = 0;
-    int c;
-    
-    while ((c = fgetc(fp)) != EOF) {
-        chars++;
-        
+/* Running totals for one file of count */
+typedef struct {
+    long lines, words, chars;
+    int in_word;
+    int last;            /* last character seen, -1 before the first */
+    int err;
+} CountStats;
+
+static void count_chunk(void *ctx, int i, const char *data, size_t len) {
+    CountStats *st = (CountStats *)ctx + i;
+    int in_word = st->in_word;
+    for (size_t k = 0; k < len; k++) {
+        char c = data[k];
         if (c == '\n') {
-            lines++;
+            st->lines++;
             in_word = 0;
-        } else if (c == ' ' || c == '\t' || c == '\n') {
+        } else if (c == ' ' || c == '\t') {
             in_word = 0;
         } else if (!in_word) {
-            words++;
+            st->words++;
             in_word = 1;
         }
     }
-    
-    /* Handle last line if file doesn't end with newline */
-    if (in_word) {
-        words++;
+    st->chars += (long)len;
+    st->in_word = in_word;
+    st->last = (unsigned char)data[len - 1];
+}
+
+static void count_done(void *ctx, int i, int err) {
+    ((CountStats *)ctx)[i].err = err;
+}
+
+/* Function to count lines, words, and characters in one or more files.
+ * The files are read together through utils/file_io.c. */
+int exec_count(char **args) {
+    if (args[1] == NULL) {
+        fprintf(stderr, "count: missing argument - please provide a filename\n");
+        fprintf(stderr, "Usage: count <filename>...\n");
+        return 1;
     }
-    if (chars > 0 && c != '\n') {
-        lines++;
+
+    int nfiles = 0;
+    while (args[nfiles + 1] != NULL) nfiles++;
+    CountStats *stats = calloc((size_t)nfiles, sizeof(CountStats));
+    if (!stats) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < nfiles; i++) stats[i].last = -1;
+
+    FileIoHandler handler = { count_chunk, count_done, stats };
+    file_io_read((const char *const *)&args[1], nfiles, &handler);
+
+    int ret = 0;
+    for (int i = 0; i < nfiles; i++) {
+        CountStats *st = &stats[i];
+        if (st->err) {
+            fprintf(stderr, "count: cannot open file '%s': %s\n", args[i + 1], strerror(st->err));
+            ret = 1;
+            continue;
+        }
+        /* A last line without a trailing newline still counts */
+        if (st->chars > 0 && st->last != '\n') st->lines++;
+
+        printf("\n");
+        printf("File: %s\n", args[i + 1]);
+        printf("  Lines:      %ld\n", st->lines);
+        printf("  Words:      %ld\n", st->words);
+        printf("  Characters: %ld\n", st->chars);
+        json_records_add("files", 1);
+        json_records_add("lines", st->lines);
+        json_records_add("words", st->words);
+        json_records_add("chars", st->chars);
     }
-    
-    fclose(fp);
-    
-    printf("\n");
-    printf("File: %s\n", args[1]);
-    printf("  Lines:      %d\n", lines);
-    printf("  Words:      %d\n", words);
-    printf("  Characters: %d\n", chars);
     printf("\n");
     fflush(stdout);
-    
-    return 0;  /* Return 0 on success for && operator compatibility */
+    free(stats);
+
+    return ret;  /* Return 0 on success for && operator compatibility */
 }
 
 /* Function to display command history */
 int exec_history(char **args) {
     (void)args;
+    history_load();
+    json_records_add("entries", history_count);
     if (history_count == 0) {
         printf("\nNo command history yet.\n\n");
         fflush(stdout);
@@ -216,6 +369,79 @@ int exec_exit(char **args) {
     return 0; // Return 0 to indicate exit
 }
 
+/* Function to print the arguments: -n drops the newline, -e interprets
+ * backslash escapes (\n, \t, \\, \c stops output), -E turns them off */
+int exec_echo(char **args) {
+    int newline = 1, escapes = 0, i = 1;
+    for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        const char *f = args[i] + 1;
+        if (strspn(f, "neE") != strlen(f)) break;   /* not an option: print it */
+        for (; *f != '\0'; f++) {
+            if (*f == 'n') newline = 0;
+            else escapes = *f == 'e';
+        }
+    }
+    for (int first = i; args[i] != NULL; i++) {
+        if (i > first) putchar(' ');
+        for (const char *p = args[i]; *p != '\0'; p++) {
+            if (!escapes || *p != '\\' || p[1] == '\0') {
+                putchar(*p);
+                continue;
+            }
+            switch (*++p) {
+            case 'n': putchar('\n'); break;
+            case 't': putchar('\t'); break;
+            case '\\': putchar('\\'); break;
+            case 'c':
+                fflush(stdout);
+                return 0;
+            default:
+                putchar('\\');
+                putchar(*p);
+            }
+        }
+    }
+    if (newline) putchar('\n');
+    fflush(stdout);
+    return 0;
+}
+
+int exec_true(char **args) {
+    (void)args;
+    return 0;
+}
+
+int exec_false(char **args) {
+    (void)args;
+    return 1;
+}
+
+/* Function to export variables: NAME=value sets and exports, NAME exports
+ * an existing shell variable */
+int exec_export(char **args) {
+    int ret = 0;
+    for (int i = 1; args[i] != NULL; i++) {
+        const char *eq = strchr(args[i], '=');
+        size_t len = eq ? (size_t)(eq - args[i]) : strlen(args[i]);
+        if (!shell_var_valid(args[i], len)) {
+            fprintf(stderr, "export: '%s': not a valid name\n", args[i]);
+            ret = 1;
+            continue;
+        }
+        char name[256];
+        snprintf(name, sizeof(name), "%.*s", (int)len, args[i]);
+        const char *value = eq ? eq + 1 : shell_var_get(name);
+        if (value != NULL && shell_var_set(name, value, 1) != 0) ret = 1;
+    }
+    return ret;
+}
+
+/* Function to remove variables (from the shell and the environment) */
+int exec_unset(char **args) {
+    for (int i = 1; args[i] != NULL; i++) shell_var_unset(args[i]);
+    return 0;
+}
+
 /* Function to execute built-in commands */
 int exec_builtin(char **args) {
     if (args[0] == NULL) {
@@ -223,7 +449,7 @@ int exec_builtin(char **args) {
     }
     
     /* Add non-control commands to history */
-    add_command_to_history(args[0]);
+    add_argv_to_history(args);
     
     // Check for built-in commands
     if (strcmp(args[0], "about") == 0) {
@@ -240,6 +466,30 @@ int exec_builtin(char **args) {
         return exec_cd(args);
     } else if (strcmp(args[0], "exit") == 0) {
         return exec_exit(args);
+    } else if (strcmp(args[0], "ls") == 0) {
+        return exec_ls(args);
+    } else if (strcmp(args[0], "ffind") == 0) {
+        return exec_ffind(args);
+    } else if (strcmp(args[0], "fgrep") == 0) {
+        return exec_fgrep(args);
+    } else if (strcmp(args[0], "memo") == 0) {
+        return exec_memo(args);
+    } else if (strcmp(args[0], "limit") == 0) {
+        return exec_limit(args);
+    } else if (strcmp(args[0], "watch") == 0) {
+        return exec_watch(args);
+    } else if (strcmp(args[0], "echo") == 0) {
+        return exec_echo(args);
+    } else if (strcmp(args[0], "true") == 0 || strcmp(args[0], ":") == 0) {
+        return exec_true(args);
+    } else if (strcmp(args[0], "false") == 0) {
+        return exec_false(args);
+    } else if (strcmp(args[0], "test") == 0 || strcmp(args[0], "[") == 0) {
+        return exec_test(args);
+    } else if (strcmp(args[0], "export") == 0) {
+        return exec_export(args);
+    } else if (strcmp(args[0], "unset") == 0) {
+        return exec_unset(args);
     }
     
     return 1; // Return 1 if no built-in command matched
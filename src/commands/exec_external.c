@@ -11,22 +11,8 @@
 int exec_external(char **args) {
     if (args == NULL || args[0] == NULL) return -1;
 
-    /* Track the command in history */
-    /* Add full command string (join args) to history */
-    size_t len = 0;
-    for (int i = 0; args[i] != NULL; i++) {
-        len += strlen(args[i]) + 1;
-    }
-    char *cmdstr = malloc(len + 1);
-    if (cmdstr) {
-        cmdstr[0] = '\0';
-        for (int i = 0; args[i] != NULL; i++) {
-            if (i) strcat(cmdstr, " ");
-            strcat(cmdstr, args[i]);
-        }
-        add_command_to_history(cmdstr);
-        free(cmdstr);
-    }
+    /* Track the full command (args joined) in history */
+    add_argv_to_history(args);
 
     pid_t pid = fork();
     if (pid < 0) {
@@ -0,0 +1,401 @@
+// exec_limit.c
+// limit [-m SIZE] [-c CPU] [-p PIDS] [-t SECONDS] command [args...]:
+// run one command under resource limits and report what it used.
+//
+//   -m 512M   memory (memory.max; RLIMIT_AS without cgroups)
+//   -c 50%    CPU quota as a share of one CPU, 150% = one and a half CPUs
+//             (cpu.max; only enforceable with cgroups)
+//   -p 64     tasks (pids.max; RLIMIT_NPROC without cgroups, which counts
+//             every process of the user)
+//   -t 10     wall-clock timeout in seconds (fractions allowed); the command
+//             is killed and the status is 124
+//
+// With a delegated cgroup v2 hierarchy the command runs in a transient leaf
+// cgroup, created next to the shell's own cgroup (or below it when the
+// shell's cgroup may have children with controllers), and removed when the
+// command finishes; a timeout kills everything in it through cgroup.kill.
+// Each limit whose controller is not available in the leaf falls back to
+// setrlimit in the child (the CPU quota is dropped), and without a leaf
+// they all do. Peak memory and CPU time are printed to stderr on
+// completion, from memory.peak and cpu.stat or from the child's rusage.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "executor.h"
+
+#define LIMIT_TIMEOUT_STATUS 124
+#define CPU_PERIOD_US 100000
+
+typedef struct {
+    long long memory;    /* bytes, 0 = unlimited */
+    long cpu_pct;        /* percent of one CPU, 0 = unlimited */
+    long pids;           /* 0 = unlimited */
+    double timeout;      /* seconds, 0 = none */
+} Limits;
+
+/* Limits left to setrlimit, as sent to the child through the gate */
+#define RL_MEMORY 1
+#define RL_PIDS 2
+#define RL_ALL (RL_MEMORY | RL_PIDS)
+
+typedef struct {
+    char path[4096];     /* the leaf; empty when running on rlimits */
+    int rlimits;         /* RL_* limits the leaf could not take */
+    int cpu_unset;       /* cpu.max could not be written */
+} Cgroup;
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* "512M", "2G", "65536"; -1 if malformed */
+static long long parse_bytes(const char *s) {
+    char *end;
+    errno = 0;
+    long long v = strtoll(s, &end, 10);
+    if (end == s || v <= 0 || errno != 0) return -1;
+    switch (*end) {
+    case 'K': case 'k': v <<= 10; end++; break;
+    case 'M': case 'm': v <<= 20; end++; break;
+    case 'G': case 'g': v <<= 30; end++; break;
+    }
+    return *end == '\0' ? v : -1;
+}
+
+/* Options before the command; returns the index of the command or -1 */
+static int parse_limits(char **args, Limits *lim) {
+    memset(lim, 0, sizeof(*lim));
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i += 2) {
+        if (strcmp(args[i], "--") == 0) return args[i + 1] != NULL ? i + 1 : -1;
+        const char *value = args[i + 1];
+        char *end = NULL;
+        if (value == NULL || args[i][1] == '\0' || args[i][2] != '\0') return -1;
+        switch (args[i][1]) {
+        case 'm':
+            if ((lim->memory = parse_bytes(value)) < 0) return -1;
+            break;
+        case 'c':
+            lim->cpu_pct = strtol(value, &end, 10);
+            if (end == value || lim->cpu_pct <= 0 || (*end != '\0' && strcmp(end, "%") != 0)) return -1;
+            break;
+        case 'p':
+            lim->pids = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || lim->pids <= 0) return -1;
+            break;
+        case 't':
+            lim->timeout = strtod(value, &end);
+            if (end == value || *end != '\0' || lim->timeout <= 0) return -1;
+            break;
+        default:
+            return -1;
+        }
+    }
+    return args[i] != NULL ? i : -1;
+}
+
+/* ---- cgroup v2 ---- */
+
+static int write_file(const char *dir, const char *name, const char *value) {
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = write(fd, value, strlen(value));
+    close(fd);
+    return n == (ssize_t)strlen(value) ? 0 : -1;
+}
+
+static int read_file(const char *dir, const char *name, char *buf, size_t size) {
+    char path[4200];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return 0;
+}
+
+/* Value of key in a "key value" file such as cpu.stat; -1 if absent */
+static long long read_key(const char *dir, const char *name, const char *key) {
+    char buf[2048];
+    if (read_file(dir, name, buf, sizeof(buf)) != 0) return -1;
+    size_t klen = strlen(key);
+    for (char *line = buf; *line != '\0';) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ' ') return strtoll(line + klen + 1, NULL, 10);
+        char *nl = strchr(line, '\n');
+        if (nl == NULL) break;
+        line = nl + 1;
+    }
+    return -1;
+}
+
+/* Directory of this process's cgroup on the cgroup2 mount; *root_len is
+ * the length of the mount point in it. 0 on success */
+static int own_cgroup(char *dir, size_t size, size_t *root_len) {
+    char mount[4096] = "", line[8192];
+    FILE *f = fopen("/proc/self/mountinfo", "r");
+    if (f == NULL) return -1;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        /* ... mount-point ... - fstype source options */
+        char *sep = strstr(line, " - cgroup2 ");
+        char point[4096];
+        if (sep != NULL && sscanf(line, "%*s %*s %*s %*s %4095s", point) == 1) {
+            snprintf(mount, sizeof(mount), "%s", point);
+            break;
+        }
+    }
+    fclose(f);
+    if (mount[0] == '\0' || (f = fopen("/proc/self/cgroup", "r")) == NULL) return -1;
+    int found = -1;
+    while (fgets(line, sizeof(line), f) != NULL) {
+        if (strncmp(line, "0::", 3) == 0) {
+            line[strcspn(line, "\n")] = '\0';
+            snprintf(dir, size, "%s%s", mount, strcmp(line + 3, "/") == 0 ? "" : line + 3);
+            *root_len = strlen(mount);
+            found = 0;
+            break;
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+/* Create a leaf under parent and write the requested limits to it; 0 when
+ * the leaf exists. Limits it cannot take are noted in cg for the fallback. */
+static int cgroup_try(Cgroup *cg, const char *parent, const Limits *lim) {
+    static unsigned seq;
+    char value[64];
+    /* Best effort: these fail when already enabled or not delegated, which
+     * the checks below catch */
+    if (lim->memory) write_file(parent, "cgroup.subtree_control", "+memory");
+    if (lim->cpu_pct) write_file(parent, "cgroup.subtree_control", "+cpu");
+    if (lim->pids) write_file(parent, "cgroup.subtree_control", "+pids");
+
+    snprintf(cg->path, sizeof(cg->path), "%s/terminal_app-limit-%d-%u", parent, (int)getpid(), seq++);
+    cg->rlimits = cg->cpu_unset = 0;
+    if (mkdir(cg->path, 0755) != 0) {
+        cg->path[0] = '\0';
+        return -1;
+    }
+    if (lim->memory) {
+        snprintf(value, sizeof(value), "%lld", lim->memory);
+        if (write_file(cg->path, "memory.max", value) != 0) cg->rlimits |= RL_MEMORY;
+        /* Without swap.max the limit would just push the command to swap */
+        else write_file(cg->path, "memory.swap.max", "0");
+    }
+    if (lim->cpu_pct) {
+        snprintf(value, sizeof(value), "%ld %d", lim->cpu_pct * CPU_PERIOD_US / 100, CPU_PERIOD_US);
+        cg->cpu_unset = write_file(cg->path, "cpu.max", value) != 0;
+    }
+    if (lim->pids) {
+        snprintf(value, sizeof(value), "%ld", lim->pids);
+        if (write_file(cg->path, "pids.max", value) != 0) cg->rlimits |= RL_PIDS;
+    }
+    return 0;
+}
+
+/* Limits a leaf could not take */
+static int cgroup_misses(const Cgroup *cg) {
+    return !!(cg->rlimits & RL_MEMORY) + !!(cg->rlimits & RL_PIDS) + cg->cpu_unset;
+}
+
+/* A leaf next to the shell's cgroup (its parent usually has no processes of
+ * its own, so it may enable controllers), else below it */
+static int cgroup_create(Cgroup *cg, const Limits *lim) {
+    char own[4096], parent[4096];
+    size_t root_len;
+    cg->path[0] = '\0';
+    cg->rlimits = cg->cpu_unset = 0;
+    if (own_cgroup(own, sizeof(own), &root_len) != 0) return -1;
+    snprintf(parent, sizeof(parent), "%s", own);
+    char *slash = strrchr(parent, '/');
+    /* Never step above the mount point */
+    if (slash != NULL && (size_t)(slash - parent) >= root_len) {
+        *slash = '\0';
+        if (cgroup_try(cg, parent, lim) == 0 && cgroup_misses(cg) == 0) return 0;
+    }
+    /* Keep whichever leaf takes more of the limits */
+    Cgroup below;
+    if (cgroup_try(&below, own, lim) != 0) return cg->path[0] != '\0' ? 0 : -1;
+    if (cg->path[0] != '\0' && cgroup_misses(cg) <= cgroup_misses(&below)) {
+        rmdir(below.path);
+        return 0;
+    }
+    if (cg->path[0] != '\0') rmdir(cg->path);
+    *cg = below;
+    return 0;
+}
+
+/* Kill what is left in the leaf and remove it */
+static void cgroup_destroy(Cgroup *cg) {
+    if (cg->path[0] == '\0') return;
+    write_file(cg->path, "cgroup.kill", "1");
+    /* The kill is asynchronous: rmdir succeeds once the tasks are gone */
+    for (int tries = 0; rmdir(cg->path) != 0 && errno == EBUSY && tries < 100; tries++) {
+        usleep(1000);
+    }
+}
+
+/* ---- running ---- */
+
+/* The limits in mask (RL_*) that the cgroup does not enforce */
+static void apply_rlimits(const Limits *lim, int mask) {
+    struct rlimit rl;
+    if (lim->memory && (mask & RL_MEMORY)) {
+        rl.rlim_cur = rl.rlim_max = (rlim_t)lim->memory;
+        if (setrlimit(RLIMIT_AS, &rl) != 0) perror("limit: memory");
+    }
+    if (lim->pids && (mask & RL_PIDS)) {
+        rl.rlim_cur = rl.rlim_max = (rlim_t)lim->pids;
+        if (setrlimit(RLIMIT_NPROC, &rl) != 0) perror("limit: pids");
+    }
+}
+
+/* Child side: wait for the parent to place us and say which limits are
+ * still ours to set, then run the command */
+static void run_child(char **argv, int gate, const Limits *lim) {
+    unsigned char rlimits = RL_ALL;
+    if (read(gate, &rlimits, 1) != 1) rlimits = RL_ALL;
+    close(gate);
+    apply_rlimits(lim, rlimits);
+    if (is_builtin(argv[0])) {
+        int status = exec_builtin(argv);
+        fflush(NULL);
+        _exit(status < 0 ? 1 : status & 0xff);
+    }
+    execvp(argv[0], argv);
+    if (errno == ENOENT) {
+        fprintf(stderr, "Command not found: %s\n", argv[0]);
+        _exit(127);
+    }
+    perror("Execution failed");
+    _exit(EXIT_FAILURE);
+}
+
+/* Wait for pid, killing it (and its cgroup) once timeout seconds pass;
+ * sets *timed_out */
+static void wait_child(pid_t pid, const Cgroup *cg, double timeout, int *status, struct rusage *ru, int *timed_out) {
+    *timed_out = 0;
+    if (timeout > 0) {
+        int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+        if (pidfd < 0) {
+            perror("limit: pidfd_open (no timeout)");
+        } else {
+            double deadline = now() + timeout;
+            struct pollfd pfd = { pidfd, POLLIN, 0 };
+            for (;;) {
+                double left = deadline - now();
+                if (left <= 0) {
+                    *timed_out = 1;
+                    if (cg->path[0] == '\0' || write_file(cg->path, "cgroup.kill", "1") != 0) kill(pid, SIGKILL);
+                    break;
+                }
+                int rc = poll(&pfd, 1, (int)(left * 1000) + 1);
+                if (rc > 0 || (rc < 0 && errno != EINTR)) break;
+            }
+            close(pidfd);
+        }
+    }
+    while (wait4(pid, status, 0, ru) < 0 && errno == EINTR) {
+    }
+}
+
+static void report(const Cgroup *cg, const struct rusage *ru, double wall, int timed_out) {
+    double user = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6;
+    double sys = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+    long long peak = (long long)ru->ru_maxrss * 1024;
+    int oom = 0;
+    if (cg->path[0] != '\0') {
+        long long v;
+        char buf[64];
+        if (read_file(cg->path, "memory.peak", buf, sizeof(buf)) == 0) peak = strtoll(buf, NULL, 10);
+        if ((v = read_key(cg->path, "cpu.stat", "user_usec")) >= 0) user = v / 1e6;
+        if ((v = read_key(cg->path, "cpu.stat", "system_usec")) >= 0) sys = v / 1e6;
+        oom = read_key(cg->path, "memory.events", "oom_kill") > 0;
+    }
+    const char *mode = cg->path[0] == '\0' ? "rlimit" : cg->rlimits ? "cgroup + rlimit" : "cgroup";
+    fprintf(stderr, "limit: %s, peak memory %.1f MiB, cpu %.2fs user %.2fs sys, wall %.2fs%s%s\n",
+            mode, peak / 1048576.0, user, sys, wall,
+            timed_out ? ", killed: timeout" : "", oom ? ", killed: out of memory" : "");
+}
+
+/* Function to run a command under resource limits */
+int exec_limit(char **args) {
+    Limits lim;
+    int cmd = parse_limits(args, &lim);
+    if (cmd < 0) {
+        fprintf(stderr, "Usage: limit [-m SIZE] [-c CPU%%] [-p PIDS] [-t SECONDS] command [args...]\n");
+        return 2;
+    }
+
+    Cgroup cg;
+    if ((cgroup_create(&cg, &lim) != 0 || cg.cpu_unset) && lim.cpu_pct) {
+        fprintf(stderr, "limit: a CPU quota needs a delegated cgroup v2 cpu controller; -c ignored\n");
+    }
+
+    int gate[2];
+    if (pipe2(gate, O_CLOEXEC) != 0) {
+        perror("pipe");
+        cgroup_destroy(&cg);
+        return -1;
+    }
+    fflush(stdout);
+    double t0 = now();
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(gate[0]);
+        close(gate[1]);
+        cgroup_destroy(&cg);
+        return -1;
+    }
+    if (pid == 0) {
+        close(gate[1]);
+        run_child(&args[cmd], gate[0], &lim);
+    }
+    close(gate[0]);
+
+    /* Move the child before it runs anything, so nothing escapes the leaf */
+    unsigned char rlimits = RL_ALL;
+    if (cg.path[0] != '\0') {
+        char value[32];
+        snprintf(value, sizeof(value), "%d", (int)pid);
+        if (write_file(cg.path, "cgroup.procs", value) == 0) {
+            rlimits = (unsigned char)cg.rlimits;
+        } else {
+            perror("limit: cgroup.procs (using rlimits)");
+            rmdir(cg.path);
+            cg.path[0] = '\0';
+        }
+    }
+    if (write(gate[1], &rlimits, 1) != 1) perror("limit");
+    close(gate[1]);
+
+    int status = 0, timed_out;
+    struct rusage ru;
+    memset(&ru, 0, sizeof(ru));
+    wait_child(pid, &cg, lim.timeout, &status, &ru, &timed_out);
+    report(&cg, &ru, now() - t0, timed_out);
+    cgroup_destroy(&cg);
+
+    if (timed_out) return LIMIT_TIMEOUT_STATUS;
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : -1;
+}
@@ -0,0 +1,618 @@
+// exec_ls.c
+// Built-in ls: lists directories in the shell process instead of forking
+// /bin/ls for the most common command of a session.
+//
+// Directories are read with getdents64 (utils/dir_read.c). statx is only
+// called when the listing needs something the directory entry does not
+// carry (long format, -t/-S sort keys, the executable bit for color), and
+// only for those fields. User and group names are cached for the session.
+// Output is collected in one buffer and written with a single write().
+//
+// Supported: -a -A -l -h -t -S -r -R -1 -d, --color[=WHEN] and the long
+// forms of those flags. Anything else runs /bin/ls with the same arguments.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pwd.h>
+#include <grp.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include "executor.h"
+#include "../utils/dir_read.h"
+
+#define ID_CACHE_SIZE 64
+#define OUT_FLUSH_AT (8 * 1024 * 1024)
+#define SIX_MONTHS (365.2425 * 24 * 60 * 60 / 2)
+
+enum { SORT_NAME, SORT_TIME, SORT_SIZE };
+
+typedef struct {
+    int all;             /* -a: include . and .. and hidden names */
+    int almost_all;      /* -A: hidden names, not . and .. */
+    int longfmt;         /* -l */
+    int human;           /* -h */
+    int sort;
+    int reverse;         /* -r */
+    int recursive;       /* -R */
+    int one_per_line;    /* -1, or output is not a terminal */
+    int dirs_as_files;   /* -d */
+    int color;
+    int width;
+} LsOptions;
+
+/* Only the statx fields the listing prints or sorts by */
+typedef struct {
+    const char *name;
+    unsigned char type;  /* DT_* */
+    int have_stat;
+    unsigned short mode;
+    unsigned int nlink;
+    unsigned int uid;
+    unsigned int gid;
+    unsigned long long size;
+    unsigned long long blocks;
+    long long mtime_sec;
+    unsigned int mtime_nsec;
+} LsEntry;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} OutBuf;
+
+typedef struct {
+    unsigned int id;
+    char name[33];
+} IdName;
+
+static IdName uid_cache[ID_CACHE_SIZE], gid_cache[ID_CACHE_SIZE];
+static int uid_cached, gid_cached;
+
+static OutBuf out;
+static const LsOptions *sort_opts;
+
+/* ---- output ---- */
+
+static void out_flush(void) {
+    size_t off = 0;
+    while (off < out.len) {
+        ssize_t n = write(STDOUT_FILENO, out.data + off, out.len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += n;
+    }
+    out.len = 0;
+}
+
+static void out_reserve(size_t n) {
+    if (out.len + n <= out.cap) return;
+    if (out.len >= OUT_FLUSH_AT) {
+        out_flush();
+        if (n <= out.cap) return;
+    }
+    size_t cap = out.cap ? out.cap : 65536;
+    while (cap < out.len + n) cap *= 2;
+    char *data = realloc(out.data, cap);
+    if (!data) {
+        out_flush();
+        return;
+    }
+    out.data = data;
+    out.cap = cap;
+}
+
+static void out_write(const char *s, size_t n) {
+    out_reserve(n);
+    if (out.len + n > out.cap) return;
+    memcpy(out.data + out.len, s, n);
+    out.len += n;
+}
+
+static void out_puts(const char *s) {
+    out_write(s, strlen(s));
+}
+
+static void out_printf(const char *fmt, ...) {
+    char tmp[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n > 0) out_write(tmp, n < (int)sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+}
+
+static void out_pad(int n) {
+    while (n-- > 0) out_write(" ", 1);
+}
+
+/* ---- metadata ---- */
+
+static unsigned char mode_to_type(unsigned short mode) {
+    switch (mode & S_IFMT) {
+    case S_IFDIR: return DT_DIR;
+    case S_IFLNK: return DT_LNK;
+    case S_IFREG: return DT_REG;
+    case S_IFIFO: return DT_FIFO;
+    case S_IFSOCK: return DT_SOCK;
+    case S_IFBLK: return DT_BLK;
+    case S_IFCHR: return DT_CHR;
+    }
+    return DT_UNKNOWN;
+}
+
+static unsigned int stat_mask(const LsOptions *o, unsigned char type) {
+    unsigned int mask = 0;
+    if (o->longfmt) {
+        mask |= STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_SIZE | STATX_BLOCKS | STATX_MTIME;
+    }
+    if (o->sort == SORT_TIME) mask |= STATX_MTIME;
+    if (o->sort == SORT_SIZE) mask |= STATX_SIZE;
+    /* Color needs the executable bit of regular files */
+    if (o->color && (type == DT_REG || type == DT_UNKNOWN)) mask |= STATX_MODE;
+    if (type == DT_UNKNOWN) mask |= STATX_TYPE;
+    return mask;
+}
+
+static int fill_stat(LsEntry *e, int dirfd, const char *path, const LsOptions *o, int follow) {
+    unsigned int mask = stat_mask(o, e->type);
+    if (mask == 0) return 0;
+
+    struct statx stx;
+    int flags = AT_NO_AUTOMOUNT | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+    if (statx(dirfd, path, flags, mask, &stx) != 0) return -1;
+    e->have_stat = 1;
+    e->mode = stx.stx_mode;
+    if (stx.stx_mask & STATX_TYPE) e->type = mode_to_type(stx.stx_mode);
+    e->nlink = stx.stx_nlink;
+    e->uid = stx.stx_uid;
+    e->gid = stx.stx_gid;
+    e->size = stx.stx_size;
+    e->blocks = stx.stx_blocks;
+    e->mtime_sec = stx.stx_mtime.tv_sec;
+    e->mtime_nsec = stx.stx_mtime.tv_nsec;
+    return 0;
+}
+
+static const char *cached_name(IdName *cache, int *count, unsigned int id, int is_group) {
+    for (int i = 0; i < *count; i++) {
+        if (cache[i].id == id) return cache[i].name;
+    }
+    IdName *slot = &cache[*count < ID_CACHE_SIZE ? (*count)++ : (int)(id % ID_CACHE_SIZE)];
+    slot->id = id;
+    const char *name = NULL;
+    if (is_group) {
+        struct group *gr = getgrgid(id);
+        if (gr) name = gr->gr_name;
+    } else {
+        struct passwd *pw = getpwuid(id);
+        if (pw) name = pw->pw_name;
+    }
+    if (name) snprintf(slot->name, sizeof(slot->name), "%s", name);
+    else snprintf(slot->name, sizeof(slot->name), "%u", id);
+    return slot->name;
+}
+
+/* ---- formatting helpers ---- */
+
+static int display_width(const char *s) {
+    int w = 0;
+    for (; *s; s++) {
+        if (((unsigned char)*s & 0xc0) != 0x80) w++;
+    }
+    return w;
+}
+
+static const char *entry_color(const LsEntry *e) {
+    switch (e->type) {
+    case DT_DIR: return "01;34";
+    case DT_LNK: return "01;36";
+    case DT_FIFO: return "40;33";
+    case DT_SOCK: return "01;35";
+    case DT_BLK:
+    case DT_CHR: return "40;33;01";
+    case DT_REG:
+        if (e->have_stat && (e->mode & (S_IXUSR | S_IXGRP | S_IXOTH))) return "01;32";
+        return NULL;
+    }
+    return NULL;
+}
+
+static void out_name(const LsEntry *e, const LsOptions *o) {
+    const char *color = o->color ? entry_color(e) : NULL;
+    if (color) {
+        out_printf("\033[%sm", color);
+        out_puts(e->name);
+        out_puts("\033[0m");
+    } else {
+        out_puts(e->name);
+    }
+}
+
+static void human_size(unsigned long long bytes, char *buf, size_t size) {
+    static const char units[] = "KMGTPE";
+    if (bytes < 1024) {
+        snprintf(buf, size, "%llu", bytes);
+        return;
+    }
+    double v = bytes;
+    int u = -1;
+    while (v >= 1024 && u < 5) {
+        v /= 1024;
+        u++;
+    }
+    /* Round up like ls: one decimal below 10, none above */
+    if (v < 10) {
+        double r = (long long)(v * 10 + 0.999999) / 10.0;
+        if (r >= 10) snprintf(buf, size, "%.0f%c", r, units[u]);
+        else snprintf(buf, size, "%.1f%c", r, units[u]);
+    } else {
+        snprintf(buf, size, "%.0f%c", (double)(long long)(v + 0.999999), units[u]);
+    }
+}
+
+static void mode_string(const LsEntry *e, char *buf) {
+    static const char types[] = "?pc?d?b?-?l?s???";
+    unsigned short m = e->mode;
+    buf[0] = types[(m >> 12) & 15];
+    buf[1] = m & S_IRUSR ? 'r' : '-';
+    buf[2] = m & S_IWUSR ? 'w' : '-';
+    buf[3] = m & S_ISUID ? (m & S_IXUSR ? 's' : 'S') : (m & S_IXUSR ? 'x' : '-');
+    buf[4] = m & S_IRGRP ? 'r' : '-';
+    buf[5] = m & S_IWGRP ? 'w' : '-';
+    buf[6] = m & S_ISGID ? (m & S_IXGRP ? 's' : 'S') : (m & S_IXGRP ? 'x' : '-');
+    buf[7] = m & S_IROTH ? 'r' : '-';
+    buf[8] = m & S_IWOTH ? 'w' : '-';
+    buf[9] = m & S_ISVTX ? (m & S_IXOTH ? 't' : 'T') : (m & S_IXOTH ? 'x' : '-');
+    buf[10] = '\0';
+}
+
+static int cmp_entries(const void *a, const void *b) {
+    const LsEntry *x = a, *y = b;
+    int r = 0;
+    if (sort_opts->sort == SORT_TIME) {
+        if (x->mtime_sec != y->mtime_sec) r = x->mtime_sec < y->mtime_sec ? 1 : -1;
+        else if (x->mtime_nsec != y->mtime_nsec) r = x->mtime_nsec < y->mtime_nsec ? 1 : -1;
+    } else if (sort_opts->sort == SORT_SIZE) {
+        if (x->size != y->size) r = x->size < y->size ? 1 : -1;
+    }
+    if (r == 0) r = strcmp(x->name, y->name);
+    return sort_opts->reverse ? -r : r;
+}
+
+/* ---- output formats ---- */
+
+static void print_long(LsEntry *v, size_t n, int dirfd, const LsOptions *o, int with_total) {
+    int wlink = 1, wuser = 1, wgroup = 1, wsize = 1;
+    unsigned long long blocks = 0;
+    char buf[64];
+
+    for (size_t i = 0; i < n; i++) {
+        if (!v[i].have_stat) continue;
+        blocks += v[i].blocks;
+        int w = snprintf(buf, sizeof(buf), "%u", v[i].nlink);
+        if (w > wlink) wlink = w;
+        w = display_width(cached_name(uid_cache, &uid_cached, v[i].uid, 0));
+        if (w > wuser) wuser = w;
+        w = display_width(cached_name(gid_cache, &gid_cached, v[i].gid, 1));
+        if (w > wgroup) wgroup = w;
+        if (o->human) human_size(v[i].size, buf, sizeof(buf));
+        else snprintf(buf, sizeof(buf), "%llu", v[i].size);
+        w = strlen(buf);
+        if (w > wsize) wsize = w;
+    }
+
+    if (with_total) {
+        if (o->human) {
+            human_size(blocks * 512, buf, sizeof(buf));
+            out_printf("total %s\n", buf);
+        } else {
+            out_printf("total %llu\n", (blocks + 1) / 2);
+        }
+    }
+
+    time_t now = time(NULL);
+    for (size_t i = 0; i < n; i++) {
+        LsEntry *e = &v[i];
+        if (!e->have_stat) {
+            out_puts("?????????? ? ? ? ?            ? ");
+            out_name(e, o);
+            out_write("\n", 1);
+            continue;
+        }
+        char mode[11];
+        mode_string(e, mode);
+        const char *user = cached_name(uid_cache, &uid_cached, e->uid, 0);
+        const char *group = cached_name(gid_cache, &gid_cached, e->gid, 1);
+        out_printf("%s %*u ", mode, wlink, e->nlink);
+        out_puts(user);
+        out_pad(wuser - display_width(user) + 1);
+        out_puts(group);
+        out_pad(wgroup - display_width(group) + 1);
+
+        if (o->human) human_size(e->size, buf, sizeof(buf));
+        else snprintf(buf, sizeof(buf), "%llu", e->size);
+        out_printf("%*s ", wsize, buf);
+
+        struct tm tm;
+        time_t t = (time_t)e->mtime_sec;
+        localtime_r(&t, &tm);
+        int recent = t > now - SIX_MONTHS && t <= now + 60 * 60;
+        strftime(buf, sizeof(buf), recent ? "%b %e %H:%M" : "%b %e  %Y", &tm);
+        out_puts(buf);
+        out_write(" ", 1);
+        out_name(e, o);
+
+        if (e->type == DT_LNK) {
+            char target[4096];
+            ssize_t len = readlinkat(dirfd, e->name, target, sizeof(target) - 1);
+            if (len >= 0) {
+                target[len] = '\0';
+                out_puts(" -> ");
+                out_puts(target);
+            }
+        }
+        out_write("\n", 1);
+    }
+}
+
+/* Vertical columns filling the terminal width, like ls on a tty */
+static void print_columns(LsEntry *v, size_t n, const LsOptions *o) {
+    if (n == 0) return;
+    int *w = malloc(n * sizeof(int));
+    if (!w) return;
+    int maxw = 0;
+    for (size_t i = 0; i < n; i++) {
+        w[i] = display_width(v[i].name);
+        if (w[i] > maxw) maxw = w[i];
+    }
+
+    size_t cols = 1, rows = n;
+    int *colw = malloc(n * sizeof(int));
+    if (colw && !o->one_per_line) {
+        /* Widest layout whose columns (name + 2 spaces) still fit */
+        size_t max_cols = (size_t)o->width / 3 + 1;
+        if (max_cols > n) max_cols = n;
+        for (size_t c = max_cols; c > 1; c--) {
+            size_t r = (n + c - 1) / c;
+            size_t real_cols = (n + r - 1) / r;
+            int total = 0;
+            for (size_t col = 0; col < real_cols && total <= o->width; col++) {
+                int cw = 0;
+                for (size_t i = col * r; i < (col + 1) * r && i < n; i++) {
+                    if (w[i] > cw) cw = w[i];
+                }
+                colw[col] = cw;
+                total += cw + (col + 1 < real_cols ? 2 : 0);
+            }
+            if (total < o->width) {
+                cols = real_cols;
+                rows = r;
+                break;
+            }
+        }
+    }
+
+    if (cols == 1) {
+        for (size_t i = 0; i < n; i++) {
+            out_name(&v[i], o);
+            out_write("\n", 1);
+        }
+    } else {
+        for (size_t r = 0; r < rows; r++) {
+            for (size_t c = 0; c < cols; c++) {
+                size_t i = c * rows + r;
+                if (i >= n) break;
+                out_name(&v[i], o);
+                if (c + 1 < cols && (c + 1) * rows + r < n) out_pad(colw[c] - w[i] + 2);
+            }
+            out_write("\n", 1);
+        }
+    }
+    free(colw);
+    free(w);
+}
+
+static void print_entries(LsEntry *v, size_t n, int dirfd, const LsOptions *o, int with_total) {
+    if (o->longfmt) print_long(v, n, dirfd, o, with_total);
+    else print_columns(v, n, o);
+}
+
+/* ---- listing ---- */
+
+static int list_directory(const char *path, const LsOptions *o, int header, int *first) {
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DirList list;
+    if (fd < 0 || dir_read_fd(fd, &list, o->all) != 0) {
+        int err = errno;
+        if (fd >= 0) close(fd);
+        out_flush();
+        fprintf(stderr, "ls: cannot open directory '%s': %s\n", path, strerror(err));
+        return 1;
+    }
+
+    LsEntry *v = calloc(list.count ? list.count : 1, sizeof(LsEntry));
+    size_t n = 0;
+    for (size_t i = 0; v && i < list.count; i++) {
+        const char *name = DIR_ENTRY_NAME(&list, i);
+        if (name[0] == '.' && !o->all && !o->almost_all) continue;
+        LsEntry *e = &v[n++];
+        e->name = name;
+        e->type = list.entries[i].type;
+        fill_stat(e, fd, name, o, 0);
+    }
+
+    if (!*first) out_write("\n", 1);
+    *first = 0;
+    if (header) out_printf("%s:\n", path);
+
+    sort_opts = o;
+    qsort(v, n, sizeof(LsEntry), cmp_entries);
+    print_entries(v, n, fd, o, 1);
+
+    int status = 0;
+    if (o->recursive) {
+        for (size_t i = 0; i < n; i++) {
+            const char *name = v[i].name;
+            if (v[i].type == DT_UNKNOWN) {
+                LsEntry probe = v[i];
+                LsOptions type_only = { 0 };
+                fill_stat(&probe, fd, name, &type_only, 0);
+                v[i].type = probe.type;
+            }
+            if (v[i].type != DT_DIR) continue;
+            if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+
+            size_t plen = strlen(path);
+            char *sub = malloc(plen + strlen(name) + 2);
+            if (!sub) continue;
+            sprintf(sub, "%s%s%s", path, plen && path[plen - 1] == '/' ? "" : "/", name);
+            if (list_directory(sub, o, 1, first) != 0) status = 1;
+            free(sub);
+        }
+    }
+
+    free(v);
+    dir_list_free(&list);
+    close(fd);
+    return status;
+}
+
+/* 0 = ok, 1 = run /bin/ls instead, 2 = usage error */
+static int parse_options(char **args, LsOptions *o, int *first_operand) {
+    int i = 1;
+    int color_mode = 0;  /* 0 never, 1 always, 2 auto */
+    for (; args[i] != NULL; i++) {
+        const char *a = args[i];
+        if (a[0] != '-' || a[1] == '\0') break;
+        if (strcmp(a, "--") == 0) {
+            i++;
+            break;
+        }
+        if (a[1] == '-') {
+            if (strcmp(a, "--all") == 0) o->all = 1;
+            else if (strcmp(a, "--almost-all") == 0) o->almost_all = 1;
+            else if (strcmp(a, "--human-readable") == 0) o->human = 1;
+            else if (strcmp(a, "--recursive") == 0) o->recursive = 1;
+            else if (strcmp(a, "--reverse") == 0) o->reverse = 1;
+            else if (strcmp(a, "--directory") == 0) o->dirs_as_files = 1;
+            else if (strcmp(a, "--color") == 0) color_mode = 1;
+            else if (strncmp(a, "--color=", 8) == 0) {
+                const char *when = a + 8;
+                if (!strcmp(when, "always") || !strcmp(when, "yes") || !strcmp(when, "force")) color_mode = 1;
+                else if (!strcmp(when, "auto") || !strcmp(when, "tty") || !strcmp(when, "if-tty")) color_mode = 2;
+                else if (!strcmp(when, "never") || !strcmp(when, "no") || !strcmp(when, "none")) color_mode = 0;
+                else return 1;
+            } else {
+                return 1;
+            }
+            continue;
+        }
+        for (const char *f = a + 1; *f; f++) {
+            switch (*f) {
+            case 'a': o->all = 1; break;
+            case 'A': o->almost_all = 1; break;
+            case 'l': o->longfmt = 1; break;
+            case 'h': o->human = 1; break;
+            case 't': o->sort = SORT_TIME; break;
+            case 'S': o->sort = SORT_SIZE; break;
+            case 'r': o->reverse = 1; break;
+            case 'R': o->recursive = 1; break;
+            case '1': o->one_per_line = 1; break;
+            case 'd': o->dirs_as_files = 1; break;
+            default: return 1;
+            }
+        }
+    }
+    *first_operand = i;
+
+    int tty = isatty(STDOUT_FILENO);
+    o->color = color_mode == 1 || (color_mode == 2 && tty);
+    if (!tty) o->one_per_line = 1;
+
+    struct winsize ws;
+    const char *columns = getenv("COLUMNS");
+    if (tty && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) o->width = ws.ws_col;
+    else if (columns && atoi(columns) > 0) o->width = atoi(columns);
+    else o->width = 80;
+    return 0;
+}
+
+/* The system ls, for options this one lacks; the line is already in
+ * history */
+static int run_fallback(char **args) {
+    out_flush();
+    history_mute(1);
+    int ret = exec_external(args);
+    history_mute(0);
+    return ret;
+}
+
+/* Function to list directory contents (ls) */
+int exec_ls(char **args) {
+    LsOptions o = { 0 };
+    int first_operand;
+    if (parse_options(args, &o, &first_operand) != 0) {
+        return run_fallback(args);
+    }
+    fflush(stdout);
+
+    static char *dot[] = { ".", NULL };
+    char **operands = args[first_operand] ? args + first_operand : dot;
+    int noperands = 0;
+    while (operands[noperands]) noperands++;
+
+    /* Operands: files are listed together first, then each directory */
+    LsEntry *files = calloc(noperands, sizeof(LsEntry));
+    const char **dirs = calloc(noperands, sizeof(char *));
+    int nfiles = 0, ndirs = 0, status = 0;
+    if (!files || !dirs) {
+        free(files);
+        free(dirs);
+        perror("ls");
+        return 2;
+    }
+
+    LsOptions probe = o;
+    probe.color = 1;     /* always learn the type of an operand */
+    for (int i = 0; i < noperands; i++) {
+        LsEntry e = { .name = operands[i], .type = DT_UNKNOWN };
+        /* Like ls: follow symlinked operands unless -l or -d */
+        int follow = !o.longfmt && !o.dirs_as_files;
+        if (fill_stat(&e, AT_FDCWD, operands[i], &probe, follow) != 0 &&
+            (!follow || fill_stat(&e, AT_FDCWD, operands[i], &probe, 0) != 0)) {
+            fprintf(stderr, "ls: cannot access '%s': %s\n", operands[i], strerror(errno));
+            status = 2;
+            continue;
+        }
+        if (e.type == DT_DIR && !o.dirs_as_files) dirs[ndirs++] = operands[i];
+        else files[nfiles++] = e;
+    }
+
+    int first = 1;
+    if (nfiles > 0) {
+        sort_opts = &o;
+        qsort(files, nfiles, sizeof(LsEntry), cmp_entries);
+        print_entries(files, nfiles, AT_FDCWD, &o, 0);
+        first = 0;
+    }
+
+    int header = noperands > 1 || o.recursive;
+    for (int i = 0; i < ndirs; i++) {
+        if (list_directory(dirs[i], &o, header, &first) != 0 && status == 0) status = 1;
+    }
+
+    out_flush();
+    free(files);
+    free(dirs);
+    return status;
+}
@@ -0,0 +1,310 @@
+// exec_memo.c
+// memo <command>: run a read-only command once and replay its output while
+// nothing it depends on has changed.
+//
+// The cache key hashes argv, the working directory, the environment
+// variables that commonly change output (MEMO_ENV_VARS) and the identity
+// (device, inode, size, mtime, ctime) of the working directory, of the
+// executable and of every argument that names an existing file or
+// directory. Directories are keyed on their own entry only, not on
+// everything below them. Commands that cannot be found, or exit with 126
+// or 127 (not run), are never cached.
+//
+// Entries live in $XDG_CACHE_HOME/terminal_app/memo (~/.cache by default),
+// one file per key: a small header with the exit status followed by the
+// captured stdout. Hits are streamed to stdout with sendfile(). The cache
+// is an LRU bounded by MEMO_CACHE_MAX bytes: a hit refreshes the entry's
+// mtime, and a store evicts the oldest entries until the total fits.
+// stderr is passed through on a miss and not replayed on a hit.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include "executor.h"
+#include "../utils/capture.h"
+#include "../utils/dir_read.h"
+
+#define MEMO_CACHE_MAX (64L * 1024 * 1024)
+#define MEMO_MAGIC "MEMO0001"
+
+static const char *const MEMO_ENV_VARS[] = {
+    "PATH", "LANG", "LC_ALL", "LC_CTYPE", "LC_COLLATE", "LC_TIME", "TZ", NULL
+};
+
+typedef struct {
+    char magic[8];
+    int32_t status;
+    uint32_t reserved;
+    uint64_t length;     /* bytes of stdout after the header */
+} MemoHeader;
+
+/* Two FNV-1a streams with different offsets make a 128-bit key */
+typedef struct {
+    uint64_t a, b;
+} MemoHash;
+
+static void hash_bytes(MemoHash *h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h->a = (h->a ^ p[i]) * 0x100000001b3ULL;
+        h->b = (h->b ^ p[i]) * 0x100000001b3ULL;
+    }
+}
+
+/* Strings are hashed with their terminator so "ab","c" != "a","bc" */
+static void hash_string(MemoHash *h, const char *s) {
+    hash_bytes(h, s ? s : "", s ? strlen(s) + 1 : 1);
+}
+
+static void hash_stat(MemoHash *h, const struct stat *st) {
+    uint64_t fields[] = {
+        (uint64_t)st->st_dev, (uint64_t)st->st_ino, (uint64_t)st->st_size,
+        (uint64_t)st->st_mtim.tv_sec, (uint64_t)st->st_mtim.tv_nsec,
+        (uint64_t)st->st_ctim.tv_sec, (uint64_t)st->st_ctim.tv_nsec
+    };
+    hash_bytes(h, fields, sizeof(fields));
+}
+
+/* stat the file execvp would run for name; 0 on success */
+static int stat_executable(const char *name, struct stat *st) {
+    if (strchr(name, '/') != NULL) return stat(name, st);
+    const char *path = getenv("PATH");
+    if (path == NULL) return -1;
+
+    char candidate[4096];
+    while (*path != '\0') {
+        const char *end = strchr(path, ':');
+        size_t len = end ? (size_t)(end - path) : strlen(path);
+        snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)len, len ? path : ".", name);
+        if (stat(candidate, st) == 0 && S_ISREG(st->st_mode) && access(candidate, X_OK) == 0) return 0;
+        if (end == NULL) break;
+        path = end + 1;
+    }
+    return -1;
+}
+
+/* Key for argv; -1 when the executable cannot be found (nothing to key on) */
+static int memo_key(char **argv, char *key, size_t size) {
+    MemoHash h = { 0xcbf29ce484222325ULL, 0x84222325cbf29ce4ULL };
+    struct stat st;
+    char cwd[4096];
+
+    for (int i = 0; argv[i] != NULL; i++) hash_string(&h, argv[i]);
+    hash_bytes(&h, "", 1);
+    hash_string(&h, getcwd(cwd, sizeof(cwd)) ? cwd : NULL);
+    /* Entries added or removed in the cwd change its mtime */
+    if (stat(".", &st) == 0) hash_stat(&h, &st);
+    for (int i = 0; MEMO_ENV_VARS[i] != NULL; i++) hash_string(&h, getenv(MEMO_ENV_VARS[i]));
+
+    if (!is_builtin(argv[0])) {
+        if (stat_executable(argv[0], &st) != 0) return -1;
+        hash_stat(&h, &st);
+    }
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (stat(argv[i], &st) == 0) {
+            hash_bytes(&h, &i, sizeof(i));
+            hash_stat(&h, &st);
+        }
+    }
+    snprintf(key, size, "%016llx%016llx", (unsigned long long)h.a, (unsigned long long)h.b);
+    return 0;
+}
+
+/* Cache directory, created on first use; 0 on success */
+static int memo_dir(char *dir, size_t size) {
+    const char *base = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    if (base != NULL && base[0] == '/') {
+        snprintf(dir, size, "%s", base);
+    } else if (home != NULL) {
+        snprintf(dir, size, "%s/.cache", home);
+    } else {
+        return -1;
+    }
+    mkdir(dir, 0700);
+    size_t len = strlen(dir);
+    snprintf(dir + len, size - len, "/terminal_app");
+    mkdir(dir, 0700);
+    len = strlen(dir);
+    snprintf(dir + len, size - len, "/memo");
+    if (mkdir(dir, 0700) != 0 && errno != EEXIST) return -1;
+    return 0;
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Replay a cached entry to stdout. Returns its exit status, or -1 when
+ * the entry is missing or unreadable (run the command instead). */
+static int memo_replay(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    MemoHeader hdr;
+    struct stat st;
+    if (read(fd, &hdr, sizeof(hdr)) != (ssize_t)sizeof(hdr) ||
+        memcmp(hdr.magic, MEMO_MAGIC, sizeof(hdr.magic)) != 0 ||
+        fstat(fd, &st) != 0 || (uint64_t)st.st_size != sizeof(hdr) + hdr.length) {
+        close(fd);
+        unlink(path);
+        return -1;
+    }
+
+    /* Refresh the LRU position */
+    futimens(fd, NULL);
+
+    fflush(stdout);
+    off_t off = sizeof(hdr);
+    uint64_t left = hdr.length;
+    while (left > 0) {
+        ssize_t n = sendfile(STDOUT_FILENO, fd, &off, left);
+        if (n > 0) {
+            left -= (uint64_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            /* stdout that sendfile cannot write to (e.g. opened O_APPEND) */
+            char buf[65536];
+            ssize_t r;
+            while (left > 0 && (r = pread(fd, buf, sizeof(buf), off)) > 0) {
+                if (write_all(STDOUT_FILENO, buf, (size_t)r) != 0) break;
+                off += r;
+                left -= (uint64_t)r;
+            }
+        }
+        break;
+    }
+    close(fd);
+    return hdr.status;
+}
+
+typedef struct {
+    char *name;
+    off_t size;
+    struct timespec mtime;
+} CacheEntry;
+
+static int entry_cmp(const void *a, const void *b) {
+    const CacheEntry *x = a, *y = b;
+    if (x->mtime.tv_sec != y->mtime.tv_sec) return x->mtime.tv_sec < y->mtime.tv_sec ? -1 : 1;
+    if (x->mtime.tv_nsec != y->mtime.tv_nsec) return x->mtime.tv_nsec < y->mtime.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+/* Delete the least recently used entries until the cache fits in limit
+ * bytes (limit 0 empties it) */
+static void memo_evict(const char *dir, long limit) {
+    int dfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dfd < 0) return;
+    DirList list;
+    if (dir_read_fd(dfd, &list, 0) != 0) {
+        close(dfd);
+        return;
+    }
+
+    CacheEntry *entries = malloc((list.count ? list.count : 1) * sizeof(CacheEntry));
+    size_t n = 0;
+    long total = 0;
+    for (size_t i = 0; entries && i < list.count; i++) {
+        struct stat st;
+        char *name = DIR_ENTRY_NAME(&list, i);
+        if (fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) continue;
+        entries[n].name = name;
+        entries[n].size = st.st_size;
+        entries[n].mtime = st.st_mtim;
+        total += st.st_size;
+        n++;
+    }
+    if (entries && total > limit) {
+        qsort(entries, n, sizeof(CacheEntry), entry_cmp);
+        for (size_t i = 0; i < n && total > limit; i++) {
+            if (unlinkat(dfd, entries[i].name, 0) == 0) total -= entries[i].size;
+        }
+    }
+    free(entries);
+    dir_list_free(&list);
+    close(dfd);
+}
+
+static void memo_store(const char *dir, const char *path, int status, const OutputBuffer *out) {
+    char tmp[4200];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+
+    MemoHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, MEMO_MAGIC, sizeof(hdr.magic));
+    hdr.status = status;
+    hdr.length = out->len;
+    int ok = write_all(fd, (const char *)&hdr, sizeof(hdr)) == 0 &&
+             write_all(fd, out->data, out->len) == 0;
+    if (close(fd) != 0) ok = 0;
+    /* rename makes the entry appear complete or not at all */
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return;
+    }
+    memo_evict(dir, MEMO_CACHE_MAX);
+}
+
+/* Run the memoized command; the memo line is what history records */
+static int run_argv(void *arg) {
+    char **argv = arg;
+    history_mute(1);
+    int ret = is_builtin(argv[0]) ? exec_builtin(argv) : exec_external(argv);
+    history_mute(0);
+    return ret;
+}
+
+/* Function to run a command through the output cache */
+int exec_memo(char **args) {
+    char dir[4096], key[40], path[4200];
+
+    if (args[1] == NULL) {
+        fprintf(stderr, "Usage: memo <command> [args...] | memo --clear\n");
+        return 1;
+    }
+    if (memo_dir(dir, sizeof(dir)) != 0) {
+        /* No cache available: just run the command */
+        return run_argv(&args[1]);
+    }
+    if (strcmp(args[1], "--clear") == 0) {
+        memo_evict(dir, 0);
+        return 0;
+    }
+
+    if (memo_key(&args[1], key, sizeof(key)) != 0) return run_argv(&args[1]);
+    snprintf(path, sizeof(path), "%s/%s", dir, key);
+
+    int status = memo_replay(path);
+    if (status >= 0) return status;
+
+    OutputBuffer out = { NULL, 0, 0 };
+    status = capture_stdout(run_argv, &args[1], &out);
+    if (out.len > 0 && write_all(STDOUT_FILENO, out.data, out.len) != 0) perror("memo");
+    /* A command that could not run (or was killed) is not cached */
+    if (status >= 0 && status != 126 && status != 127 && (long)out.len < MEMO_CACHE_MAX) {
+        memo_store(dir, path, status, &out);
+    }
+    output_buffer_free(&out);
+    return status;
+}
@@ -0,0 +1,630 @@
+// exec_search.c
+// Built-in ffind and fgrep: recursive file-name and fixed-string searches
+// that run on every core instead of a single find | grep pipeline.
+//
+// The tree is walked by a work-stealing pool (utils/work_pool.c). Every
+// directory (and, for fgrep, every file) becomes a node; a worker fills the
+// node's output text and links its child nodes at the text position where
+// their output belongs. The shell thread writes the tree out depth first,
+// waiting on a node only when it is the next one due, so results stream in
+// the same sorted order on every run while the workers run ahead.
+//
+// File contents are mmapped and searched with memmem/memchr (vectorized in
+// glibc); lines are only located around actual matches.
+//
+//   ffind [PATH...] [-name PATTERN] [-type f|d|l]
+//   fgrep [-i] [-n] [-l] [-c] [-r] [-H|-h] PATTERN [PATH...]
+//
+// Anything else runs the system find / fgrep.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "executor.h"
+#include "../utils/dir_read.h"
+#include "../utils/glob_expand.h"
+#include "../utils/work_pool.h"
+
+#define OUT_BUF_SIZE (256 * 1024)
+#define BINARY_PROBE 8192
+
+enum { MODE_FIND, MODE_GREP };
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} TextBuf;
+
+typedef struct SearchNode SearchNode;
+
+typedef struct {
+    size_t at;           /* child output goes before text[at] */
+    SearchNode *node;
+} NodeKid;
+
+struct SearchNode {
+    char *path;
+    unsigned char type;  /* DT_DIR: walk it; otherwise a file to search */
+    atomic_int done;
+    TextBuf text;
+    NodeKid *kids;
+    size_t nkids;
+    size_t kids_cap;
+};
+
+typedef struct {
+    int mode;
+
+    /* ffind */
+    const char *name_pattern;
+    char type_filter;    /* 'f', 'd', 'l' or 0 */
+
+    /* fgrep */
+    const char *pattern;
+    size_t pattern_len;
+    int ignore_case;
+    int line_numbers;
+    int files_only;
+    int count_only;
+    int with_names;
+    int color;
+
+    atomic_int matched;
+    atomic_int failed;
+
+    /* The writer waits here for the node it needs next */
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    _Atomic(SearchNode *) waiting;
+
+    char out[OUT_BUF_SIZE];
+    size_t out_len;
+} SearchJob;
+
+/* ---- buffers ---- */
+
+static int text_append(TextBuf *t, const char *s, size_t n) {
+    if (t->len + n > t->cap) {
+        size_t cap = t->cap ? t->cap : 256;
+        while (cap < t->len + n) cap *= 2;
+        char *data = realloc(t->data, cap);
+        if (!data) return -1;
+        t->data = data;
+        t->cap = cap;
+    }
+    memcpy(t->data + t->len, s, n);
+    t->len += n;
+    return 0;
+}
+
+static void text_puts(TextBuf *t, const char *s) {
+    text_append(t, s, strlen(s));
+}
+
+static void out_flush(SearchJob *job) {
+    size_t off = 0;
+    while (off < job->out_len) {
+        ssize_t n = write(STDOUT_FILENO, job->out + off, job->out_len - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        off += n;
+    }
+    job->out_len = 0;
+}
+
+static void out_write(SearchJob *job, const char *s, size_t n) {
+    if (n == 0) return;
+    if (n >= OUT_BUF_SIZE) {
+        out_flush(job);
+        job->out_len = 0;
+        while (n > 0) {
+            ssize_t w = write(STDOUT_FILENO, s, n);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            s += w;
+            n -= w;
+        }
+        return;
+    }
+    if (job->out_len + n > OUT_BUF_SIZE) out_flush(job);
+    memcpy(job->out + job->out_len, s, n);
+    job->out_len += n;
+}
+
+/* ---- nodes ---- */
+
+static SearchNode *node_new(const char *dir, const char *name, unsigned char type) {
+    SearchNode *n = calloc(1, sizeof(SearchNode));
+    if (!n) return NULL;
+    size_t dlen = dir ? strlen(dir) : 0;
+    size_t nlen = strlen(name);
+    n->path = malloc(dlen + nlen + 2);
+    if (!n->path) {
+        free(n);
+        return NULL;
+    }
+    if (dir) {
+        memcpy(n->path, dir, dlen);
+        if (dlen > 0 && dir[dlen - 1] != '/') n->path[dlen++] = '/';
+    }
+    memcpy(n->path + dlen, name, nlen + 1);
+    n->type = type;
+    return n;
+}
+
+static int node_add_kid(SearchNode *parent, SearchNode *kid) {
+    if (parent->nkids == parent->kids_cap) {
+        size_t cap = parent->kids_cap ? parent->kids_cap * 2 : 16;
+        NodeKid *kids = realloc(parent->kids, cap * sizeof(NodeKid));
+        if (!kids) return -1;
+        parent->kids = kids;
+        parent->kids_cap = cap;
+    }
+    parent->kids[parent->nkids].at = parent->text.len;
+    parent->kids[parent->nkids].node = kid;
+    parent->nkids++;
+    return 0;
+}
+
+static void node_free(SearchNode *n) {
+    free(n->path);
+    free(n->text.data);
+    free(n->kids);
+    free(n);
+}
+
+static void node_finish(SearchJob *job, SearchNode *n) {
+    atomic_store(&n->done, 1);
+    if (atomic_load(&job->waiting) == n) {
+        pthread_mutex_lock(&job->lock);
+        pthread_cond_broadcast(&job->cond);
+        pthread_mutex_unlock(&job->lock);
+    }
+}
+
+/* ---- fgrep kernel ---- */
+
+/* Next occurrence of the pattern in [p, end) */
+static const char *find_match(const SearchJob *job, const char *p, const char *end) {
+    size_t plen = job->pattern_len;
+    if ((size_t)(end - p) < plen) return NULL;
+    if (!job->ignore_case) return memmem(p, end - p, job->pattern, plen);
+
+    unsigned char lo = tolower((unsigned char)job->pattern[0]);
+    unsigned char up = toupper((unsigned char)job->pattern[0]);
+    const char *last = end - plen;
+    while (p <= last) {
+        const char *a = memchr(p, lo, last - p + 1);
+        const char *b = lo == up ? NULL : memchr(p, up, (a ? a : last + 1) - p);
+        const char *c = b ? b : a;
+        if (!c) return NULL;
+        if (strncasecmp(c, job->pattern, plen) == 0) return c;
+        p = c + 1;
+    }
+    return NULL;
+}
+
+static size_t count_lines(const char *p, const char *end) {
+    size_t n = 0;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+        n++;
+        p++;
+    }
+    return n;
+}
+
+static void grep_line(SearchJob *job, SearchNode *n, const char *line, const char *eol, size_t lnum) {
+    TextBuf *t = &n->text;
+    char num[32];
+
+    if (job->with_names) {
+        if (job->color) text_puts(t, "\033[35m");
+        text_puts(t, n->path);
+        text_puts(t, job->color ? "\033[m\033[36m:\033[m" : ":");
+    }
+    if (job->line_numbers) {
+        snprintf(num, sizeof(num), job->color ? "\033[32m%zu\033[m\033[36m:\033[m" : "%zu:", lnum);
+        text_puts(t, num);
+    }
+    if (!job->color) {
+        text_append(t, line, eol - line);
+    } else {
+        const char *p = line;
+        const char *m;
+        while ((m = find_match(job, p, eol)) != NULL) {
+            text_append(t, p, m - p);
+            text_puts(t, "\033[01;31m");
+            text_append(t, m, job->pattern_len);
+            text_puts(t, "\033[m");
+            p = m + job->pattern_len;
+        }
+        text_append(t, p, eol - p);
+    }
+    text_append(t, "\n", 1);
+}
+
+static void grep_buffer(SearchJob *job, SearchNode *n, const char *data, size_t len) {
+    const char *end = data + len;
+    const char *pos = data;
+    const char *counted = data;
+    size_t lnum = 1, count = 0;
+    int binary = memchr(data, '\0', len < BINARY_PROBE ? len : BINARY_PROBE) != NULL;
+
+    const char *m;
+    while (pos < end && (m = find_match(job, pos, end)) != NULL) {
+        const char *bol = memrchr(pos, '\n', m - pos);
+        bol = bol ? bol + 1 : pos;
+        const char *eol = memchr(m, '\n', end - m);
+        if (!eol) eol = end;
+        count++;
+
+        if (job->files_only || (binary && !job->count_only)) break;
+        if (!job->count_only) {
+            if (job->line_numbers) {
+                lnum += count_lines(counted, bol);
+                counted = bol;
+            }
+            grep_line(job, n, bol, eol, lnum);
+        }
+        pos = eol + 1;
+    }
+
+    if (count > 0) atomic_store(&job->matched, 1);
+    if (job->count_only) {
+        char num[32];
+        if (job->with_names) {
+            text_puts(&n->text, n->path);
+            text_puts(&n->text, ":");
+        }
+        snprintf(num, sizeof(num), "%zu\n", count);
+        text_puts(&n->text, num);
+    } else if (count > 0 && job->files_only) {
+        text_puts(&n->text, n->path);
+        text_puts(&n->text, "\n");
+    } else if (count > 0 && binary) {
+        text_puts(&n->text, "Binary file ");
+        text_puts(&n->text, n->path);
+        text_puts(&n->text, " matches\n");
+    }
+}
+
+static void grep_file(SearchJob *job, SearchNode *n) {
+    int fd = open(n->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "fgrep: %s: %s\n", n->path, strerror(errno));
+        atomic_store(&job->failed, 1);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        close(fd);
+        return;
+    }
+
+    if (S_ISREG(st.st_mode) && st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            grep_buffer(job, n, map, st.st_size);
+            munmap(map, st.st_size);
+            close(fd);
+            return;
+        }
+    }
+
+    /* Pipes, /proc files and other things without a usable size */
+    TextBuf data = { 0 };
+    char buf[65536];
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        if (text_append(&data, buf, r) != 0) break;
+    }
+    close(fd);
+    if (data.len > 0) grep_buffer(job, n, data.data, data.len);
+    free(data.data);
+}
+
+/* ---- walker ---- */
+
+static const char *base_name(const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash && slash[1] != '\0' ? slash + 1 : path;
+}
+
+static int find_selects(const SearchJob *job, const char *name, unsigned char type) {
+    if (job->type_filter == 'f' && type != DT_REG) return 0;
+    if (job->type_filter == 'd' && type != DT_DIR) return 0;
+    if (job->type_filter == 'l' && type != DT_LNK) return 0;
+    return !job->name_pattern || glob_match(job->name_pattern, name);
+}
+
+static unsigned char type_of(int dirfd, const char *name, unsigned char type) {
+    if (type != DT_UNKNOWN) return type;
+    struct stat st;
+    if (fstatat(dirfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) return DT_UNKNOWN;
+    if (S_ISDIR(st.st_mode)) return DT_DIR;
+    if (S_ISREG(st.st_mode)) return DT_REG;
+    if (S_ISLNK(st.st_mode)) return DT_LNK;
+    return DT_UNKNOWN;
+}
+
+static int cmp_entry_names(const void *a, const void *b, void *list) {
+    return strcmp(DIR_ENTRY_NAME((const DirList *)list, *(const size_t *)a),
+                  DIR_ENTRY_NAME((const DirList *)list, *(const size_t *)b));
+}
+
+static void process_node(WorkPool *pool, int worker, void *task, void *ctx);
+
+static void walk_directory(WorkPool *pool, int worker, SearchJob *job, SearchNode *n) {
+    int fd = open(n->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DirList list;
+    if (fd < 0 || dir_read_fd(fd, &list, 0) != 0) {
+        fprintf(stderr, "%s: '%s': %s\n", job->mode == MODE_FIND ? "ffind" : "fgrep",
+                n->path, strerror(errno));
+        atomic_store(&job->failed, 1);
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    size_t *order = malloc((list.count ? list.count : 1) * sizeof(size_t));
+    if (!order) {
+        dir_list_free(&list);
+        close(fd);
+        return;
+    }
+    for (size_t i = 0; i < list.count; i++) order[i] = i;
+    qsort_r(order, list.count, sizeof(size_t), cmp_entry_names, &list);
+
+    for (size_t i = 0; i < list.count; i++) {
+        const char *name = DIR_ENTRY_NAME(&list, order[i]);
+        unsigned char type = type_of(fd, name, list.entries[order[i]].type);
+
+        if (job->mode == MODE_FIND) {
+            if (find_selects(job, name, type)) {
+                text_puts(&n->text, n->path);
+                if (n->path[strlen(n->path) - 1] != '/') text_puts(&n->text, "/");
+                text_puts(&n->text, name);
+                text_puts(&n->text, "\n");
+            }
+            if (type != DT_DIR) continue;
+        } else if (type != DT_DIR && type != DT_REG) {
+            continue;    /* like grep -r: symlinks and devices are skipped */
+        }
+
+        SearchNode *kid = node_new(n->path, name, type);
+        if (!kid || node_add_kid(n, kid) != 0) {
+            if (kid) node_free(kid);
+            continue;
+        }
+    }
+    free(order);
+    dir_list_free(&list);
+    close(fd);
+
+    /* Reverse order: the owner pops the first child next, thieves take
+     * the last ones, which the writer needs latest. Without a pool (or
+     * when queueing fails) the child is handled right here. */
+    for (size_t i = n->nkids; i-- > 0;) {
+        SearchNode *kid = n->kids[i].node;
+        if (!pool || work_pool_push(pool, worker, kid) != 0) process_node(pool, worker, kid, job);
+    }
+}
+
+static void process_node(WorkPool *pool, int worker, void *task, void *ctx) {
+    SearchJob *job = ctx;
+    SearchNode *n = task;
+    if (n->type == DT_DIR) walk_directory(pool, worker, job, n);
+    else grep_file(job, n);
+    node_finish(job, n);
+}
+
+/* Write a finished subtree in order, waiting for nodes as they come due */
+static void emit_node(SearchJob *job, SearchNode *n) {
+    if (!atomic_load(&n->done)) {
+        out_flush(job);
+        pthread_mutex_lock(&job->lock);
+        atomic_store(&job->waiting, n);
+        while (!atomic_load(&n->done)) pthread_cond_wait(&job->cond, &job->lock);
+        atomic_store(&job->waiting, NULL);
+        pthread_mutex_unlock(&job->lock);
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < n->nkids; i++) {
+        out_write(job, n->text.data + pos, n->kids[i].at - pos);
+        pos = n->kids[i].at;
+        emit_node(job, n->kids[i].node);
+    }
+    out_write(job, n->text.data + pos, n->text.len - pos);
+    node_free(n);
+}
+
+/* Walk every root in parallel and write the results in order */
+static void run_search(SearchJob *job, SearchNode **roots, int nroots) {
+    WorkPool *pool = work_pool_new(work_pool_cpus(), process_node, job);
+    if (pool && work_pool_start(pool) != 0) {
+        work_pool_finish(pool);
+        pool = NULL;
+    }
+
+    for (int i = 0; i < nroots; i++) {
+        if (!pool || work_pool_push(pool, 0, roots[i]) != 0) {
+            process_node(NULL, 0, roots[i], job);
+        }
+    }
+    for (int i = 0; i < nroots; i++) {
+        emit_node(job, roots[i]);
+    }
+    out_flush(job);
+    if (pool) work_pool_finish(pool);
+}
+
+static SearchJob *job_new(int mode) {
+    SearchJob *job = calloc(1, sizeof(SearchJob));
+    if (!job) return NULL;
+    job->mode = mode;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->cond, NULL);
+    return job;
+}
+
+static void job_free(SearchJob *job) {
+    pthread_mutex_destroy(&job->lock);
+    pthread_cond_destroy(&job->cond);
+    free(job);
+}
+
+/* Run the system tool under its own name with the same arguments */
+static int run_system_tool(const char *tool, char **args) {
+    int argc = 0;
+    while (args[argc]) argc++;
+    char **argv = malloc((argc + 1) * sizeof(char *));
+    if (!argv) return 2;
+    argv[0] = (char *)tool;
+    for (int i = 1; i <= argc; i++) argv[i] = args[i];
+    /* The ffind/fgrep line is already in history */
+    history_mute(1);
+    int ret = exec_external(argv);
+    history_mute(0);
+    free(argv);
+    return ret;
+}
+
+/* Function to find files by name (ffind) */
+int exec_ffind(char **args) {
+    int i = 1;
+    while (args[i] && args[i][0] != '-') i++;
+    int first_expr = i;
+
+    SearchJob *job = job_new(MODE_FIND);
+    if (!job) return 1;
+    for (; args[i]; i += 2) {
+        if (strcmp(args[i], "-name") == 0 && args[i + 1]) {
+            job->name_pattern = args[i + 1];
+        } else if (strcmp(args[i], "-type") == 0 && args[i + 1] &&
+                   strchr("fdl", args[i + 1][0]) && args[i + 1][1] == '\0') {
+            job->type_filter = args[i + 1][0];
+        } else {
+            job_free(job);
+            return run_system_tool("find", args);
+        }
+    }
+
+    static char *dot[] = { ".", NULL };
+    char **paths = first_expr > 1 ? args + 1 : dot;
+    int npaths = first_expr > 1 ? first_expr - 1 : 1;
+
+    fflush(stdout);
+    for (int p = 0; p < npaths; p++) {
+        struct stat st;
+        if (lstat(paths[p], &st) != 0) {
+            fprintf(stderr, "ffind: '%s': %s\n", paths[p], strerror(errno));
+            atomic_store(&job->failed, 1);
+            continue;
+        }
+        unsigned char type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK
+                           : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        if (find_selects(job, base_name(paths[p]), type)) {
+            out_write(job, paths[p], strlen(paths[p]));
+            out_write(job, "\n", 1);
+        }
+        if (type != DT_DIR) continue;
+
+        /* Each root is walked after the previous one has been written */
+        SearchNode *root = node_new(NULL, paths[p], DT_DIR);
+        if (root) run_search(job, &root, 1);
+    }
+
+    out_flush(job);
+    int status = atomic_load(&job->failed) ? 1 : 0;
+    job_free(job);
+    return status;
+}
+
+/* Function to search files for a fixed string (fgrep) */
+int exec_fgrep(char **args) {
+    SearchJob *job = job_new(MODE_GREP);
+    if (!job) return 2;
+
+    int i = 1, recursive = 0, names = -1;
+    for (; args[i] && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        for (const char *f = args[i] + 1; *f; f++) {
+            switch (*f) {
+            case 'i': job->ignore_case = 1; break;
+            case 'n': job->line_numbers = 1; break;
+            case 'l': job->files_only = 1; break;
+            case 'c': job->count_only = 1; break;
+            case 'r':
+            case 'R': recursive = 1; break;
+            case 'H': names = 1; break;
+            case 'h': names = 0; break;
+            default:
+                job_free(job);
+                return run_system_tool("fgrep", args);
+            }
+        }
+    }
+    /* No pattern, empty pattern or stdin input: leave it to the real tool */
+    if (!args[i] || args[i][0] == '\0' || (!args[i + 1] && !recursive)) {
+        job_free(job);
+        return run_system_tool("fgrep", args);
+    }
+    job->pattern = args[i];
+    job->pattern_len = strlen(args[i]);
+    job->color = isatty(STDOUT_FILENO);
+
+    static char *dot[] = { ".", NULL };
+    char **paths = args[i + 1] ? args + i + 1 : dot;
+    int npaths = 0;
+    int any_dir = 0;
+    while (paths[npaths]) {
+        struct stat st;
+        if (stat(paths[npaths], &st) == 0 && S_ISDIR(st.st_mode)) any_dir = 1;
+        npaths++;
+    }
+    job->with_names = names >= 0 ? names : (npaths > 1 || any_dir);
+
+    fflush(stdout);
+    SearchNode **roots = calloc(npaths, sizeof(SearchNode *));
+    int nroots = 0;
+    for (int p = 0; roots && p < npaths; p++) {
+        struct stat st;
+        if (stat(paths[p], &st) != 0) {
+            fprintf(stderr, "fgrep: %s: %s\n", paths[p], strerror(errno));
+            atomic_store(&job->failed, 1);
+            continue;
+        }
+        if (S_ISDIR(st.st_mode) && !recursive) {
+            fprintf(stderr, "fgrep: %s: Is a directory\n", paths[p]);
+            atomic_store(&job->failed, 1);
+            continue;
+        }
+        SearchNode *root = node_new(NULL, paths[p], S_ISDIR(st.st_mode) ? DT_DIR : DT_REG);
+        if (root) roots[nroots++] = root;
+    }
+    run_search(job, roots, nroots);
+
+    int status = atomic_load(&job->failed) ? 2 : atomic_load(&job->matched) ? 0 : 1;
+    free(roots);
+    job_free(job);
+    return status;
+}
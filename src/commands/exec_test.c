@@ -0,0 +1,164 @@
+// exec_test.c
+// test EXPR and [ EXPR ]: file, string and integer checks for if/while
+// conditions, run in the shell process so a condition costs no fork.
+//
+//   ! EXPR, EXPR -a EXPR, EXPR -o EXPR, ( EXPR )
+//   -e -f -d -L -r -w -x -s FILE     -z -n STRING     STRING
+//   S1 = S2, S1 == S2, S1 != S2      N1 -eq -ne -lt -le -gt -ge N2
+//
+// Exit status: 0 true, 1 false, 2 usage error.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "executor.h"
+
+typedef struct {
+    char **args;
+    int pos;
+    int count;
+    int error;
+} TestParser;
+
+static const char *test_peek(TestParser *t, int ahead) {
+    return t->pos + ahead < t->count ? t->args[t->pos + ahead] : NULL;
+}
+
+static int is_unary(const char *op) {
+    return op != NULL && op[0] == '-' && op[1] != '\0' && op[2] == '\0' && strchr("efdLrwxszn", op[1]) != NULL;
+}
+
+static int is_binary(const char *op) {
+    static const char *const ops[] = { "=", "==", "!=", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", NULL };
+    for (int i = 0; op != NULL && ops[i] != NULL; i++) {
+        if (strcmp(op, ops[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+static long long test_number(TestParser *t, const char *s) {
+    char *end;
+    errno = 0;
+    long long v = strtoll(s, &end, 10);
+    if (end == s || *end != '\0' || errno != 0) {
+        fprintf(stderr, "test: %s: integer expression expected\n", s);
+        t->error = 1;
+    }
+    return v;
+}
+
+static int test_unary(char op, const char *arg) {
+    struct stat st;
+    switch (op) {
+    case 'z': return arg[0] == '\0';
+    case 'n': return arg[0] != '\0';
+    case 'L': return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+    case 'r': return access(arg, R_OK) == 0;
+    case 'w': return access(arg, W_OK) == 0;
+    case 'x': return access(arg, X_OK) == 0;
+    }
+    if (stat(arg, &st) != 0) return 0;
+    switch (op) {
+    case 'f': return S_ISREG(st.st_mode);
+    case 'd': return S_ISDIR(st.st_mode);
+    case 's': return st.st_size > 0;
+    default:  return 1;          /* -e */
+    }
+}
+
+static int test_binary(TestParser *t, const char *a, const char *op, const char *b) {
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(a, b) == 0;
+    if (strcmp(op, "!=") == 0) return strcmp(a, b) != 0;
+    long long x = test_number(t, a), y = test_number(t, b);
+    if (strcmp(op, "-eq") == 0) return x == y;
+    if (strcmp(op, "-ne") == 0) return x != y;
+    if (strcmp(op, "-lt") == 0) return x < y;
+    if (strcmp(op, "-le") == 0) return x <= y;
+    if (strcmp(op, "-gt") == 0) return x > y;
+    return x >= y;
+}
+
+static int test_or(TestParser *t);
+
+static int test_primary(TestParser *t) {
+    const char *a = test_peek(t, 0);
+    if (a == NULL) {
+        fprintf(stderr, "test: argument expected\n");
+        t->error = 1;
+        return 0;
+    }
+    if (strcmp(a, "!") == 0 && test_peek(t, 1) != NULL) {
+        t->pos++;
+        return !test_primary(t);
+    }
+    if (is_binary(test_peek(t, 1)) && test_peek(t, 2) != NULL) {
+        t->pos += 3;
+        return test_binary(t, a, t->args[t->pos - 2], t->args[t->pos - 1]);
+    }
+    if (is_unary(a) && test_peek(t, 1) != NULL) {
+        t->pos += 2;
+        return test_unary(a[1], t->args[t->pos - 1]);
+    }
+    if (strcmp(a, "(") == 0 && test_peek(t, 1) != NULL) {
+        t->pos++;
+        int v = test_or(t);
+        const char *close = test_peek(t, 0);
+        if (close == NULL || strcmp(close, ")") != 0) {
+            fprintf(stderr, "test: ')' expected\n");
+            t->error = 1;
+            return 0;
+        }
+        t->pos++;
+        return v;
+    }
+    /* A lone string is true when it is not empty */
+    t->pos++;
+    return a[0] != '\0';
+}
+
+static int test_and(TestParser *t) {
+    int v = test_primary(t);
+    while (!t->error && test_peek(t, 0) != NULL && strcmp(test_peek(t, 0), "-a") == 0) {
+        t->pos++;
+        int rhs = test_primary(t);
+        v = v && rhs;
+    }
+    return v;
+}
+
+static int test_or(TestParser *t) {
+    int v = test_and(t);
+    while (!t->error && test_peek(t, 0) != NULL && strcmp(test_peek(t, 0), "-o") == 0) {
+        t->pos++;
+        int rhs = test_and(t);
+        v = v || rhs;
+    }
+    return v;
+}
+
+/* Function to evaluate a test expression (test ... or [ ... ]) */
+int exec_test(char **args) {
+    int count = 0;
+    while (args[count + 1] != NULL) count++;
+    if (strcmp(args[0], "[") == 0) {
+        if (count == 0 || strcmp(args[count], "]") != 0) {
+            fprintf(stderr, "[: missing ']'\n");
+            return 2;
+        }
+        count--;
+    }
+    /* No expression is false */
+    if (count == 0) return 1;
+
+    TestParser t = { &args[1], 0, count, 0 };
+    int v = test_or(&t);
+    if (!t.error && t.pos < t.count) {
+        fprintf(stderr, "%s: unexpected argument '%s'\n", args[0], t.args[t.pos]);
+        t.error = 1;
+    }
+    if (t.error) return 2;
+    return v ? 0 : 1;
+}
@@ -0,0 +1,304 @@
+// exec_watch.c
+// watch [-n SECONDS] [-f PATH]... [-p PID] [-c COUNT] command [args...]:
+// re-run a command and keep its latest output on screen.
+//
+//   -n 2      run every 2 seconds (timerfd); the default without -f
+//   -f PATH   run when PATH (a file, or the entries of a directory) changes
+//             (inotify); may be repeated, and combined with -n
+//   -p PID    stop when process PID exits (pidfd)
+//   -c COUNT  stop after COUNT runs
+//
+// The loop sleeps in poll() on those descriptors and the keyboard, so a
+// watcher on files costs nothing until one changes. The command's argv runs
+// as given (a builtin in the shell, anything else forked), not parsed or
+// expanded again, with its stdout captured; the new output is compared
+// with the previous one line by line and only the lines that
+// changed are repainted. When stdout is not a terminal the whole output is
+// printed, and only when it differs from the last run. q or Ctrl-C stops.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include "executor.h"
+#include "../utils/capture.h"
+
+#define WATCH_MAX_PATHS 64
+/* Changes closer together than this (an editor saving) cause one run */
+#define WATCH_SETTLE_MS 50
+
+typedef struct {
+    double interval;     /* seconds, 0 = none */
+    const char *paths[WATCH_MAX_PATHS];
+    int npaths;
+    int pid;             /* 0 = none */
+    long count;          /* runs, 0 = unlimited */
+    int cmd;             /* index of the command in args */
+} WatchOptions;
+
+/* Screen state: the lines currently shown below the header */
+typedef struct {
+    OutputBuffer shown;
+    int tty;
+    int rows, cols;
+} Screen;
+
+static int parse_options(char **args, WatchOptions *opt) {
+    memset(opt, 0, sizeof(*opt));
+    int i = 1;
+    for (; args[i] != NULL && args[i][0] == '-'; i += 2) {
+        if (strcmp(args[i], "--") == 0) {
+            i++;
+            break;
+        }
+        const char *value = args[i + 1];
+        char *end = NULL;
+        if (value == NULL || args[i][1] == '\0' || args[i][2] != '\0') return -1;
+        switch (args[i][1]) {
+        case 'n':
+            opt->interval = strtod(value, &end);
+            if (end == value || *end != '\0' || opt->interval < 0.1) return -1;
+            break;
+        case 'f':
+            if (opt->npaths == WATCH_MAX_PATHS) return -1;
+            opt->paths[opt->npaths++] = value;
+            break;
+        case 'p':
+            opt->pid = (int)strtol(value, &end, 10);
+            if (end == value || *end != '\0' || opt->pid <= 0) return -1;
+            break;
+        case 'c':
+            opt->count = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || opt->count <= 0) return -1;
+            break;
+        default:
+            return -1;
+        }
+    }
+    if (args[i] == NULL) return -1;
+    if (opt->interval == 0 && opt->npaths == 0) opt->interval = 2;
+    opt->cmd = i;
+    return 0;
+}
+
+/* "cmd arg..." for the header; NULL if out of memory */
+static char *join_args(char **args) {
+    size_t len = 1;
+    for (int i = 0; args[i] != NULL; i++) len += strlen(args[i]) + 1;
+    char *line = malloc(len);
+    if (line == NULL) return NULL;
+    line[0] = '\0';
+    for (int i = 0; args[i] != NULL; i++) {
+        if (i) strcat(line, " ");
+        strcat(line, args[i]);
+    }
+    return line;
+}
+
+static int run_argv(void *arg) {
+    char **argv = arg;
+    return is_builtin(argv[0]) ? exec_builtin(argv) : exec_external(argv);
+}
+
+/* ---- rendering ---- */
+
+/* Start of line n of buf (or NULL past the end); *len excludes the '\n' */
+static const char *nth_line(const OutputBuffer *buf, int n, size_t *len) {
+    const char *p = buf->data, *end = buf->data + buf->len;
+    if (p == NULL) return NULL;
+    for (; n > 0; n--) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        if (nl == NULL) return NULL;
+        p = nl + 1;
+    }
+    if (p >= end) return NULL;
+    const char *nl = memchr(p, '\n', (size_t)(end - p));
+    *len = (size_t)((nl != NULL ? nl : end) - p);
+    return p;
+}
+
+static void header(const Screen *scr, const WatchOptions *opt, const char *line, int status) {
+    char when[32], what[64];
+    time_t t = time(NULL);
+    strftime(when, sizeof(when), "%H:%M:%S", localtime(&t));
+    if (opt->interval > 0) snprintf(what, sizeof(what), "Every %.1fs", opt->interval);
+    else snprintf(what, sizeof(what), "On change");
+    /* Row 1, the rest of it cleared */
+    printf("\033[H\033[7m%s: %.*s  [%s, status %d]\033[0m\033[K", what, scr->cols > 40 ? scr->cols - 40 : 20,
+           line, when, status);
+}
+
+/* Show out: on a terminal rewrite the changed rows only */
+static void render(Screen *scr, const WatchOptions *opt, const char *line, OutputBuffer *out, int status) {
+    if (!scr->tty) {
+        if (scr->shown.data == NULL || out->len != scr->shown.len || memcmp(out->data, scr->shown.data, out->len) != 0) {
+            fwrite(out->data != NULL ? out->data : "", 1, out->len, stdout);
+            fflush(stdout);
+        }
+    } else {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 2) {
+            scr->rows = ws.ws_row;
+            scr->cols = ws.ws_col;
+        }
+        header(scr, opt, line, status);
+        int row = 0;
+        for (; row < scr->rows - 2; row++) {
+            size_t new_len = 0, old_len = 0;
+            const char *new_line = nth_line(out, row, &new_len);
+            const char *old_line = nth_line(&scr->shown, row, &old_len);
+            if (new_line == NULL && old_line == NULL) break;
+            if (new_line != NULL && old_line != NULL && new_len == old_len && memcmp(new_line, old_line, new_len) == 0) {
+                continue;
+            }
+            if (new_len > (size_t)scr->cols) new_len = (size_t)scr->cols;
+            /* Output starts on row 3, below the header and a blank row */
+            printf("\033[%d;1H%.*s\033[K", row + 3, (int)new_len, new_line != NULL ? new_line : "");
+        }
+        fflush(stdout);
+    }
+    output_buffer_free(&scr->shown);
+    scr->shown = *out;
+    out->data = NULL;
+    out->len = out->cap = 0;
+}
+
+/* ---- event sources ---- */
+
+static int open_timer(double interval) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (fd < 0) return -1;
+    struct itimerspec its;
+    its.it_interval.tv_sec = (time_t)interval;
+    its.it_interval.tv_nsec = (long)((interval - (double)(time_t)interval) * 1e9);
+    its.it_value = its.it_interval;
+    if (timerfd_settime(fd, 0, &its, NULL) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int open_inotify(const WatchOptions *opt) {
+    int fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if (fd < 0) return -1;
+    const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                          IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF;
+    for (int i = 0; i < opt->npaths; i++) {
+        if (inotify_add_watch(fd, opt->paths[i], mask) < 0) {
+            perror(opt->paths[i]);
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+static void drain(int fd) {
+    char buf[4096];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+}
+
+/* Function to re-run a command on a timer or on file changes */
+int exec_watch(char **args) {
+    WatchOptions opt;
+    if (parse_options(args, &opt) != 0) {
+        fprintf(stderr, "Usage: watch [-n SECONDS] [-f PATH]... [-p PID] [-c COUNT] command [args...]\n");
+        return 2;
+    }
+    char *line = join_args(&args[opt.cmd]);
+    if (line == NULL) {
+        perror("watch");
+        return 1;
+    }
+
+    /* poll set: keyboard, timer, inotify, pidfd */
+    struct pollfd fds[4];
+    int nfds = 0, timer_fd = -1, notify_fd = -1, pid_fd = -1, ret = 0;
+    if (opt.interval > 0 && (timer_fd = open_timer(opt.interval)) < 0) {
+        perror("watch: timerfd");
+        ret = 1;
+    }
+    if (ret == 0 && opt.npaths > 0 && (notify_fd = open_inotify(&opt)) < 0) ret = 1;
+    if (ret == 0 && opt.pid > 0 && (pid_fd = (int)syscall(SYS_pidfd_open, opt.pid, 0)) < 0) {
+        perror("watch: pidfd_open");
+        ret = 1;
+    }
+
+    Screen scr = { { NULL, 0, 0 }, isatty(STDOUT_FILENO), 24, 80 };
+    struct termios saved;
+    int raw = ret == 0 && scr.tty && isatty(STDIN_FILENO) && tcgetattr(STDIN_FILENO, &saved) == 0;
+    if (raw) {
+        /* Keys arrive one at a time; Ctrl-C is a key, not a signal */
+        struct termios t = saved;
+        t.c_lflag &= ~(tcflag_t)(ICANON | ECHO | ISIG);
+        t.c_cc[VMIN] = 0;
+        t.c_cc[VTIME] = 0;
+        tcsetattr(STDIN_FILENO, TCSANOW, &t);
+        fds[nfds++] = (struct pollfd){ STDIN_FILENO, POLLIN, 0 };
+    }
+    if (timer_fd >= 0) fds[nfds++] = (struct pollfd){ timer_fd, POLLIN, 0 };
+    if (notify_fd >= 0) fds[nfds++] = (struct pollfd){ notify_fd, POLLIN, 0 };
+    if (pid_fd >= 0) fds[nfds++] = (struct pollfd){ pid_fd, POLLIN, 0 };
+    if (scr.tty && ret == 0) printf("\033[?25l\033[H\033[2J");
+
+    history_mute(1);
+    for (long runs = 0; ret == 0;) {
+        OutputBuffer out = { NULL, 0, 0 };
+        int status = capture_stdout(run_argv, &args[opt.cmd], &out);
+        render(&scr, &opt, line, &out, status);
+        if (opt.count > 0 && ++runs >= opt.count) break;
+
+        /* Sleep until something asks for the next run */
+        int again = 0, stop = 0;
+        while (!again && !stop) {
+            if (poll(fds, (nfds_t)nfds, -1) < 0) {
+                if (errno == EINTR) continue;
+                perror("watch: poll");
+                stop = 1;
+                break;
+            }
+            for (int i = 0; i < nfds; i++) {
+                if (fds[i].revents == 0) continue;
+                if (fds[i].fd == STDIN_FILENO) {
+                    char key;
+                    if (read(STDIN_FILENO, &key, 1) == 1 && (key == 'q' || key == 'Q' || key == 3)) stop = 1;
+                } else if (fds[i].fd == timer_fd) {
+                    drain(timer_fd);
+                    again = 1;
+                } else if (fds[i].fd == notify_fd) {
+                    /* Let a burst of changes settle into one run */
+                    struct pollfd settle = { notify_fd, POLLIN, 0 };
+                    do {
+                        drain(notify_fd);
+                    } while (poll(&settle, 1, WATCH_SETTLE_MS) > 0);
+                    again = 1;
+                } else if (fds[i].fd == pid_fd) {
+                    stop = 1;
+                }
+            }
+        }
+        if (stop) break;
+    }
+    history_mute(0);
+
+    if (scr.tty && ret == 0) printf("\033[%d;1H\033[?25h\n", scr.rows);
+    fflush(stdout);
+    if (raw) tcsetattr(STDIN_FILENO, TCSANOW, &saved);
+    if (timer_fd >= 0) close(timer_fd);
+    if (notify_fd >= 0) close(notify_fd);
+    if (pid_fd >= 0) close(pid_fd);
+    output_buffer_free(&scr.shown);
+    free(line);
+    return ret;
+}
@@ -7,251 +7,209 @@
 #include <fcntl.h>
 #include <errno.h>
 #include "executor.h"
-
-// Function to execute a command string: parse into argv, dispatch to builtin or external.
-int execute_command(const char *command) {
-    if (command == NULL) return -1;
-
-    // Duplicate since strtok will modify
-    char *cmd_copy = strdup(command);
-    if (cmd_copy == NULL) {
-        perror("strdup");
-        return -1;
+#include "interp.h"
+#include "parser.h"
+#include "utils/heredoc.h"
+
+/* Built-in commands run in the shell process without fork/exec */
+const char *const builtin_commands[] = {
+    "cd", "exit", "about", "help", "clear", "count", "history", "ls",
+    "ffind", "fgrep", "memo", "limit", "watch", "echo", "true", "false", ":", "test", "[",
+    "export", "unset", NULL
+};
+
+static int run_command(const char *command, char **args, int infd, int outfd);
+
+int is_builtin(const char *name) {
+    for (int i = 0; builtin_commands[i] != NULL; i++) {
+        if (strcmp(name, builtin_commands[i]) == 0) return 1;
     }
-
-    // Detect logical AND operator (&&)
-    const char *and_ptr = strstr(cmd_copy, "&&");
-    if (and_ptr != NULL) {
-        /* Split by '&&' and execute sequentially */
-        char *parts[32];
-        int pcount = 0;
-        char *saveptr = NULL;
-        char *tok = strtok_r(cmd_copy, "&", &saveptr);
-        while (tok != NULL && pcount < 32) {
-            /* Skip empty tokens from && */
-            if (tok[0] == '&') tok++;
-            
-            /* Trim leading/trailing whitespace */
-            while (*tok == ' ' || *tok == '\t') tok++;
-            char *end = tok + strlen(tok) - 1;
-            while (end > tok && (*end == ' ' || *end == '\n' || *end == '\r' || *end == '\t')) {
-                *end = '\0';
-                end--;
-            }
-            
-            if (strlen(tok) > 0) {
-                parts[pcount++] = strdup(tok);
-            }
-            tok = strtok_r(NULL, "&", &saveptr);
-        }
-
-        /* Execute commands sequentially, stopping on failure */
-        int last_status = 0;
-        for (int i = 0; i < pcount; i++) {
-            last_status = execute_command(parts[i]);
-            if (last_status != 0) {
-                /* Command failed, stop executing remaining commands */
-                break;
-            }
-        }
-
-        /* Free duplicated strings */
-        for (int i = 0; i < pcount; i++) {
-            free(parts[i]);
-        }
-        free(cmd_copy);
-        return last_status;
+    return 0;
+}
+
+/* Run a builtin in the shell process with stdin/stdout temporarily
+ * pointed at the redirection targets */
+static int run_builtin_redirected(char **args, int infd, int outfd) {
+    int saved_in = -1, saved_out = -1;
+    if (infd != -1) {
+        saved_in = dup(STDIN_FILENO);
+        dup2(infd, STDIN_FILENO);
+        close(infd);
+    }
+    if (outfd != -1) {
+        fflush(stdout);
+        saved_out = dup(STDOUT_FILENO);
+        dup2(outfd, STDOUT_FILENO);
+        close(outfd);
     }
 
-    // Detect pipelines
-    if (strchr(cmd_copy, '|') != NULL) {
-        /* Split by '|' and build array of command strings */
-        char *parts[32];
-        int pcount = 0;
-        char *saveptr = NULL;
-        char *tok = strtok_r(cmd_copy, "|", &saveptr);
-        while (tok != NULL && pcount < 32) {
-            /* trim leading/trailing whitespace */
-            while (*tok == ' ') tok++;
-            char *end = tok + strlen(tok) - 1;
-            while (end > tok && (*end == ' ' || *end == '\n' || *end == '\r' || *end == '\t')) { *end = '\0'; end--; }
-            parts[pcount++] = tok;
-            tok = strtok_r(NULL, "|", &saveptr);
-        }
-
-        /* Create pipes between commands */
-        int prev_fd = -1;
-        pid_t children[32];
-        int child_count = 0;
-
-        for (int pi = 0; pi < pcount; pi++) {
-            int pipefd[2];
-            if (pi < pcount - 1) {
-                if (pipe(pipefd) == -1) {
-                    perror("pipe");
-                    free(cmd_copy);
-                    return -1;
-                }
-            }
-
-            pid_t cpid = fork();
-            if (cpid < 0) {
-                perror("fork");
-                free(cmd_copy);
-                return -1;
-            }
-
-            if (cpid == 0) {
-                /* Child */
-                if (prev_fd != -1) {
-                    dup2(prev_fd, STDIN_FILENO);
-                    close(prev_fd);
-                }
-                if (pi < pcount - 1) {
-                    close(pipefd[0]);
-                    dup2(pipefd[1], STDOUT_FILENO);
-                    close(pipefd[1]);
-                }
-
-                /* Handle simple redirection in this single command (>, <) */
-                char *cmdcopy2 = strdup(parts[pi]);
-                char *argv[256];
-                int ai = 0;
-                char *sp = NULL;
-                char *tk = strtok_r(cmdcopy2, " ", &sp);
-                int infd = -1, outfd = -1;
-                while (tk != NULL && ai < 255) {
-                    if (strcmp(tk, ">") == 0) {
-                        tk = strtok_r(NULL, " ", &sp);
-                        if (tk) {
-                            outfd = open(tok, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-                        }
-                    } else if (strcmp(tk, "<") == 0) {
-                        tk = strtok_r(NULL, " ", &sp);
-                        if (tk) {
-                            infd = open(tok, O_RDONLY);
-                        }
-                    } else {
-                        argv[ai++] = tk;
-                    }
-                    tk = strtok_r(NULL, " ", &sp);
-                }
-                argv[ai] = NULL;
-
-                if (infd != -1) {
-                    dup2(infd, STDIN_FILENO);
-                    close(infd);
-                }
-                if (outfd != -1) {
-                    dup2(outfd, STDOUT_FILENO);
-                    close(outfd);
-                }
-
-                if (ai == 0) {
-                    _exit(0);
-                }
-                execvp(argv[0], argv);
-                if (errno == ENOENT) {
-                    fprintf(stderr, "Command not found: %s\n", argv[0]);
-                    _exit(127);
-                } else {
-                    perror("execvp");
-                    _exit(EXIT_FAILURE);
-                }
-            }
+    int ret = exec_builtin(args);
 
-            /* Parent */
-            children[child_count++] = cpid;
-            if (prev_fd != -1) close(prev_fd);
-            if (pi < pcount - 1) {
-                close(pipefd[1]);
-                prev_fd = pipefd[0];
+    if (saved_out != -1) {
+        fflush(stdout);
+        dup2(saved_out, STDOUT_FILENO);
+        close(saved_out);
+    }
+    if (saved_in != -1) {
+        dup2(saved_in, STDIN_FILENO);
+        close(saved_in);
+    }
+    return ret;
+}
+
+/* The memfd for the last here-document (<<WORD) or here-string (<<<word)
+ * of a command: -1 when there are none, -2 on failure. Every << takes the
+ * next document from docs, in order. */
+int take_heredocs(const Redirect *redirs, int nredirs, HereDocs *docs) {
+    int fd = -1;
+    for (int k = 0; k < nredirs; k++) {
+        if (redirs[k].kind != REDIR_HEREDOC && redirs[k].kind != REDIR_HERESTRING) continue;
+
+        int next;
+        if (redirs[k].kind == REDIR_HERESTRING) {
+            /* The word plus a newline, like a one-line document */
+            const char *word = redirs[k].target;
+            size_t len = strlen(word);
+            char *text = malloc(len + 1);
+            if (text == NULL) {
+                next = -1;
+            } else {
+                memcpy(text, word, len);
+                text[len] = '\n';
+                next = heredoc_memfd(text, len + 1);
+                free(text);
             }
+        } else if (docs != NULL && docs->next < docs->count) {
+            next = heredoc_memfd(docs->data[docs->next], docs->len[docs->next]);
+            docs->next++;
+        } else {
+            /* Operator with no document lines: empty input */
+            next = heredoc_memfd("", 0);
         }
-
-        /* Wait for all children */
-        int last_status = 0;
-        for (int i = 0; i < child_count; i++) {
-            int st = 0;
-            waitpid(children[i], &st, 0);
-            if (WIFEXITED(st)) last_status = WEXITSTATUS(st);
+        if (fd >= 0) close(fd);
+        if (next < 0) return -2;
+        fd = next;
+    }
+    return fd;
+}
+
+/* Open the redirections of a command in order into *infd and *outfd (-1
+ * for none); the last one for each stream wins, and docfd from
+ * take_heredocs stands in for << and <<<. Returns -1 with a message if a
+ * file cannot be opened. */
+static int open_redirections(const Redirect *redirs, int nredirs, int docfd, int *infd, int *outfd) {
+    *infd = *outfd = -1;
+    for (int k = 0; k < nredirs; k++) {
+        const Redirect *r = &redirs[k];
+        int fd;
+        if (r->kind == REDIR_OUT) fd = open(r->target, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        else if (r->kind == REDIR_IN) fd = open(r->target, O_RDONLY);
+        else fd = dup(docfd);
+        if (fd < 0) {
+            perror(r->kind == REDIR_OUT || r->kind == REDIR_IN ? r->target : "dup");
+            if (*infd != -1) close(*infd);
+            if (*outfd != -1) close(*outfd);
+            return -1;
         }
-
-        free(cmd_copy);
-        return last_status;
+        int *slot = r->kind == REDIR_OUT ? outfd : infd;
+        if (*slot != -1) close(*slot);
+        *slot = fd;
     }
-
-    /* No pipeline: parse into argv-style array */
-    const int MAX_ARGS = 256;
-    char *args[MAX_ARGS];
-    char *token = strtok(cmd_copy, " ");
-    int i = 0;
-    while (token != NULL && i < MAX_ARGS - 1) {
-        args[i++] = token;
-        token = strtok(NULL, " ");
+    return 0;
+}
+
+/* Apply the redirections of a pipeline stage (in the child) */
+void apply_redirections(const Redirect *redirs, int nredirs, int docfd) {
+    int infd, outfd;
+    if (open_redirections(redirs, nredirs, docfd, &infd, &outfd) != 0) _exit(EXIT_FAILURE);
+    if (infd != -1) {
+        dup2(infd, STDIN_FILENO);
+        close(infd);
     }
-    args[i] = NULL;
-
-    if (i == 0) {
-        free(cmd_copy);
-        return -1;
+    if (outfd != -1) {
+        dup2(outfd, STDOUT_FILENO);
+        close(outfd);
     }
+}
 
-    /* Special handling for 'ls' command: inject --color=auto */
-    if (strcmp(args[0], "ls") == 0) {
-        /* Create new argv with --color=auto injected */
-        char *colored_args[MAX_ARGS];
-        colored_args[0] = args[0];  /* "ls" */
-        colored_args[1] = "--color=auto";
-        int j = 1;
-        for (int k = 1; args[k] != NULL && j < MAX_ARGS - 1; k++, j++) {
-            colored_args[j] = args[k];
-        }
-        colored_args[j] = NULL;
-        int ret = exec_external(colored_args);
-        free(cmd_copy);
-        return ret;
+/* Run argv in a forked child (pipeline stage): builtins run in the child,
+ * anything else is exec'd. Never returns. */
+void exec_in_child(char **argv) {
+    if (argv[0] == NULL) {
+        _exit(0);
     }
-
-    /* Check for built-in commands (exec_builtin runs in the parent when needed)
-       List of built-in commands that don't need fork/exec */
-    const char *builtins[] = {
-        "cd", "exit", "about", "help", "clear", "count", "history", NULL
-    };
-    
-    int is_builtin = 0;
-    for (int j = 0; builtins[j] != NULL; j++) {
-        if (strcmp(args[0], builtins[j]) == 0) {
-            is_builtin = 1;
-            break;
-        }
+    if (is_builtin(argv[0])) {
+        /* The shell records the pipeline, not each stage */
+        history_mute(1);
+        fflush(stdout);
+        int st = exec_builtin(argv);
+        fflush(stdout);
+        _exit(st < 0 ? EXIT_FAILURE : st & 0xff);
     }
-    
-    if (is_builtin) {
-        int ret = exec_builtin(args);
-        free(cmd_copy);
-        return ret;
+    execvp(argv[0], argv);
+    if (errno == ENOENT) {
+        fprintf(stderr, "Command not found: %s\n", argv[0]);
+        _exit(127);
+    } else {
+        perror("execvp");
+        _exit(EXIT_FAILURE);
     }
+}
 
-    /* Handle simple redirection for single external commands (>, <) */
-    int infd = -1, outfd = -1;
-    for (int k = 0; k < i; k++) {
-        if (strcmp(args[k], ">") == 0) {
-            if (k + 1 < i) {
-                outfd = open(args[k+1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
-                /* remove the redirection tokens from argv */
-                for (int s = k; s + 2 <= i; s++) args[s] = args[s+2];
-                i -= 2;
-                args[i] = NULL;
-            }
-        } else if (strcmp(args[k], "<") == 0) {
-            if (k + 1 < i) {
-                infd = open(args[k+1], O_RDONLY);
-                for (int s = k; s + 2 <= i; s++) args[s] = args[s+2];
-                i -= 2;
-                args[i] = NULL;
-            }
-        }
+// Function to execute a command string: the interpreter parses and runs it.
+// Lines after the first hold the bodies of the line's here-documents.
+int execute_command(const char *command) {
+    if (command == NULL) return -1;
+
+    const char *nl = strchr(command, '\n');
+    HereDocSpec specs[HEREDOC_MAX];
+    if (nl == NULL) return interp_run(command, NULL);
+
+    char *copy = strdup(command);
+    if (copy == NULL) {
+        perror("strdup");
+        return -1;
+    }
+    char *body = copy + (nl - command);
+    *body++ = '\0';
+    if (heredoc_scan(copy, specs, HEREDOC_MAX) == 0) {
+        /* No here-documents: the lines are a script */
+        free(copy);
+        return interp_run(command, NULL);
+    }
+    HereDocs docs;
+    heredoc_split(copy, body, &docs);
+    int ret = interp_run(copy, &docs);
+    free(copy);
+    return ret;
+}
+
+/* Run one expanded simple command; docs supplies the bodies for its <<
+ * operators and source is its text, for history */
+int execute_argv(const char *source, char **argv, const Redirect *redirs, int nredirs, HereDocs *docs) {
+    int docfd = take_heredocs(redirs, nredirs, docs);
+    if (docfd == -2) return -1;
+    int infd, outfd, status = 0;
+    if (open_redirections(redirs, nredirs, docfd, &infd, &outfd) != 0) {
+        /* Nothing runs rather than reading or writing the terminal */
+        status = 1;
+    } else if (argv[0] == NULL) {
+        /* Redirections alone: > file still creates the file */
+        if (infd != -1) close(infd);
+        if (outfd != -1) close(outfd);
+    } else {
+        status = run_command(source, argv, infd, outfd);
+    }
+    if (docfd >= 0) close(docfd);
+    return status;
+}
+
+/* Run one expanded command: builtin in the shell, external by fork/exec.
+ * infd and outfd are its open redirections (-1 for none), closed here. */
+static int run_command(const char *command, char **args, int infd, int outfd) {
+    /* Built-in commands run in the shell process */
+    if (is_builtin(args[0])) {
+        return run_builtin_redirected(args, infd, outfd);
     }
 
     if (infd != -1 || outfd != -1) {
@@ -263,7 +221,6 @@ int execute_command(const char *command) {
             perror("fork");
             if (infd != -1) close(infd);
             if (outfd != -1) close(outfd);
-            free(cmd_copy);
             return -1;
         } else if (pid == 0) {
             if (infd != -1) {
@@ -287,14 +244,11 @@ int execute_command(const char *command) {
             waitpid(pid, &status, 0);
             if (infd != -1) close(infd);
             if (outfd != -1) close(outfd);
-            free(cmd_copy);
             if (WIFEXITED(status)) return WEXITSTATUS(status);
             return -1;
         }
     }
 
     /* For external commands without redirection, call exec_external which handles history tracking */
-    int ret = exec_external(args);
-    free(cmd_copy);
-    return ret;
+    return exec_external(args);
 }
\ No newline at end of file
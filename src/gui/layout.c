@@ -0,0 +1,119 @@
+// layout.c
+// Cell-to-run layout shared by the X11 renderer and the headless benchmark.
+
+#include "layout.h"
+
+/* Decode one UTF-8 sequence; invalid bytes are passed through as Latin-1 */
+static int utf8_decode(const char *s, int len, unsigned int *cp) {
+    const unsigned char *u = (const unsigned char *)s;
+    int need = 0;
+    unsigned int c = u[0];
+
+    if (c < 0x80) { *cp = c; return 1; }
+    if ((c & 0xe0) == 0xc0) { need = 1; c &= 0x1f; }
+    else if ((c & 0xf0) == 0xe0) { need = 2; c &= 0x0f; }
+    else if ((c & 0xf8) == 0xf0) { need = 3; c &= 0x07; }
+    else { *cp = u[0]; return 1; }
+
+    if (need >= len) { *cp = u[0]; return 1; }
+    for (int k = 1; k <= need; k++) {
+        if ((u[k] & 0xc0) != 0x80) { *cp = u[0]; return 1; }
+        c = (c << 6) | (u[k] & 0x3f);
+    }
+    *cp = c;
+    return need + 1;
+}
+
+/* Palette slot for a cell color index (bright colors share the base slot) */
+static int cell_color(uint8_t color, int fallback) {
+    return color < 16 ? COL_BLACK + (color & 7) : fallback;
+}
+
+/* Build the color-grouped text runs from out->cells (counting sort) */
+static void layout_text(RowLayout *out) {
+    LayoutRun runs[MAX_LINE_CELLS];
+    int nruns = 0;
+    int i = 0;
+
+    for (int c = 0; c < COL_COUNT; c++) out->color_count[c] = 0;
+
+    while (i < out->ncells) {
+        if (out->cells[i].cp == ' ') { i++; continue; }
+        int start = i;
+        unsigned char color = out->cells[i].color;
+        while (i < out->ncells && out->cells[i].color == color && out->cells[i].cp != ' ') i++;
+        runs[nruns].col = (short)start;
+        runs[nruns].len = (short)(i - start);
+        runs[nruns].color = color;
+        out->color_count[color]++;
+        nruns++;
+    }
+
+    int pos = 0;
+    int next[COL_COUNT];
+    for (int c = 0; c < COL_COUNT; c++) {
+        out->color_first[c] = pos;
+        next[c] = pos;
+        pos += out->color_count[c];
+    }
+    for (int k = 0; k < nruns; k++) out->text[next[runs[k].color]++] = runs[k];
+    out->ntext = nruns;
+}
+
+void layout_row(RowLayout *out, const VtCell *line, int cols) {
+    unsigned char bgs[MAX_LINE_CELLS];
+    if (cols > MAX_LINE_CELLS) cols = MAX_LINE_CELLS;
+
+    for (int c = 0; c < cols; c++) {
+        int fg = cell_color(line[c].fg, COL_TEXT);
+        int bg = cell_color(line[c].bg, COL_PANEL);
+        if (line[c].attr & VT_ATTR_REVERSE) {
+            int tmp = fg;
+            fg = bg;
+            bg = tmp;
+        }
+        out->cells[c].cp = line[c].cp;
+        out->cells[c].color = (unsigned char)fg;
+        bgs[c] = (unsigned char)bg;
+    }
+    out->ncells = cols;
+
+    out->nbg = 0;
+    for (int c = 0; c < cols; c++) {
+        if (bgs[c] == COL_PANEL) continue;
+        int start = c;
+        while (c + 1 < cols && bgs[c + 1] == bgs[start]) c++;
+        out->bg[out->nbg].col = (short)start;
+        out->bg[out->nbg].len = (short)(c - start + 1);
+        out->bg[out->nbg].color = bgs[start];
+        out->nbg++;
+    }
+
+    out->nunderline = 0;
+    for (int c = 0; c < cols; c++) {
+        if (!(line[c].attr & VT_ATTR_UNDERLINE)) continue;
+        int start = c;
+        while (c + 1 < cols && (line[c + 1].attr & VT_ATTR_UNDERLINE) &&
+               out->cells[c + 1].color == out->cells[start].color) c++;
+        out->underline[out->nunderline].col = (short)start;
+        out->underline[out->nunderline].len = (short)(c - start + 1);
+        out->underline[out->nunderline].color = out->cells[start].color;
+        out->nunderline++;
+    }
+
+    layout_text(out);
+}
+
+void layout_string(RowLayout *out, const char *s, int len, int color) {
+    int n = 0;
+    int i = 0;
+    while (i < len && n < MAX_LINE_CELLS) {
+        i += utf8_decode(&s[i], len - i, &out->cells[n].cp);
+        out->cells[n].color = (unsigned char)color;
+        n++;
+    }
+    out->ncells = n;
+    out->nbg = 0;
+    out->nunderline = 0;
+    layout_text(out);
+}
@@ -0,0 +1,62 @@
+// layout.h
+// Row layout for the X11 GUI: turns terminal cells into the background
+// fills, color-grouped text runs and underlines the renderer draws. Like
+// vt.c it has no Xlib dependency, so it can be benchmarked headless.
+
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include "vt.h"
+
+/* Palette slots. The eight ANSI foreground colors come first so an SGR
+ * code maps to its slot with a subtraction; the rest are window chrome. */
+enum {
+    COL_BLACK, COL_RED, COL_GREEN, COL_YELLOW,
+    COL_BLUE, COL_MAGENTA, COL_CYAN, COL_WHITE,
+    COL_TEXT, COL_BG, COL_TITLE, COL_PANEL, COL_BORDER, COL_INPUT_BG,
+    COL_PROMPT_USER, COL_PROMPT_CWD, COL_STATUS_BG, COL_STATUS_TEXT,
+    COL_COUNT
+};
+
+#define MAX_LINE_CELLS 512
+
+/* One screen column: a code point and its palette slot */
+typedef struct {
+    unsigned int cp;
+    unsigned char color;
+} LineCell;
+
+/* A horizontal span of cells sharing one palette slot */
+typedef struct {
+    short col;
+    short len;
+    unsigned char color;
+} LayoutRun;
+
+typedef struct {
+    LineCell cells[MAX_LINE_CELLS];
+    int ncells;
+
+    /* Non-default backgrounds, left to right */
+    LayoutRun bg[MAX_LINE_CELLS];
+    int nbg;
+
+    /* Text runs (spaces omitted) grouped by color so each color is one
+     * draw request: runs of color c are text[color_first[c]] onward,
+     * color_count[c] of them, left to right */
+    LayoutRun text[MAX_LINE_CELLS];
+    int ntext;
+    int color_first[COL_COUNT];
+    int color_count[COL_COUNT];
+
+    LayoutRun underline[MAX_LINE_CELLS];
+    int nunderline;
+} RowLayout;
+
+/* Lay out one terminal row of `cols` cells */
+void layout_row(RowLayout *out, const VtCell *line, int cols);
+
+/* Lay out a UTF-8 string in a single color (window chrome, prompt) */
+void layout_string(RowLayout *out, const char *s, int len, int color);
+
+#endif // LAYOUT_H
@@ -0,0 +1,194 @@
+// pyansi.c
+// CPython extension used by gui_terminal.py: runs child output through the
+// same escape parser as the X11 GUI (vt_segment in vt.c) and returns it as
+// ready-to-insert (text, tag) pairs for a Tk Text widget.
+//
+// Build: make pyext   (produces gui_ansi<EXT_SUFFIX> next to gui_terminal.py)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+#include "vt.h"
+
+/* Ops returned between (text, tag) pairs */
+#define OP_CR 1
+#define OP_CLEAR 2
+
+static PyObject *tag_names[VT_DEFAULT_COLOR + 1];
+
+typedef struct {
+    PyObject_HEAD
+    VtSegmenter seg;
+    char carry[4];           /* incomplete UTF-8 sequence from the last chunk */
+    int carry_len;
+} ParserObject;
+
+typedef struct {
+    PyObject *list;
+    int failed;
+} EmitContext;
+
+/* Drop what this batch already queued for the current line. Returns 1 if
+ * the line start was found in the batch, 0 if it lies in earlier output. */
+static int rewind_line(PyObject *list) {
+    Py_ssize_t n = PyList_GET_SIZE(list);
+    while (n > 0) {
+        PyObject *item = PyList_GET_ITEM(list, n - 1);
+        if (!PyTuple_Check(item)) return 0;  /* an op: stop there */
+
+        PyObject *text = PyTuple_GET_ITEM(item, 0);
+        Py_ssize_t len = PyUnicode_GET_LENGTH(text);
+        Py_ssize_t nl = PyUnicode_FindChar(text, '\n', 0, len, -1);
+        if (nl >= 0) {
+            if (nl + 1 < len) {
+                PyObject *head = PyUnicode_Substring(text, 0, nl + 1);
+                if (!head) return -1;
+                PyObject *pair = PyTuple_Pack(2, head, PyTuple_GET_ITEM(item, 1));
+                Py_DECREF(head);
+                if (!pair) return -1;
+                PyList_SetItem(list, n - 1, pair);
+            }
+            return 1;
+        }
+        if (PyList_SetSlice(list, n - 1, n, NULL) < 0) return -1;
+        n--;
+    }
+    return 0;
+}
+
+static void emit_segment(void *ctx, int kind, const char *text, size_t len, uint8_t fg, uint8_t attr) {
+    EmitContext *ec = ctx;
+    (void)attr;
+    if (ec->failed) return;
+
+    if (kind == VT_SEG_TEXT) {
+        PyObject *str = PyUnicode_DecodeUTF8(text, (Py_ssize_t)len, "replace");
+        if (!str) { ec->failed = 1; return; }
+        PyObject *tag = tag_names[fg < 16 ? (fg & 7) : VT_DEFAULT_COLOR];
+        PyObject *pair = PyTuple_Pack(2, str, tag);
+        Py_DECREF(str);
+        if (!pair || PyList_Append(ec->list, pair) < 0) ec->failed = 1;
+        Py_XDECREF(pair);
+        return;
+    }
+
+    PyObject *op = NULL;
+    if (kind == VT_SEG_CLEAR) {
+        /* Nothing before a clear is ever shown */
+        if (PyList_SetSlice(ec->list, 0, PyList_GET_SIZE(ec->list), NULL) < 0) { ec->failed = 1; return; }
+        op = PyLong_FromLong(OP_CLEAR);
+    } else {
+        int found = rewind_line(ec->list);
+        if (found < 0) { ec->failed = 1; return; }
+        if (found) return;
+        op = PyLong_FromLong(OP_CR);
+    }
+    if (!op || PyList_Append(ec->list, op) < 0) ec->failed = 1;
+    Py_XDECREF(op);
+}
+
+/* Length of a trailing UTF-8 sequence that is not complete yet */
+static int incomplete_utf8_tail(const unsigned char *d, Py_ssize_t len) {
+    for (int back = 1; back <= 3 && back <= len; back++) {
+        unsigned char c = d[len - back];
+        if ((c & 0xc0) == 0x80) continue;
+        int need = (c & 0xe0) == 0xc0 ? 2 : (c & 0xf0) == 0xe0 ? 3 : (c & 0xf8) == 0xf0 ? 4 : 1;
+        return need > back ? back : 0;
+    }
+    return 0;
+}
+
+static PyObject *parser_feed(ParserObject *self, PyObject *arg) {
+    Py_buffer view;
+    if (PyObject_GetBuffer(arg, &view, PyBUF_SIMPLE) < 0) return NULL;
+
+    /* Prepend bytes held back from the previous chunk */
+    const unsigned char *data = view.buf;
+    Py_ssize_t len = view.len;
+    char *joined = NULL;
+    if (self->carry_len > 0) {
+        joined = PyMem_Malloc(self->carry_len + len);
+        if (!joined) {
+            PyBuffer_Release(&view);
+            return PyErr_NoMemory();
+        }
+        memcpy(joined, self->carry, self->carry_len);
+        memcpy(joined + self->carry_len, view.buf, len);
+        data = (const unsigned char *)joined;
+        len += self->carry_len;
+        self->carry_len = 0;
+    }
+
+    int tail = incomplete_utf8_tail(data, len);
+    memcpy(self->carry, data + len - tail, tail);
+    self->carry_len = tail;
+
+    EmitContext ec = { PyList_New(0), 0 };
+    if (ec.list) {
+        vt_segment(&self->seg, (const char *)data, (size_t)(len - tail), emit_segment, &ec);
+    }
+    PyMem_Free(joined);
+    PyBuffer_Release(&view);
+
+    if (ec.list && ec.failed) {
+        Py_CLEAR(ec.list);
+    }
+    return ec.list;
+}
+
+static int parser_init(ParserObject *self, PyObject *args, PyObject *kwds) {
+    static char *kwlist[] = { NULL };
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "", kwlist)) return -1;
+    vt_segmenter_init(&self->seg);
+    self->carry_len = 0;
+    return 0;
+}
+
+static PyMethodDef parser_methods[] = {
+    { "feed", (PyCFunction)parser_feed, METH_O,
+      "feed(data: bytes) -> list of (text, tag) pairs, CR and CLEAR ops" },
+    { NULL, NULL, 0, NULL }
+};
+
+static PyTypeObject ParserType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "gui_ansi.Parser",
+    .tp_basicsize = sizeof(ParserObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Streaming ANSI segmenter (state carries across feed calls)",
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)parser_init,
+    .tp_methods = parser_methods,
+};
+
+static struct PyModuleDef gui_ansi_module = {
+    PyModuleDef_HEAD_INIT, "gui_ansi",
+    "ANSI segmentation for the Tk GUI, shared with the X11 GUI's parser", -1,
+    NULL, NULL, NULL, NULL, NULL
+};
+
+PyMODINIT_FUNC PyInit_gui_ansi(void) {
+    static const char *names[8] = {
+        "ansi_black", "ansi_red", "ansi_green", "ansi_yellow",
+        "ansi_blue", "ansi_magenta", "ansi_cyan", "ansi_white"
+    };
+    for (int i = 0; i < 8; i++) {
+        tag_names[i] = PyUnicode_InternFromString(names[i]);
+        if (!tag_names[i]) return NULL;
+    }
+    tag_names[VT_DEFAULT_COLOR] = PyUnicode_InternFromString("");
+    if (!tag_names[VT_DEFAULT_COLOR]) return NULL;
+
+    if (PyType_Ready(&ParserType) < 0) return NULL;
+    PyObject *m = PyModule_Create(&gui_ansi_module);
+    if (!m) return NULL;
+    Py_INCREF(&ParserType);
+    if (PyModule_AddObject(m, "Parser", (PyObject *)&ParserType) < 0 ||
+        PyModule_AddIntConstant(m, "CR", OP_CR) < 0 ||
+        PyModule_AddIntConstant(m, "CLEAR", OP_CLEAR) < 0) {
+        Py_DECREF(&ParserType);
+        Py_DECREF(m);
+        return NULL;
+    }
+    return m;
+}
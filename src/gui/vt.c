@@ -0,0 +1,745 @@
+// vt.c
+// Table-driven VT100/xterm-subset parser and cell grid. The parser follows
+// the usual DEC state machine layout: every input byte is classified, and
+// a [state][class] table gives the action to run and the next state.
+
+#include <stdlib.h>
+#include <string.h>
+#include "vt.h"
+
+/* Parser states */
+enum {
+    ST_GROUND,
+    ST_ESCAPE,
+    ST_ESC_INTER,
+    ST_CSI_ENTRY,
+    ST_CSI_PARAM,
+    ST_CSI_INTER,
+    ST_CSI_IGNORE,
+    ST_OSC,
+    ST_COUNT
+};
+
+/* Byte classes */
+enum {
+    CL_C0,        /* control characters executed immediately */
+    CL_BEL,       /* 0x07, also terminates OSC */
+    CL_CANCEL,    /* CAN, SUB: abort the sequence */
+    CL_ESC,
+    CL_INTER,     /* 0x20-0x2f */
+    CL_DIGIT,     /* 0-9 */
+    CL_SEMI,      /* ; and : */
+    CL_PRIVATE,   /* < = > ? */
+    CL_CSI_INTRO, /* [ */
+    CL_OSC_INTRO, /* ] */
+    CL_FINAL,     /* remaining 0x40-0x7e */
+    CL_DEL,
+    CL_HIGH,      /* 0x80-0xff, UTF-8 bytes */
+    CL_COUNT
+};
+
+/* Actions */
+enum {
+    A_NONE,
+    A_PRINT,
+    A_EXECUTE,
+    A_CLEAR,
+    A_COLLECT,
+    A_PARAM,
+    A_ESC_DISPATCH,
+    A_CSI_DISPATCH
+};
+
+#define T(action, next) (unsigned char)(((action) << 4) | (next))
+
+static const unsigned char vt_table[ST_COUNT][CL_COUNT] = {
+    [ST_GROUND] = {
+        T(A_EXECUTE, ST_GROUND), T(A_EXECUTE, ST_GROUND), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_PRINT, ST_GROUND), T(A_PRINT, ST_GROUND),
+        T(A_PRINT, ST_GROUND), T(A_PRINT, ST_GROUND), T(A_PRINT, ST_GROUND),
+        T(A_PRINT, ST_GROUND), T(A_PRINT, ST_GROUND), T(A_NONE, ST_GROUND),
+        T(A_PRINT, ST_GROUND)
+    },
+    [ST_ESCAPE] = {
+        T(A_EXECUTE, ST_ESCAPE), T(A_EXECUTE, ST_ESCAPE), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_COLLECT, ST_ESC_INTER), T(A_ESC_DISPATCH, ST_GROUND),
+        T(A_ESC_DISPATCH, ST_GROUND), T(A_ESC_DISPATCH, ST_GROUND), T(A_CLEAR, ST_CSI_ENTRY),
+        T(A_NONE, ST_OSC), T(A_ESC_DISPATCH, ST_GROUND), T(A_NONE, ST_ESCAPE),
+        T(A_NONE, ST_GROUND)
+    },
+    [ST_ESC_INTER] = {
+        T(A_EXECUTE, ST_ESC_INTER), T(A_EXECUTE, ST_ESC_INTER), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_COLLECT, ST_ESC_INTER), T(A_ESC_DISPATCH, ST_GROUND),
+        T(A_ESC_DISPATCH, ST_GROUND), T(A_ESC_DISPATCH, ST_GROUND), T(A_ESC_DISPATCH, ST_GROUND),
+        T(A_ESC_DISPATCH, ST_GROUND), T(A_ESC_DISPATCH, ST_GROUND), T(A_NONE, ST_ESC_INTER),
+        T(A_NONE, ST_GROUND)
+    },
+    [ST_CSI_ENTRY] = {
+        T(A_EXECUTE, ST_CSI_ENTRY), T(A_EXECUTE, ST_CSI_ENTRY), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_COLLECT, ST_CSI_INTER), T(A_PARAM, ST_CSI_PARAM),
+        T(A_PARAM, ST_CSI_PARAM), T(A_COLLECT, ST_CSI_PARAM), T(A_CSI_DISPATCH, ST_GROUND),
+        T(A_CSI_DISPATCH, ST_GROUND), T(A_CSI_DISPATCH, ST_GROUND), T(A_NONE, ST_CSI_ENTRY),
+        T(A_NONE, ST_CSI_ENTRY)
+    },
+    [ST_CSI_PARAM] = {
+        T(A_EXECUTE, ST_CSI_PARAM), T(A_EXECUTE, ST_CSI_PARAM), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_COLLECT, ST_CSI_INTER), T(A_PARAM, ST_CSI_PARAM),
+        T(A_PARAM, ST_CSI_PARAM), T(A_NONE, ST_CSI_IGNORE), T(A_CSI_DISPATCH, ST_GROUND),
+        T(A_CSI_DISPATCH, ST_GROUND), T(A_CSI_DISPATCH, ST_GROUND), T(A_NONE, ST_CSI_PARAM),
+        T(A_NONE, ST_CSI_PARAM)
+    },
+    [ST_CSI_INTER] = {
+        T(A_EXECUTE, ST_CSI_INTER), T(A_EXECUTE, ST_CSI_INTER), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_COLLECT, ST_CSI_INTER), T(A_NONE, ST_CSI_IGNORE),
+        T(A_NONE, ST_CSI_IGNORE), T(A_NONE, ST_CSI_IGNORE), T(A_CSI_DISPATCH, ST_GROUND),
+        T(A_CSI_DISPATCH, ST_GROUND), T(A_CSI_DISPATCH, ST_GROUND), T(A_NONE, ST_CSI_INTER),
+        T(A_NONE, ST_CSI_INTER)
+    },
+    [ST_CSI_IGNORE] = {
+        T(A_EXECUTE, ST_CSI_IGNORE), T(A_EXECUTE, ST_CSI_IGNORE), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_NONE, ST_CSI_IGNORE), T(A_NONE, ST_CSI_IGNORE),
+        T(A_NONE, ST_CSI_IGNORE), T(A_NONE, ST_CSI_IGNORE), T(A_NONE, ST_GROUND),
+        T(A_NONE, ST_GROUND), T(A_NONE, ST_GROUND), T(A_NONE, ST_CSI_IGNORE),
+        T(A_NONE, ST_CSI_IGNORE)
+    },
+    [ST_OSC] = {
+        /* Window titles etc. are consumed and dropped; BEL or ESC ends them */
+        T(A_NONE, ST_OSC), T(A_NONE, ST_GROUND), T(A_NONE, ST_GROUND),
+        T(A_CLEAR, ST_ESCAPE), T(A_NONE, ST_OSC), T(A_NONE, ST_OSC),
+        T(A_NONE, ST_OSC), T(A_NONE, ST_OSC), T(A_NONE, ST_OSC),
+        T(A_NONE, ST_OSC), T(A_NONE, ST_OSC), T(A_NONE, ST_OSC),
+        T(A_NONE, ST_OSC)
+    }
+};
+
+static unsigned char byte_class[256];
+static int byte_class_ready = 0;
+
+static void init_byte_classes(void) {
+    for (int c = 0; c < 256; c++) {
+        unsigned char cl;
+        if (c == 0x07) cl = CL_BEL;
+        else if (c == 0x18 || c == 0x1a) cl = CL_CANCEL;
+        else if (c == 0x1b) cl = CL_ESC;
+        else if (c < 0x20) cl = CL_C0;
+        else if (c < 0x30) cl = CL_INTER;
+        else if (c <= 0x39) cl = CL_DIGIT;
+        else if (c == 0x3a || c == 0x3b) cl = CL_SEMI;
+        else if (c < 0x40) cl = CL_PRIVATE;
+        else if (c == '[') cl = CL_CSI_INTRO;
+        else if (c == ']') cl = CL_OSC_INTRO;
+        else if (c < 0x7f) cl = CL_FINAL;
+        else if (c == 0x7f) cl = CL_DEL;
+        else cl = CL_HIGH;
+        byte_class[c] = cl;
+    }
+    byte_class_ready = 1;
+}
+
+/* ---- grid helpers ---- */
+
+static void clear_cells(VtTerm *t, VtCell *cells, int n) {
+    VtCell blank = t->pen;
+    blank.cp = ' ';
+    blank.attr &= ~(VT_ATTR_UNDERLINE);
+    for (int i = 0; i < n; i++) cells[i] = blank;
+}
+
+static void mark_dirty(VtTerm *t, int from, int to) {
+    if (from < 0) from = 0;
+    if (to >= t->rows) to = t->rows - 1;
+    if (from <= to) memset(t->dirty + from, 1, to - from + 1);
+}
+
+static void push_scrollback(VtTerm *t, const VtCell *line) {
+    if (t->sb_cap == 0) return;
+    memcpy(t->sb_block + (size_t)t->sb_head * t->cols, line, sizeof(VtCell) * t->cols);
+    t->sb_head = (t->sb_head + 1) % t->sb_cap;
+    if (t->sb_count < t->sb_cap) t->sb_count++;
+}
+
+/* Scroll rows top..bottom up by n, rotating row pointers */
+static void scroll_up(VtTerm *t, int top, int bottom, int n) {
+    int height = bottom - top + 1;
+    if (n <= 0) return;
+    if (n > height) n = height;
+
+    VtCell *spare[n];
+    for (int i = 0; i < n; i++) {
+        /* Only the full-screen region feeds the scrollback */
+        if (top == 0 && bottom == t->rows - 1) push_scrollback(t, t->lines[top + i]);
+        spare[i] = t->lines[top + i];
+    }
+    memmove(&t->lines[top], &t->lines[top + n], sizeof(VtCell *) * (height - n));
+    for (int i = 0; i < n; i++) {
+        t->lines[bottom - n + 1 + i] = spare[i];
+        clear_cells(t, spare[i], t->cols);
+    }
+    mark_dirty(t, top, bottom);
+}
+
+static void scroll_down(VtTerm *t, int top, int bottom, int n) {
+    int height = bottom - top + 1;
+    if (n <= 0) return;
+    if (n > height) n = height;
+
+    VtCell *spare[n];
+    for (int i = 0; i < n; i++) spare[i] = t->lines[bottom - n + 1 + i];
+    memmove(&t->lines[top + n], &t->lines[top], sizeof(VtCell *) * (height - n));
+    for (int i = 0; i < n; i++) {
+        t->lines[top + i] = spare[i];
+        clear_cells(t, spare[i], t->cols);
+    }
+    mark_dirty(t, top, bottom);
+}
+
+static void line_feed(VtTerm *t) {
+    if (t->cur_row == t->scroll_bottom) {
+        scroll_up(t, t->scroll_top, t->scroll_bottom, 1);
+    } else if (t->cur_row < t->rows - 1) {
+        t->cur_row++;
+    }
+}
+
+static void clamp_cursor(VtTerm *t) {
+    if (t->cur_row < 0) t->cur_row = 0;
+    if (t->cur_row >= t->rows) t->cur_row = t->rows - 1;
+    if (t->cur_col < 0) t->cur_col = 0;
+    if (t->cur_col >= t->cols) t->cur_col = t->cols - 1;
+    t->wrap_pending = 0;
+}
+
+static void put_char(VtTerm *t, uint32_t cp) {
+    if (t->wrap_pending) {
+        t->cur_col = 0;
+        line_feed(t);
+        t->wrap_pending = 0;
+    }
+    VtCell *cell = &t->lines[t->cur_row][t->cur_col];
+    *cell = t->pen;
+    cell->cp = cp;
+    t->dirty[t->cur_row] = 1;
+
+    if (t->cur_col == t->cols - 1) {
+        if (t->autowrap) t->wrap_pending = 1;
+    } else {
+        t->cur_col++;
+    }
+}
+
+/* Fast path for runs of printable ASCII in the ground state */
+static void put_ascii(VtTerm *t, const unsigned char *s, size_t n) {
+    while (n > 0) {
+        if (t->wrap_pending) {
+            t->cur_col = 0;
+            line_feed(t);
+            t->wrap_pending = 0;
+        }
+        VtCell *row = t->lines[t->cur_row];
+        size_t room = (size_t)(t->cols - t->cur_col);
+        size_t run = n < room ? n : room;
+        for (size_t i = 0; i < run; i++) {
+            row[t->cur_col + i] = t->pen;
+            row[t->cur_col + i].cp = s[i];
+        }
+        t->dirty[t->cur_row] = 1;
+        t->cur_col += (int)run;
+        s += run;
+        n -= run;
+        if (t->cur_col >= t->cols) {
+            t->cur_col = t->cols - 1;
+            if (t->autowrap) {
+                t->wrap_pending = 1;
+            } else {
+                /* Without autowrap the rest overwrites the last column */
+                if (n > 0) {
+                    row[t->cur_col] = t->pen;
+                    row[t->cur_col].cp = s[n - 1];
+                }
+                n = 0;
+            }
+        }
+    }
+}
+
+static void print_byte(VtTerm *t, unsigned char c) {
+    if (c < 0x80) {
+        t->utf8_need = 0;
+        put_char(t, c);
+        return;
+    }
+    if (t->utf8_need > 0 && (c & 0xc0) == 0x80) {
+        t->utf8_cp = (t->utf8_cp << 6) | (c & 0x3f);
+        if (--t->utf8_need == 0) put_char(t, t->utf8_cp);
+        return;
+    }
+    if ((c & 0xe0) == 0xc0) { t->utf8_cp = c & 0x1f; t->utf8_need = 1; }
+    else if ((c & 0xf0) == 0xe0) { t->utf8_cp = c & 0x0f; t->utf8_need = 2; }
+    else if ((c & 0xf8) == 0xf0) { t->utf8_cp = c & 0x07; t->utf8_need = 3; }
+    else { t->utf8_need = 0; put_char(t, 0xfffd); }
+}
+
+static void execute(VtTerm *t, unsigned char c) {
+    switch (c) {
+        case '\b':
+            if (t->cur_col > 0) t->cur_col--;
+            t->wrap_pending = 0;
+            break;
+        case '\t': {
+            int next = (t->cur_col / 8 + 1) * 8;
+            t->cur_col = next < t->cols ? next : t->cols - 1;
+            t->wrap_pending = 0;
+            break;
+        }
+        case '\n': case '\v': case '\f':
+            if (t->newline_mode) t->cur_col = 0;
+            line_feed(t);
+            t->wrap_pending = 0;
+            break;
+        case '\r':
+            t->cur_col = 0;
+            t->wrap_pending = 0;
+            break;
+        default:
+            break;  /* BEL and the rest are ignored */
+    }
+}
+
+/* Accumulate a CSI parameter digit or separator */
+static void collect_param(int *params, int *nparams, unsigned char c) {
+    if (*nparams == 0) params[(*nparams)++] = 0;
+    if (c == ';' || c == ':') {
+        if (*nparams < VT_MAX_PARAMS) params[(*nparams)++] = 0;
+    } else {
+        int *p = &params[*nparams - 1];
+        if (*p < 10000) *p = *p * 10 + (c - '0');
+    }
+}
+
+/* Parameter i, or def when missing/zero */
+static int param(const VtTerm *t, int i, int def) {
+    if (i >= t->nparams || t->params[i] == 0) return def;
+    return t->params[i];
+}
+
+static void erase_display(VtTerm *t, int mode) {
+    VtCell *row = t->lines[t->cur_row];
+    if (mode == 0) {
+        clear_cells(t, row + t->cur_col, t->cols - t->cur_col);
+        for (int r = t->cur_row + 1; r < t->rows; r++) clear_cells(t, t->lines[r], t->cols);
+        mark_dirty(t, t->cur_row, t->rows - 1);
+    } else if (mode == 1) {
+        for (int r = 0; r < t->cur_row; r++) clear_cells(t, t->lines[r], t->cols);
+        clear_cells(t, row, t->cur_col + 1);
+        mark_dirty(t, 0, t->cur_row);
+    } else if (mode == 3) {
+        /* Like xterm: the saved lines go, the screen stays (a scrolled-back
+         * view is redrawn) */
+        t->sb_count = 0;
+        mark_dirty(t, 0, t->rows - 1);
+    } else {
+        for (int r = 0; r < t->rows; r++) clear_cells(t, t->lines[r], t->cols);
+        mark_dirty(t, 0, t->rows - 1);
+    }
+}
+
+static void erase_line(VtTerm *t, int mode) {
+    VtCell *row = t->lines[t->cur_row];
+    if (mode == 0) clear_cells(t, row + t->cur_col, t->cols - t->cur_col);
+    else if (mode == 1) clear_cells(t, row, t->cur_col + 1);
+    else clear_cells(t, row, t->cols);
+    t->dirty[t->cur_row] = 1;
+}
+
+/* SGR: shared by the grid and the segmenter */
+static void apply_sgr(const int *params, int nparams, VtCell *pen) {
+    if (nparams == 0) {
+        pen->fg = pen->bg = VT_DEFAULT_COLOR;
+        pen->attr = 0;
+        return;
+    }
+    for (int i = 0; i < nparams; i++) {
+        int p = params[i];
+        if (p == 0) {
+            pen->fg = pen->bg = VT_DEFAULT_COLOR;
+            pen->attr = 0;
+        } else if (p == 1) pen->attr |= VT_ATTR_BOLD;
+        else if (p == 4) pen->attr |= VT_ATTR_UNDERLINE;
+        else if (p == 7) pen->attr |= VT_ATTR_REVERSE;
+        else if (p == 22) pen->attr &= ~VT_ATTR_BOLD;
+        else if (p == 24) pen->attr &= ~VT_ATTR_UNDERLINE;
+        else if (p == 27) pen->attr &= ~VT_ATTR_REVERSE;
+        else if (p >= 30 && p <= 37) pen->fg = (uint8_t)(p - 30);
+        else if (p == 39) pen->fg = VT_DEFAULT_COLOR;
+        else if (p >= 40 && p <= 47) pen->bg = (uint8_t)(p - 40);
+        else if (p == 49) pen->bg = VT_DEFAULT_COLOR;
+        else if (p >= 90 && p <= 97) pen->fg = (uint8_t)(p - 90 + 8);
+        else if (p >= 100 && p <= 107) pen->bg = (uint8_t)(p - 100 + 8);
+        else if ((p == 38 || p == 48) && i + 2 < nparams && params[i + 1] == 5) {
+            /* 256-color: keep the 16 base colors, fold the rest to default */
+            int idx = params[i + 2];
+            uint8_t col = idx < 16 ? (uint8_t)idx : VT_DEFAULT_COLOR;
+            if (p == 38) pen->fg = col; else pen->bg = col;
+            i += 2;
+        } else if ((p == 38 || p == 48) && i + 4 < nparams && params[i + 1] == 2) {
+            i += 4;  /* truecolor is not representable, skip its components */
+        }
+    }
+}
+
+static void set_mode(VtTerm *t, int on) {
+    for (int i = 0; i < t->nparams; i++) {
+        int p = t->params[i];
+        if (t->intermediate == '?') {
+            if (p == 7) t->autowrap = on;
+            else if (p == 25) t->cursor_visible = on;
+            else if (p == 47 || p == 1047 || p == 1049) {
+                /* No separate alternate buffer: start and leave with a clean screen */
+                if (p == 1049 && on) { t->saved_row = t->cur_row; t->saved_col = t->cur_col; }
+                erase_display(t, 2);
+                if (p == 1049 && !on) { t->cur_row = t->saved_row; t->cur_col = t->saved_col; clamp_cursor(t); }
+            }
+        } else if (p == 20) {
+            t->newline_mode = on;
+        }
+    }
+}
+
+static void csi_dispatch(VtTerm *t, unsigned char final) {
+    VtCell *row = t->lines[t->cur_row];
+    int n;
+
+    switch (final) {
+        case 'A': t->cur_row -= param(t, 0, 1); clamp_cursor(t); break;
+        case 'B': t->cur_row += param(t, 0, 1); clamp_cursor(t); break;
+        case 'C': t->cur_col += param(t, 0, 1); clamp_cursor(t); break;
+        case 'D': t->cur_col -= param(t, 0, 1); clamp_cursor(t); break;
+        case 'E': t->cur_row += param(t, 0, 1); t->cur_col = 0; clamp_cursor(t); break;
+        case 'F': t->cur_row -= param(t, 0, 1); t->cur_col = 0; clamp_cursor(t); break;
+        case 'G': case '`': t->cur_col = param(t, 0, 1) - 1; clamp_cursor(t); break;
+        case 'd': t->cur_row = param(t, 0, 1) - 1; clamp_cursor(t); break;
+        case 'H': case 'f':
+            t->cur_row = param(t, 0, 1) - 1;
+            t->cur_col = param(t, 1, 1) - 1;
+            clamp_cursor(t);
+            break;
+        case 'J': erase_display(t, t->nparams ? t->params[0] : 0); break;
+        case 'K': erase_line(t, t->nparams ? t->params[0] : 0); break;
+        case 'L':
+            if (t->cur_row >= t->scroll_top && t->cur_row <= t->scroll_bottom)
+                scroll_down(t, t->cur_row, t->scroll_bottom, param(t, 0, 1));
+            break;
+        case 'M':
+            if (t->cur_row >= t->scroll_top && t->cur_row <= t->scroll_bottom)
+                scroll_up(t, t->cur_row, t->scroll_bottom, param(t, 0, 1));
+            break;
+        case 'P':
+            n = param(t, 0, 1);
+            if (n > t->cols - t->cur_col) n = t->cols - t->cur_col;
+            memmove(row + t->cur_col, row + t->cur_col + n, sizeof(VtCell) * (t->cols - t->cur_col - n));
+            clear_cells(t, row + t->cols - n, n);
+            t->dirty[t->cur_row] = 1;
+            break;
+        case '@':
+            n = param(t, 0, 1);
+            if (n > t->cols - t->cur_col) n = t->cols - t->cur_col;
+            memmove(row + t->cur_col + n, row + t->cur_col, sizeof(VtCell) * (t->cols - t->cur_col - n));
+            clear_cells(t, row + t->cur_col, n);
+            t->dirty[t->cur_row] = 1;
+            break;
+        case 'X':
+            n = param(t, 0, 1);
+            if (n > t->cols - t->cur_col) n = t->cols - t->cur_col;
+            clear_cells(t, row + t->cur_col, n);
+            t->dirty[t->cur_row] = 1;
+            break;
+        case 'S': scroll_up(t, t->scroll_top, t->scroll_bottom, param(t, 0, 1)); break;
+        case 'T': scroll_down(t, t->scroll_top, t->scroll_bottom, param(t, 0, 1)); break;
+        case 'm': apply_sgr(t->params, t->nparams, &t->pen); break;
+        case 'h': set_mode(t, 1); break;
+        case 'l': set_mode(t, 0); break;
+        case 'r': {
+            int top = param(t, 0, 1) - 1;
+            int bottom = param(t, 1, t->rows) - 1;
+            if (bottom >= t->rows) bottom = t->rows - 1;
+            if (top < bottom) {
+                t->scroll_top = top;
+                t->scroll_bottom = bottom;
+                t->cur_row = 0;
+                t->cur_col = 0;
+                t->wrap_pending = 0;
+            }
+            break;
+        }
+        case 's': t->saved_row = t->cur_row; t->saved_col = t->cur_col; break;
+        case 'u': t->cur_row = t->saved_row; t->cur_col = t->saved_col; clamp_cursor(t); break;
+        default:
+            break;  /* unsupported sequences are consumed silently */
+    }
+}
+
+static void esc_dispatch(VtTerm *t, unsigned char final) {
+    if (t->intermediate != 0) return;  /* charset selection etc. */
+    switch (final) {
+        case '7': t->saved_row = t->cur_row; t->saved_col = t->cur_col; break;
+        case '8': t->cur_row = t->saved_row; t->cur_col = t->saved_col; clamp_cursor(t); break;
+        case 'D': line_feed(t); break;
+        case 'E': t->cur_col = 0; line_feed(t); break;
+        case 'M':
+            if (t->cur_row == t->scroll_top) scroll_down(t, t->scroll_top, t->scroll_bottom, 1);
+            else if (t->cur_row > 0) t->cur_row--;
+            break;
+        case 'c': vt_reset(t); break;
+        default: break;
+    }
+}
+
+static void run_action(VtTerm *t, int action, unsigned char c) {
+    switch (action) {
+        case A_PRINT:
+            print_byte(t, c);
+            break;
+        case A_EXECUTE:
+            execute(t, c);
+            break;
+        case A_CLEAR:
+            t->nparams = 0;
+            t->intermediate = 0;
+            break;
+        case A_COLLECT:
+            t->intermediate = (char)c;
+            break;
+        case A_PARAM:
+            collect_param(t->params, &t->nparams, c);
+            break;
+        case A_ESC_DISPATCH:
+            esc_dispatch(t, c);
+            break;
+        case A_CSI_DISPATCH:
+            csi_dispatch(t, c);
+            break;
+        default:
+            break;
+    }
+}
+
+void vt_feed(VtTerm *t, const char *data, size_t len) {
+    const unsigned char *s = (const unsigned char *)data;
+    size_t i = 0;
+
+    while (i < len) {
+        unsigned char c = s[i];
+        if (t->state == ST_GROUND && c >= 0x20 && c < 0x7f) {
+            size_t j = i + 1;
+            while (j < len && s[j] >= 0x20 && s[j] < 0x7f) j++;
+            t->utf8_need = 0;
+            put_ascii(t, s + i, j - i);
+            i = j;
+            continue;
+        }
+        unsigned char entry = vt_table[t->state][byte_class[c]];
+        run_action(t, entry >> 4, c);
+        t->state = entry & 0x0f;
+        i++;
+    }
+}
+
+void vt_segmenter_init(VtSegmenter *s) {
+    if (!byte_class_ready) init_byte_classes();
+    memset(s, 0, sizeof(*s));
+    s->state = ST_GROUND;
+    s->fg = VT_DEFAULT_COLOR;
+}
+
+void vt_segment(VtSegmenter *s, const char *data, size_t len, VtSegmentFn emit, void *ctx) {
+    const unsigned char *d = (const unsigned char *)data;
+    size_t run = 0;      /* start of the text run being collected */
+    size_t i = 0;
+
+#define FLUSH_RUN(end) do { \
+        if ((end) > run) emit(ctx, VT_SEG_TEXT, data + run, (end) - run, s->fg, s->attr); \
+    } while (0)
+
+    if (s->pending_cr && len > 0) {
+        if (d[0] != '\n') emit(ctx, VT_SEG_CR, NULL, 0, s->fg, s->attr);
+        s->pending_cr = 0;
+    }
+
+    while (i < len) {
+        unsigned char c = d[i];
+
+        /* Printable text and UTF-8 bytes extend the current run */
+        if (s->state == ST_GROUND && (c >= 0x20 ? c != 0x7f : (c == '\n' || c == '\t'))) {
+            i++;
+            continue;
+        }
+
+        FLUSH_RUN(i);
+        run = i + 1;
+
+        unsigned char entry = vt_table[s->state][byte_class[c]];
+        switch (entry >> 4) {
+            case A_EXECUTE:
+                if (c == '\r') {
+                    if (i + 1 == len) s->pending_cr = 1;
+                    else if (d[i + 1] != '\n') emit(ctx, VT_SEG_CR, NULL, 0, s->fg, s->attr);
+                }
+                break;
+            case A_CLEAR:
+                s->nparams = 0;
+                s->intermediate = 0;
+                break;
+            case A_COLLECT:
+                s->intermediate = (char)c;
+                break;
+            case A_PARAM:
+                collect_param(s->params, &s->nparams, c);
+                break;
+            case A_CSI_DISPATCH:
+                if (c == 'm' && s->intermediate == 0) {
+                    VtCell pen = { ' ', s->fg, VT_DEFAULT_COLOR, s->attr, 0 };
+                    apply_sgr(s->params, s->nparams, &pen);
+                    s->fg = pen.fg;
+                    s->attr = pen.attr;
+                } else if (c == 'J' && s->nparams > 0 && s->params[0] >= 2) {
+                    emit(ctx, VT_SEG_CLEAR, NULL, 0, s->fg, s->attr);
+                }
+                break;
+            default:
+                break;  /* cursor addressing has no meaning in a text stream */
+        }
+        s->state = entry & 0x0f;
+        i++;
+    }
+    FLUSH_RUN(len);
+#undef FLUSH_RUN
+}
+
+void vt_reset(VtTerm *t) {
+    t->pen.cp = ' ';
+    t->pen.fg = t->pen.bg = VT_DEFAULT_COLOR;
+    t->pen.attr = 0;
+    t->pen.unused = 0;
+    t->cur_row = t->cur_col = 0;
+    t->saved_row = t->saved_col = 0;
+    t->wrap_pending = 0;
+    t->autowrap = 1;
+    t->cursor_visible = 1;
+    t->scroll_top = 0;
+    t->scroll_bottom = t->rows - 1;
+    t->state = ST_GROUND;
+    t->nparams = 0;
+    t->intermediate = 0;
+    t->utf8_need = 0;
+    for (int r = 0; r < t->rows; r++) clear_cells(t, t->lines[r], t->cols);
+    mark_dirty(t, 0, t->rows - 1);
+}
+
+static int alloc_grid(VtTerm *t, int rows, int cols) {
+    t->screen_block = malloc(sizeof(VtCell) * (size_t)rows * cols);
+    t->lines = malloc(sizeof(VtCell *) * rows);
+    t->dirty = malloc(rows);
+    if (!t->screen_block || !t->lines || !t->dirty) return -1;
+    for (int r = 0; r < rows; r++) t->lines[r] = t->screen_block + (size_t)r * cols;
+    return 0;
+}
+
+int vt_init(VtTerm *t, int rows, int cols, int scrollback_lines) {
+    if (!byte_class_ready) init_byte_classes();
+    memset(t, 0, sizeof(*t));
+    if (rows < 1) rows = 1;
+    if (cols < 1) cols = 1;
+    t->rows = rows;
+    t->cols = cols;
+    t->sb_cap = scrollback_lines > 0 ? scrollback_lines : 0;
+    if (alloc_grid(t, rows, cols) != 0) { vt_free(t); return -1; }
+    if (t->sb_cap > 0) {
+        t->sb_block = malloc(sizeof(VtCell) * (size_t)t->sb_cap * cols);
+        if (!t->sb_block) { vt_free(t); return -1; }
+    }
+    vt_reset(t);
+    return 0;
+}
+
+void vt_free(VtTerm *t) {
+    free(t->screen_block);
+    free(t->lines);
+    free(t->dirty);
+    free(t->sb_block);
+    t->screen_block = NULL;
+    t->lines = NULL;
+    t->dirty = NULL;
+    t->sb_block = NULL;
+}
+
+/* Resize keeping the bottom of the screen (where the cursor usually is)
+ * and as much scrollback as fits the new width */
+int vt_resize(VtTerm *t, int rows, int cols) {
+    if (rows < 1) rows = 1;
+    if (cols < 1) cols = 1;
+    if (rows == t->rows && cols == t->cols) return 0;
+
+    /* Rows above the cursor that no longer fit go to the scrollback */
+    int shift = t->cur_row - (rows - 1);
+    if (shift > 0) {
+        int saved_top = t->scroll_top, saved_bottom = t->scroll_bottom;
+        scroll_up(t, 0, t->rows - 1, shift);
+        t->scroll_top = saved_top;
+        t->scroll_bottom = saved_bottom;
+        t->cur_row -= shift;
+    }
+
+    VtTerm old = *t;
+    if (alloc_grid(t, rows, cols) != 0) {
+        free(t->screen_block);
+        free(t->lines);
+        free(t->dirty);
+        *t = old;
+        return -1;
+    }
+    t->rows = rows;
+    t->cols = cols;
+    int keep_cols = cols < old.cols ? cols : old.cols;
+    for (int r = 0; r < rows; r++) {
+        clear_cells(t, t->lines[r], cols);
+        if (r < old.rows) memcpy(t->lines[r], old.lines[r], sizeof(VtCell) * keep_cols);
+    }
+
+    if (old.sb_block) {
+        t->sb_block = malloc(sizeof(VtCell) * (size_t)t->sb_cap * cols);
+        t->sb_head = 0;
+        t->sb_count = 0;
+        if (t->sb_block) {
+            for (int i = 0; i < old.sb_count; i++) {
+                int slot = (old.sb_head - old.sb_count + i + old.sb_cap) % old.sb_cap;
+                VtCell *dst = t->sb_block + (size_t)i * cols;
+                clear_cells(t, dst, cols);
+                memcpy(dst, old.sb_block + (size_t)slot * old.cols, sizeof(VtCell) * keep_cols);
+            }
+            t->sb_count = old.sb_count;
+            t->sb_head = old.sb_count % t->sb_cap;
+        } else {
+            t->sb_cap = 0;
+        }
+    }
+
+    free(old.screen_block);
+    free(old.lines);
+    free(old.dirty);
+    free(old.sb_block);
+
+    t->scroll_top = 0;
+    t->scroll_bottom = rows - 1;
+    clamp_cursor(t);
+    mark_dirty(t, 0, rows - 1);
+    return 0;
+}
+
+const VtCell *vt_view_line(const VtTerm *t, int offset, int row) {
+    if (offset > t->sb_count) offset = t->sb_count;
+    int line = row - offset;
+    if (line >= 0) return t->lines[line];
+    /* line -1 is the newest scrollback entry */
+    int slot = (t->sb_head + line + t->sb_cap) % t->sb_cap;
+    return t->sb_block + (size_t)slot * t->cols;
+}
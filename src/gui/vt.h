@@ -0,0 +1,105 @@
+// vt.h
+// Terminal model for the X11 GUI: a VT100/xterm-subset escape parser that
+// applies child output to a grid of cells. Contains no Xlib calls, so the
+// same code can be driven headless.
+
+#ifndef VT_H
+#define VT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Color indices stored in a cell: 0-15 are the ANSI colors (8-15 bright) */
+#define VT_DEFAULT_COLOR 16
+
+/* Cell attribute bits */
+#define VT_ATTR_BOLD      0x01
+#define VT_ATTR_UNDERLINE 0x02
+#define VT_ATTR_REVERSE   0x04
+
+#define VT_MAX_PARAMS 16
+
+/* One screen cell: 8 bytes, code point plus colors and attributes */
+typedef struct {
+    uint32_t cp;     /* Unicode code point, ' ' when blank */
+    uint8_t fg;      /* 0-15 or VT_DEFAULT_COLOR */
+    uint8_t bg;      /* 0-15 or VT_DEFAULT_COLOR */
+    uint8_t attr;    /* VT_ATTR_* bits */
+    uint8_t unused;
+} VtCell;
+
+typedef struct {
+    int rows;
+    int cols;
+
+    /* Screen rows are pointers into one block so scrolling only rotates
+     * pointers instead of moving cells */
+    VtCell *screen_block;
+    VtCell **lines;
+    unsigned char *dirty;    /* per screen row, cleared by the renderer */
+
+    /* Lines scrolled off the top, kept in a ring */
+    VtCell *sb_block;
+    int sb_cap;
+    int sb_count;
+    int sb_head;             /* slot the next line is written to */
+
+    /* Cursor and modes */
+    int cur_row;
+    int cur_col;
+    int saved_row;
+    int saved_col;
+    int wrap_pending;
+    int autowrap;
+    int newline_mode;        /* LF also returns the carriage (LNM) */
+    int cursor_visible;
+    int scroll_top;
+    int scroll_bottom;
+    VtCell pen;              /* colors/attributes applied to new text */
+
+    /* Escape parser state */
+    int state;
+    int params[VT_MAX_PARAMS];
+    int nparams;
+    char intermediate;       /* private marker or intermediate byte */
+    uint32_t utf8_cp;
+    int utf8_need;
+} VtTerm;
+
+/* Stream segmentation for widgets that keep text rather than a grid (the
+ * Tk GUI). Uses the same parser tables as VtTerm, but instead of updating
+ * cells it reports runs of text tagged with the current SGR colors. */
+enum {
+    VT_SEG_TEXT,    /* text run: UTF-8 bytes incl. '\n' and '\t' */
+    VT_SEG_CR,      /* lone carriage return: the current line restarts */
+    VT_SEG_CLEAR    /* erase display: everything shown so far is gone */
+};
+
+typedef void (*VtSegmentFn)(void *ctx, int kind, const char *text, size_t len,
+                            uint8_t fg, uint8_t attr);
+
+typedef struct {
+    int state;
+    int params[VT_MAX_PARAMS];
+    int nparams;
+    char intermediate;
+    int pending_cr;          /* '\r' ended the last chunk; '\n' may follow */
+    uint8_t fg;
+    uint8_t attr;
+} VtSegmenter;
+
+void vt_segmenter_init(VtSegmenter *s);
+void vt_segment(VtSegmenter *s, const char *data, size_t len, VtSegmentFn emit, void *ctx);
+
+int vt_init(VtTerm *t, int rows, int cols, int scrollback_lines);
+void vt_free(VtTerm *t);
+int vt_resize(VtTerm *t, int rows, int cols);
+void vt_reset(VtTerm *t);
+
+/* Feed raw child output; any split of the byte stream gives the same result */
+void vt_feed(VtTerm *t, const char *data, size_t len);
+
+/* Row of the view scrolled back by `offset` lines (0 = live screen) */
+const VtCell *vt_view_line(const VtTerm *t, int offset, int row);
+
+#endif // VT_H
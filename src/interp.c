@@ -0,0 +1,748 @@
+// interp.c
+// Tree-walking interpreter for parsed command lines (see parser.h) and the
+// shell variable table.
+//
+// A line is parsed once and its tree cached; running a loop is a walk over
+// that tree. Arithmetic, assignments, tests and builtins run in the shell
+// process, so a loop over builtins never forks. Simple commands are handed
+// to execute_argv (executor.c) after expansion; pipelines fork one child per
+// stage.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "interp.h"
+#include "parser.h"
+#include "executor.h"
+#include "utils/glob_expand.h"
+#include "utils/capture.h"
+#include "utils/heredoc.h"
+#include "utils/pipe_sched.h"
+
+#define VAR_BUCKETS 256
+#define PROGRAM_CACHE 64
+/* NAME=value prefixes of a pipeline's first stage seen by pipe_sched_load */
+#define PIPE_PREFIX_MAX 8
+
+static int last_status = 0;
+
+/* ---- variables ---- */
+
+typedef struct Var {
+    char *name;
+    char *value;
+    size_t cap;          /* bytes allocated for value */
+    int exported;
+    struct Var *next;
+} Var;
+
+static Var *vars[VAR_BUCKETS];
+
+static unsigned hash_name(const char *name) {
+    unsigned h = 2166136261u;
+    for (; *name != '\0'; name++) h = (h ^ (unsigned char)*name) * 16777619u;
+    return h;
+}
+
+static Var **var_slot(const char *name) {
+    Var **slot = &vars[hash_name(name) % VAR_BUCKETS];
+    while (*slot != NULL && strcmp((*slot)->name, name) != 0) slot = &(*slot)->next;
+    return slot;
+}
+
+int shell_var_valid(const char *name, size_t len) {
+    if (len == 0 || !(isalpha((unsigned char)name[0]) || name[0] == '_')) return 0;
+    for (size_t i = 1; i < len; i++) {
+        if (!(isalnum((unsigned char)name[i]) || name[i] == '_')) return 0;
+    }
+    return 1;
+}
+
+const char *shell_var_get(const char *name) {
+    Var *v = *var_slot(name);
+    return v != NULL ? v->value : getenv(name);
+}
+
+int shell_var_set(const char *name, const char *value, int exported) {
+    Var **slot = var_slot(name);
+    Var *v = *slot;
+    if (v == NULL) {
+        v = calloc(1, sizeof(Var));
+        if (v == NULL || (v->name = strdup(name)) == NULL) {
+            free(v);
+            return -1;
+        }
+        /* Variables inherited from the environment stay exported */
+        v->exported = getenv(name) != NULL;
+        *slot = v;
+    }
+    /* The value buffer is reused, so a loop counter costs no allocation */
+    size_t len = strlen(value);
+    if (len + 1 > v->cap) {
+        size_t cap = len + 1 < 32 ? 32 : len + 1;
+        char *grown = realloc(v->value, cap);
+        if (grown == NULL) return -1;
+        v->value = grown;
+        v->cap = cap;
+    }
+    memcpy(v->value, value, len + 1);
+    if (exported) v->exported = 1;
+    if (v->exported && setenv(name, value, 1) != 0) return -1;
+    return 0;
+}
+
+void shell_var_unset(const char *name) {
+    Var **slot = var_slot(name);
+    Var *v = *slot;
+    if (v != NULL) {
+        *slot = v->next;
+        free(v->name);
+        free(v->value);
+        free(v);
+    }
+    unsetenv(name);
+}
+
+static long long arith_get(const char *name) {
+    const char *value = shell_var_get(name);
+    return value != NULL ? strtoll(value, NULL, 10) : 0;
+}
+
+static void arith_set(const char *name, long long value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%lld", value);
+    shell_var_set(name, buf, 0);
+}
+
+static const ArithEnv arith_env = { arith_get, arith_set };
+
+int interp_last_status(void) {
+    return last_status < 0 ? 1 : last_status;
+}
+
+/* ---- parse cache ---- */
+
+typedef struct {
+    char *line;
+    Node *root;
+    int compound;        /* contains a loop or if */
+    int refs;
+} Program;
+
+static Program *program_cache[PROGRAM_CACHE];
+
+static void program_put(Program *prog) {
+    if (prog == NULL || --prog->refs > 0) return;
+    node_free(prog->root);
+    free(prog->line);
+    free(prog);
+}
+
+static int has_compound(const Node *n) {
+    if (n->kind == NODE_FOR || n->kind == NODE_WHILE || n->kind == NODE_UNTIL || n->kind == NODE_IF) return 1;
+    for (int i = 0; i < n->nkids; i++) {
+        if (has_compound(n->kids[i])) return 1;
+    }
+    return 0;
+}
+
+/* Parsed tree for line, from the cache when possible; release with
+ * program_put. A tree stays alive while it runs even if a nested line
+ * evicts it from the cache. */
+static Program *program_get(const char *line) {
+    Program **slot = &program_cache[hash_name(line) % PROGRAM_CACHE];
+    if (*slot != NULL && strcmp((*slot)->line, line) == 0) {
+        (*slot)->refs++;
+        return *slot;
+    }
+    Node *root = parse_line(line);
+    if (root == NULL) return NULL;
+    Program *prog = malloc(sizeof(Program));
+    if (prog == NULL || (prog->line = strdup(line)) == NULL) {
+        free(prog);
+        node_free(root);
+        return NULL;
+    }
+    prog->root = root;
+    prog->compound = has_compound(root);
+    prog->refs = 2;      /* the cache and the caller */
+    program_put(*slot);
+    *slot = prog;
+    return prog;
+}
+
+/* ---- expansion ---- */
+
+typedef struct {
+    struct HereDocs *docs;
+    int loop_depth;
+    int breaking;        /* enclosing loops still to leave (break N) */
+    int continuing;      /* loops to unwind before continuing (continue N) */
+} Interp;
+
+/* Growing text with a small inline buffer: most words never allocate */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    char local[256];
+} Text;
+
+static void text_init(Text *t) {
+    t->data = t->local;
+    t->len = 0;
+    t->cap = sizeof(t->local);
+}
+
+static int text_add(Text *t, const char *s, size_t n) {
+    if (t->len + n + 1 > t->cap) {
+        size_t cap = t->cap * 2;
+        while (t->len + n + 1 > cap) cap *= 2;
+        char *data = t->data == t->local ? malloc(cap) : realloc(t->data, cap);
+        if (data == NULL) return -1;
+        if (t->data == t->local) memcpy(data, t->local, t->len);
+        t->data = data;
+        t->cap = cap;
+    }
+    memcpy(t->data + t->len, s, n);
+    t->len += n;
+    t->data[t->len] = '\0';
+    return 0;
+}
+
+static void text_free(Text *t) {
+    if (t->data != t->local) free(t->data);
+}
+
+static int run_captured(void *line) {
+    return interp_run(line, NULL);
+}
+
+/* Value of one non-literal part, into out (appended) */
+static int expand_part(const WordPart *part, Text *out) {
+    char num[32];
+    switch (part->kind) {
+    case PART_LIT:
+        return text_add(out, part->text, strlen(part->text));
+    case PART_VAR: {
+        const char *value;
+        if (strcmp(part->text, "?") == 0) {
+            snprintf(num, sizeof(num), "%d", interp_last_status());
+            value = num;
+        } else if (strcmp(part->text, "$") == 0) {
+            snprintf(num, sizeof(num), "%d", (int)getpid());
+            value = num;
+        } else {
+            value = shell_var_get(part->text);
+        }
+        return value != NULL ? text_add(out, value, strlen(value)) : 0;
+    }
+    case PART_ARITH: {
+        int err = 0;
+        long long v = arith_eval(part->arith, &arith_env, &err);
+        if (err) fprintf(stderr, "arithmetic: division by zero in '%s'\n", part->text);
+        snprintf(num, sizeof(num), "%lld", v);
+        return text_add(out, num, strlen(num));
+    }
+    case PART_SUBST: {
+        OutputBuffer buf = { NULL, 0, 0 };
+        /* A failed capture simply contributes nothing */
+        last_status = capture_stdout(run_captured, part->text, &buf);
+        /* Trailing newlines of the output are dropped */
+        while (buf.len > 0 && buf.data[buf.len - 1] == '\n') buf.len--;
+        int rc = buf.len > 0 ? text_add(out, buf.data, buf.len) : 0;
+        output_buffer_free(&buf);
+        return rc;
+    }
+    }
+    return 0;
+}
+
+/* Expand a word into one string: assignment values and the like */
+static int expand_value(const Word *w, Text *out) {
+    for (int i = 0; i < w->nparts; i++) {
+        if (expand_part(&w->parts[i], out) != 0) return -1;
+    }
+    return 0;
+}
+
+/* Add one field to list, expanding wildcards unless it is literal-only */
+static int add_field(const char *field, size_t len, int literal, GlobCache **cache, ArgList *list) {
+    if (literal || !glob_has_magic(field)) return arglist_add(list, field, len);
+    if (*cache == NULL && (*cache = glob_cache_new()) == NULL) return -1;
+    return glob_expand_word(*cache, field, list) < 0 ? -1 : 0;
+}
+
+/* Expand a word into fields on list: unquoted variables and
+ * substitutions are split at blanks, then wildcards are expanded. A field
+ * with wildcard characters from quoted text is taken as it is. literal
+ * turns both off for redirection targets. */
+static int expand_word(const Word *w, int literal, GlobCache **cache, ArgList *list) {
+    if (w->nparts == 1 && w->parts[0].kind == PART_LIT) {
+        const WordPart *part = &w->parts[0];
+        return add_field(part->text, strlen(part->text), literal || part->quoted, cache, list);
+    }
+
+    Text field, value;
+    text_init(&field);
+    int have = 0, keep = 0, quoted_magic = 0, rc = 0;
+    for (int i = 0; i < w->nparts && rc == 0; i++) {
+        const WordPart *part = &w->parts[i];
+        if (literal || part->quoted || part->kind == PART_LIT || part->kind == PART_ARITH) {
+            size_t from = field.len;
+            rc = expand_part(part, &field);
+            if (part->quoted) {
+                /* "" and "$empty" still make a field */
+                keep = 1;
+                if (field.len > from && glob_has_magic(field.data + from)) quoted_magic = 1;
+            }
+            have = 1;
+            continue;
+        }
+        text_init(&value);
+        rc = expand_part(part, &value);
+        for (size_t k = 0; k < value.len && rc == 0; k++) {
+            char c = value.data[k];
+            if (c == ' ' || c == '\t' || c == '\n') {
+                if (have && (field.len > 0 || keep)) rc = add_field(field.data, field.len, quoted_magic, cache, list);
+                field.len = 0;
+                have = keep = quoted_magic = 0;
+            } else {
+                rc = text_add(&field, &c, 1);
+                have = 1;
+            }
+        }
+        text_free(&value);
+    }
+    if (rc == 0 && have && (field.len > 0 || literal || keep)) {
+        rc = add_field(field.data, field.len, literal || quoted_magic, cache, list);
+    }
+    text_free(&field);
+    return rc;
+}
+
+/* A simple command after expansion: its arguments and its redirections,
+ * whose targets live in their own list */
+typedef struct {
+    ArgList args;
+    ArgList targets;
+    Redirect *redirs;
+    int nredirs;
+} Expanded;
+
+static void expanded_init(Expanded *cmd) {
+    arglist_init(&cmd->args);
+    arglist_init(&cmd->targets);
+    cmd->redirs = NULL;
+    cmd->nredirs = 0;
+}
+
+static void expanded_free(Expanded *cmd) {
+    arglist_free(&cmd->args);
+    arglist_free(&cmd->targets);
+    free(cmd->redirs);
+    expanded_init(cmd);
+}
+
+/* Expand the words and redirection targets of a simple command */
+static int expand_command(const Node *n, GlobCache **cache, Expanded *cmd) {
+    ArgList *list = &cmd->args;
+    for (int i = 0; i < n->nwords; i++) {
+        if (expand_word(&n->words[i], 0, cache, list) != 0) {
+            fprintf(stderr, "Out of memory expanding arguments\n");
+            return -1;
+        }
+        /* Special handling for 'ls' command: inject --color=auto */
+        if (i == 0 && list->count == 1 && strcmp(list->arena, "ls") == 0) {
+            arglist_add(list, "--color=auto", strlen("--color=auto"));
+        }
+    }
+    if (n->nredirs > 0) {
+        /* A target is one field, never split or globbed; a here-document
+         * delimiter is not expanded at all */
+        int rc = (cmd->redirs = malloc((size_t)n->nredirs * sizeof(Redirect))) == NULL ? -1 : 0;
+        for (int i = 0; i < n->nredirs && rc == 0; i++) {
+            if (n->redirs[i].kind == REDIR_HEREDOC) rc = arglist_add(&cmd->targets, "", 0);
+            else rc = expand_word(&n->redirs[i].target, 1, cache, &cmd->targets);
+        }
+        if (rc != 0 || arglist_finish(&cmd->targets) == NULL) {
+            fprintf(stderr, "Out of memory expanding arguments\n");
+            return -1;
+        }
+        for (int i = 0; i < n->nredirs; i++) {
+            cmd->redirs[i].kind = n->redirs[i].kind;
+            cmd->redirs[i].target = cmd->targets.argv[i];
+        }
+        cmd->nredirs = n->nredirs;
+    }
+    return arglist_finish(list) ? 0 : -1;
+}
+
+/* ---- execution ---- */
+
+static int exec_node(Interp *I, const Node *n);
+
+/* NAME=value prefixes of a command: shell variables when there is no
+ * command, otherwise environment for the command (saved in old) */
+static int apply_assignments(const Node *n, int to_env, char **old) {
+    int rc = 0;
+    for (int i = 0; i < n->nassigns; i++) {
+        Text value;
+        text_init(&value);
+        if (expand_value(&n->assign_values[i], &value) != 0) {
+            rc = -1;
+        } else if (to_env) {
+            const char *prev = getenv(n->assign_names[i]);
+            if (old != NULL) old[i] = prev ? strdup(prev) : NULL;
+            setenv(n->assign_names[i], value.data ? value.data : "", 1);
+        } else if (shell_var_set(n->assign_names[i], value.len ? value.data : "", 0) != 0) {
+            rc = -1;
+        }
+        text_free(&value);
+    }
+    return rc;
+}
+
+static void restore_assignments(const Node *n, char **old) {
+    for (int i = 0; i < n->nassigns; i++) {
+        if (old[i] != NULL) setenv(n->assign_names[i], old[i], 1);
+        else unsetenv(n->assign_names[i]);
+        free(old[i]);
+    }
+}
+
+/* break [N] and continue [N] */
+static int exec_loop_control(Interp *I, char **argv) {
+    int levels = argv[1] != NULL ? atoi(argv[1]) : 1;
+    if (I->loop_depth == 0) {
+        fprintf(stderr, "%s: only meaningful in a loop\n", argv[0]);
+        return 1;
+    }
+    if (levels < 1) levels = 1;
+    if (levels > I->loop_depth) levels = I->loop_depth;
+    if (argv[0][0] == 'b') I->breaking = levels;
+    else I->continuing = levels;
+    return 0;
+}
+
+static int exec_simple(Interp *I, const Node *n) {
+    Expanded cmd;
+    GlobCache *cache = NULL;
+    expanded_init(&cmd);
+    int rc = expand_command(n, &cache, &cmd);
+    if (cache != NULL) glob_cache_free(cache);
+    if (rc != 0) {
+        expanded_free(&cmd);
+        return -1;
+    }
+
+    char **argv = cmd.args.argv;
+    int status;
+    if (cmd.args.count == 0) {
+        /* Assignments only; redirections are still opened, as in bash */
+        status = apply_assignments(n, 0, NULL) == 0 ? 0 : 1;
+        if (status == 0 && cmd.nredirs > 0) status = execute_argv(n->source, argv, cmd.redirs, cmd.nredirs, I->docs);
+    } else if (strcmp(argv[0], "break") == 0 || strcmp(argv[0], "continue") == 0) {
+        status = exec_loop_control(I, argv);
+    } else if (n->nassigns > 0) {
+        char **old = calloc((size_t)n->nassigns, sizeof(char *));
+        if (old == NULL) {
+            expanded_free(&cmd);
+            return -1;
+        }
+        apply_assignments(n, 1, old);
+        status = execute_argv(n->source, argv, cmd.redirs, cmd.nredirs, I->docs);
+        restore_assignments(n, old);
+        free(old);
+    } else {
+        status = execute_argv(n->source, argv, cmd.redirs, cmd.nredirs, I->docs);
+    }
+    expanded_free(&cmd);
+    return status;
+}
+
+/* PIPE_* prefixes of the pipeline being started, found before the shell
+ * variables while pipe_sched_load looks them up */
+static const char *pipe_prefix_names[PIPE_PREFIX_MAX];
+static const char *pipe_prefix_values[PIPE_PREFIX_MAX];
+static int pipe_prefix_count;
+
+static const char *pipe_prefix_get(const char *name) {
+    for (int i = pipe_prefix_count; i-- > 0;) {
+        if (strcmp(pipe_prefix_names[i], name) == 0) return pipe_prefix_values[i];
+    }
+    return shell_var_get(name);
+}
+
+/* Scheduling for a pipeline: PIPE_* prefixes on its first stage
+ * (PIPE_NICE=5 cmd | cmd) apply to it alone and override the variables */
+static int load_pipe_sched(PipeSched *sched, const Node *first) {
+    const char *names[PIPE_PREFIX_MAX];
+    Text values[PIPE_PREFIX_MAX];
+    int count = 0;
+    for (int i = 0; first->kind == NODE_SIMPLE && i < first->nassigns && count < PIPE_PREFIX_MAX; i++) {
+        if (strncmp(first->assign_names[i], "PIPE_", 5) != 0) continue;
+        text_init(&values[count]);
+        /* Add a terminator even for an empty value */
+        if (expand_value(&first->assign_values[i], &values[count]) != 0 || text_add(&values[count], "", 0) != 0) {
+            text_free(&values[count]);
+            continue;
+        }
+        names[count++] = first->assign_names[i];
+    }
+    /* Expanding a value may have run pipelines of its own: publish after */
+    for (int i = 0; i < count; i++) {
+        pipe_prefix_names[i] = names[i];
+        pipe_prefix_values[i] = values[i].data;
+    }
+    pipe_prefix_count = count;
+    int scheduled = pipe_sched_load(sched, pipe_prefix_get);
+    pipe_prefix_count = 0;
+    for (int i = 0; i < count; i++) text_free(&values[i]);
+    return scheduled;
+}
+
+static int exec_pipeline(Interp *I, const Node *n) {
+    int count = n->nkids;
+    Expanded *stages = calloc((size_t)count, sizeof(Expanded));
+    int *stage_in = malloc((size_t)count * sizeof(int));   /* here-document memfd per stage, or -1 */
+    pid_t *children = malloc((size_t)count * sizeof(pid_t));
+    if (stages == NULL || stage_in == NULL || children == NULL) {
+        perror("malloc");
+        free(stages);
+        free(stage_in);
+        free(children);
+        return -1;
+    }
+
+    /* Expand every simple stage up front so the stages share directory reads */
+    GlobCache *cache = NULL;
+    int ok = 1;
+    for (int pi = 0; pi < count; pi++) {
+        expanded_init(&stages[pi]);
+        stage_in[pi] = -1;
+        if (ok && n->kids[pi]->kind == NODE_SIMPLE) {
+            if (expand_command(n->kids[pi], &cache, &stages[pi]) != 0 ||
+                (stage_in[pi] = take_heredocs(stages[pi].redirs, stages[pi].nredirs, I->docs)) == -2) {
+                ok = 0;
+            }
+        }
+    }
+    if (cache != NULL) glob_cache_free(cache);
+
+    /* PIPE_BUFFER, PIPE_AFFINITY, PIPE_NICE, PIPE_IOPRIO */
+    PipeSched sched;
+    int scheduled = load_pipe_sched(&sched, n->kids[0]);
+
+    int prev_fd = -1, child_count = 0;
+    fflush(stdout);
+    fflush(stderr);
+    for (int pi = 0; ok && pi < count; pi++) {
+        int pipefd[2];
+        if (pi < count - 1 && pipe(pipefd) == -1) {
+            perror("pipe");
+            break;
+        }
+        if (scheduled && pi < count - 1) pipe_sched_pipe(&sched, pipefd[1]);
+
+        pid_t cpid = fork();
+        if (cpid < 0) {
+            perror("fork");
+            if (pi < count - 1) {
+                close(pipefd[0]);
+                close(pipefd[1]);
+            }
+            break;
+        }
+
+        if (cpid == 0) {
+            /* Child */
+            if (scheduled) pipe_sched_stage(&sched, pi);
+            if (prev_fd != -1) {
+                dup2(prev_fd, STDIN_FILENO);
+                close(prev_fd);
+            }
+            if (pi < count - 1) {
+                close(pipefd[0]);
+                dup2(pipefd[1], STDOUT_FILENO);
+                close(pipefd[1]);
+            }
+            const Node *stage = n->kids[pi];
+            if (stage->kind != NODE_SIMPLE) {
+                int st = exec_node(I, stage);
+                fflush(stdout);
+                _exit(st < 0 ? EXIT_FAILURE : st & 0xff);
+            }
+            /* A redirection replaces the pipe */
+            char **argv = stages[pi].args.argv;
+            apply_redirections(stages[pi].redirs, stages[pi].nredirs, stage_in[pi]);
+            apply_assignments(stage, argv[0] != NULL, NULL);
+            exec_in_child(argv);
+        }
+
+        /* Parent */
+        children[child_count++] = cpid;
+        if (prev_fd != -1) {
+            close(prev_fd);
+            prev_fd = -1;
+        }
+        if (pi < count - 1) {
+            close(pipefd[1]);
+            prev_fd = pipefd[0];
+        }
+    }
+
+    /* Wait for all children */
+    int status = 0;
+    for (int i = 0; i < child_count; i++) {
+        int st = 0;
+        waitpid(children[i], &st, 0);
+        if (WIFEXITED(st)) status = WEXITSTATUS(st);
+    }
+    if (prev_fd != -1) close(prev_fd);
+    if (child_count < count) status = -1;
+
+    for (int pi = 0; pi < count; pi++) {
+        expanded_free(&stages[pi]);
+        if (stage_in[pi] >= 0) close(stage_in[pi]);
+    }
+    free(stages);
+    free(stage_in);
+    free(children);
+    return status;
+}
+
+/* After a loop body: 1 to leave the loop */
+static int loop_should_stop(Interp *I) {
+    if (I->breaking > 0) {
+        I->breaking--;
+        return 1;
+    }
+    if (I->continuing > 0) {
+        /* continue N > 1 leaves this loop and continues an outer one */
+        return --I->continuing > 0;
+    }
+    return 0;
+}
+
+static int exec_for(Interp *I, const Node *n) {
+    ArgList list;
+    GlobCache *cache = NULL;
+    arglist_init(&list);
+    int rc = 0;
+    for (int i = 0; i < n->nwords && rc == 0; i++) rc = expand_word(&n->words[i], 0, &cache, &list);
+    if (cache != NULL) glob_cache_free(cache);
+    if (rc != 0 || arglist_finish(&list) == NULL) {
+        arglist_free(&list);
+        return -1;
+    }
+
+    int status = 0, doc_start = I->docs ? I->docs->next : 0;
+    I->loop_depth++;
+    for (int i = 0; i < list.count; i++) {
+        shell_var_set(n->name, list.argv[i], 0);
+        /* Here-documents in the body are read again on every pass */
+        if (I->docs) I->docs->next = doc_start;
+        status = exec_node(I, n->kids[0]);
+        if (loop_should_stop(I)) break;
+    }
+    I->loop_depth--;
+    arglist_free(&list);
+    return status;
+}
+
+static int exec_while(Interp *I, const Node *n) {
+    int status = 0, doc_start = I->docs ? I->docs->next : 0;
+    I->loop_depth++;
+    for (;;) {
+        if (I->docs) I->docs->next = doc_start;
+        int cond = exec_node(I, n->kids[0]);
+        if (I->breaking > 0 || I->continuing > 0) {
+            if (loop_should_stop(I)) break;
+            continue;
+        }
+        if ((cond == 0) != (n->kind == NODE_WHILE)) break;
+        status = exec_node(I, n->kids[1]);
+        if (loop_should_stop(I)) break;
+    }
+    I->loop_depth--;
+    return status;
+}
+
+static int exec_if(Interp *I, const Node *n) {
+    int i = 0;
+    for (; i + 1 < n->nkids; i += 2) {
+        int cond = exec_node(I, n->kids[i]);
+        if (I->breaking > 0 || I->continuing > 0) return cond;
+        if (cond == 0) return exec_node(I, n->kids[i + 1]);
+    }
+    /* else branch */
+    return i < n->nkids ? exec_node(I, n->kids[i]) : 0;
+}
+
+static int exec_node(Interp *I, const Node *n) {
+    int status = 0;
+    switch (n->kind) {
+    case NODE_SEQ:
+        for (int i = 0; i < n->nkids; i++) {
+            status = exec_node(I, n->kids[i]);
+            if (I->breaking > 0 || I->continuing > 0) break;
+        }
+        break;
+    case NODE_AND:
+    case NODE_OR:
+        status = exec_node(I, n->kids[0]);
+        if (I->breaking > 0 || I->continuing > 0) break;
+        if ((status == 0) == (n->kind == NODE_AND)) status = exec_node(I, n->kids[1]);
+        break;
+    case NODE_SIMPLE:
+        status = exec_simple(I, n);
+        break;
+    case NODE_PIPELINE:
+        status = exec_pipeline(I, n);
+        break;
+    case NODE_FOR:
+        status = exec_for(I, n);
+        break;
+    case NODE_WHILE:
+    case NODE_UNTIL:
+        status = exec_while(I, n);
+        break;
+    case NODE_IF:
+        status = exec_if(I, n);
+        break;
+    case NODE_ARITH: {
+        int err = 0;
+        long long v = arith_eval(n->arith, &arith_env, &err);
+        if (err) fprintf(stderr, "arithmetic: division by zero\n");
+        status = err || v == 0 ? 1 : 0;
+        break;
+    }
+    }
+    last_status = status;
+    return status;
+}
+
+int interp_run(const char *line, struct HereDocs *docs) {
+    Program *prog = program_get(line);
+    if (prog == NULL) {
+        last_status = 2;
+        return -1;
+    }
+
+    Interp I = { docs, 0, 0, 0 };
+    /* A loop is one history entry, not one per command it runs */
+    if (prog->compound) {
+        add_command_to_history(line);
+        history_mute(1);
+    }
+    int status = exec_node(&I, prog->root);
+    if (prog->compound) history_mute(0);
+    program_put(prog);
+    return status;
+}
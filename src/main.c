@@ -4,8 +4,14 @@
 #include <unistd.h>
 #include <pwd.h>
 #include <limits.h>
+#include <time.h>
 #include <sys/types.h>
 #include "executor.h"
+#include "server.h"
+#include "utils/line_editor.h"
+#include "utils/heredoc.h"
+#include "utils/session_log.h"
+#include "utils/json_records.h"
 
 #define BUFFER_SIZE 1024
 
@@ -16,44 +22,193 @@ void initialize_terminal() {
     printf("Type 'exit' to quit the application.\n");
 }
 
-// Function to print a colored prompt with username@hostname:cwd$
-static void print_prompt() {
-    char host[256];
+// Startup tracing (--startup-trace): time since main() for each init phase
+static struct timespec start_time;
+static int startup_trace = 0;
+
+static void trace_phase(const char *phase) {
+    if (!startup_trace) return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double ms = (now.tv_sec - start_time.tv_sec) * 1e3 + (now.tv_nsec - start_time.tv_nsec) / 1e6;
+    fprintf(stderr, "startup: %8.3f ms  %s\n", ms, phase);
+}
+
+// Function to build a colored prompt with username@hostname:cwd$. The user
+// and host names are looked up once; $USER avoids an NSS passwd lookup.
+static void build_prompt(char *prompt, size_t size) {
+    static char user[256], host[256];
     char cwd[1024];
-    const char *user = NULL;
-    struct passwd *pw = getpwuid(getuid());
-    if (pw) user = pw->pw_name; else user = "user";
-    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "host");
+    if (user[0] == '\0') {
+        const char *name = getenv("USER");
+        if (name == NULL || name[0] == '\0') {
+            struct passwd *pw = getpwuid(getuid());
+            name = pw ? pw->pw_name : "user";
+        }
+        snprintf(user, sizeof(user), "%s", name);
+        if (gethostname(host, sizeof(host)) != 0) strcpy(host, "host");
+    }
     if (getcwd(cwd, sizeof(cwd)) == NULL) strcpy(cwd, "~");
 
     /* colored: user@host in green, cwd in blue */
-    printf("\033[1;32m%s@%s\033[0m:\033[1;34m%s\033[0m$ ", user, host, cwd);
-    fflush(stdout);
+    snprintf(prompt, size, "\033[1;32m%s@%s\033[0m:\033[1;34m%s\033[0m$ ", user, host, cwd);
+}
+
+// Function to read user input from the terminal (line editor with Tab
+// completion on a tty, plain fgets otherwise). Returns -1 on EOF.
+int read_user_input(char *buffer) {
+    static int first = 1;
+    char prompt[1600] = "";
+    // --json sessions are driven by programs: no prompt on stdout
+    if (!json_records_enabled()) build_prompt(prompt, sizeof(prompt));
+    if (first) {
+        trace_phase("first prompt");
+        first = 0;
+    }
+    return line_edit(prompt, buffer, BUFFER_SIZE);
 }
 
-// Function to read user input from the terminal
-void read_user_input(char *buffer) {
-    print_prompt();
-    if (fgets(buffer, BUFFER_SIZE, stdin) == NULL) {
-        /* EOF or error */
-        buffer[0] = '\0';
-        return;
+// Function to read the lines of the here-documents a command line opens
+// (each with a "> " prompt) and join them after it. Returns a malloc'd
+// string for execute_command, or NULL when the line has no here-document.
+static char *read_heredocs(const char *line) {
+    HereDocSpec specs[HEREDOC_MAX];
+    int count = heredoc_scan(line, specs, HEREDOC_MAX);
+    if (count == 0) return NULL;
+
+    size_t len = strlen(line), cap = len + BUFFER_SIZE;
+    char *text = malloc(cap);
+    if (text == NULL) return NULL;
+    memcpy(text, line, len);
+
+    char body[BUFFER_SIZE];
+    for (int i = 0; i < count; i++) {
+        for (;;) {
+            if (line_edit("> ", body, sizeof(body)) < 0) break; // EOF ends the document
+            size_t blen = strlen(body);
+            if (len + blen + 2 > cap) {
+                cap = (len + blen + 2) * 2;
+                char *grown = realloc(text, cap);
+                if (grown == NULL) {
+                    free(text);
+                    return NULL;
+                }
+                text = grown;
+            }
+            text[len++] = '\n';
+            memcpy(text + len, body, blen);
+            len += blen;
+
+            const char *b = body;
+            if (specs[i].strip_tabs) while (*b == '\t') b++;
+            if (strcmp(b, specs[i].delim) == 0) break;
+        }
     }
-    buffer[strcspn(buffer, "\n")] = 0; // Remove the newline character
+    text[len] = '\0';
+    return text;
+}
+
+// Function to run a recorded session (--record) through execute_command in
+// batch mode, as fast as possible. Prints the time taken to stderr.
+static int replay_session(const char *path) {
+    SessionLog *log = session_replay_open(path);
+    if (log == NULL) return 1;
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    const char *command;
+    unsigned long long delay_us, recorded_us = 0;
+    int count = 0, rc;
+    while ((rc = session_replay_next(log, &command, &delay_us)) > 0) {
+        recorded_us += delay_us;
+        json_records_begin(command);
+        json_records_end(execute_command(command));
+        count++;
+    }
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    session_log_close(log);
+    if (rc < 0) fprintf(stderr, "replay: %s is truncated or corrupt\n", path);
+
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    fprintf(stderr, "replay: %d commands in %.3f s (recorded session: %.1f s)\n",
+            count, elapsed, recorded_us / 1e6);
+    return rc < 0 ? 1 : 0;
 }
 
 // Main function - entry point of the application
-int main() {
+int main(int argc, char **argv) {
     char input[BUFFER_SIZE]; // Buffer to hold user input
+    SessionLog *recording = NULL;
+
+    clock_gettime(CLOCK_MONOTONIC, &start_time);
+    if (argc > 1 && strcmp(argv[1], "--startup-trace") == 0) {
+        startup_trace = 1;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+    trace_phase("main");
+
+    // Structured results for automation: --json (records on fd 3) or --json=FD
+    if (argc > 1 && strncmp(argv[1], "--json", 6) == 0 && (argv[1][6] == '\0' || argv[1][6] == '=')) {
+        int fd = argv[1][6] == '=' ? atoi(argv[1] + 7) : 3;
+        if (json_records_open(fd) != 0) return 1;
+        argv[1] = argv[0];
+        argv++;
+        argc--;
+    }
+
+    // One command and exit, without banner or prompt: terminal_app -c LINE
+    if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s -c <command>\n", argv[0]);
+            return 1;
+        }
+        history_mute(1);     // like sh -c: no history for one-off commands
+        json_records_begin(argv[2]);
+        int status = execute_command(argv[2]);
+        json_records_end(status);
+        fflush(stdout);
+        trace_phase("command done");
+        return status < 0 ? 1 : status & 0xff;
+    }
+
+    // Daemon mode for automation: terminal_app --serve SOCKET
+    if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s --serve <socket>\n", argv[0]);
+            return 1;
+        }
+        return serve_main(argv[2]);
+    }
 
-    initialize_terminal(); // Initialize the terminal
+    // Batch replay of a recorded session: terminal_app --replay FILE
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s --replay <file>\n", argv[0]);
+            return 1;
+        }
+        return replay_session(argv[2]);
+    }
+
+    // Record the session's command lines and timing: terminal_app --record FILE
+    if (argc > 1 && strcmp(argv[1], "--record") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Usage: %s --record <file>\n", argv[0]);
+            return 1;
+        }
+        recording = session_record_open(argv[2]);
+        if (recording == NULL) return 1;
+    }
+
+    if (!json_records_enabled()) initialize_terminal(); // Initialize the terminal
+    trace_phase("banner");
 
     while (1) {
-        read_user_input(input); // Read user input
+        if (read_user_input(input) < 0) break; // Read user input; stop on EOF
 
         if (strlen(input) == 0) {
-            /* Empty input or EOF: continue or exit on EOF */
-            if (feof(stdin)) break;
             continue;
         }
 
@@ -62,10 +217,20 @@ int main() {
             break; // Exit the loop if user types 'exit'
         }
 
-        // Execute the command entered by the user
-        execute_command(input); // Call the command executor
+        // Execute the command entered by the user (with its here-documents)
+        char *full = read_heredocs(input);
+        if (recording != NULL && session_record(recording, full ? full : input) != 0) {
+            perror("record");
+        }
+        json_records_begin(full ? full : input);
+        int status = execute_command(full ? full : input); // Call the command executor
+        json_records_end(status);
+        free(full);
+        trace_phase("command done");
+        startup_trace = 0;
     }
+    session_log_close(recording);
 
-    printf("Exiting the terminal application. Goodbye!\n");
+    if (!json_records_enabled()) printf("Exiting the terminal application. Goodbye!\n");
     return 0; // Return success
 }
\ No newline at end of file
@@ -0,0 +1,942 @@
+// parser.c
+// Tokenizer and recursive-descent parser for command lines (grammar in
+// parser.h), and the compiler for arithmetic expressions. Nothing here
+// runs anything: the interpreter walks the trees this file builds.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "parser.h"
+
+typedef enum {
+    TOK_WORD, TOK_SEMI, TOK_AND, TOK_OR, TOK_PIPE, TOK_ARITH, TOK_EOF, TOK_ERROR
+} TokKind;
+
+typedef struct {
+    TokKind kind;
+    const char *start;
+    size_t len;
+    const char *error;   /* TOK_ERROR: what is wrong with it */
+} Token;
+
+typedef struct {
+    const char *p;
+    Token tok;
+    int have;            /* tok holds an unconsumed token */
+    int failed;
+} Parser;
+
+/* ---- tokens ---- */
+
+static const char *quote_end(const char *p);
+
+/* End of the $(...), $((...)) or `...` starting at p (one past its closing
+ * character), or NULL when it is never closed */
+static const char *substitution_end(const char *p) {
+    if (*p == '`') {
+        const char *end = strchr(p + 1, '`');
+        return end ? end + 1 : NULL;
+    }
+    int depth = 0;
+    for (const char *q = p + 1; *q != '\0'; q++) {
+        if (*q == '(') {
+            depth++;
+        } else if (*q == ')') {
+            if (--depth == 0) return q + 1;
+        } else if (*q == '`') {
+            q = substitution_end(q);
+            if (q == NULL) return NULL;
+            q--;
+        } else if (*q == '\'' || *q == '"') {
+            q = quote_end(q);
+            if (q == NULL) return NULL;
+            q--;
+        }
+    }
+    return NULL;
+}
+
+/* End of the '...' or "..." starting at p (one past the closing quote), or
+ * NULL when it is never closed. Inside "..." a backslash escapes the next
+ * character and substitutions may hold quotes of their own. */
+static const char *quote_end(const char *p) {
+    if (*p == '\'') {
+        const char *end = strchr(p + 1, '\'');
+        return end ? end + 1 : NULL;
+    }
+    for (const char *q = p + 1; *q != '\0'; q++) {
+        if (*q == '"') return q + 1;
+        if (*q == '\\' && q[1] != '\0') {
+            q++;
+        } else if (*q == '`' || (q[0] == '$' && q[1] == '(')) {
+            q = substitution_end(q);
+            if (q == NULL) return NULL;
+            q--;
+        }
+    }
+    return NULL;
+}
+
+static int ends_word(const char *p) {
+    return *p == '\0' || *p == ' ' || *p == '\t' || *p == '\n' || *p == ';' ||
+           *p == '|' || (p[0] == '&' && p[1] == '&');
+}
+
+static void syntax_error(Parser *P, const char *what, const Token *near) {
+    if (P->failed) return;
+    P->failed = 1;
+    if (near != NULL && near->kind == TOK_ERROR) what = near->error;
+    if (near != NULL && near->kind != TOK_EOF) {
+        fprintf(stderr, "syntax error: %s near '%.*s'\n", what, (int)near->len, near->start);
+    } else {
+        fprintf(stderr, "syntax error: %s at end of line\n", what);
+    }
+}
+
+static Token *peek(Parser *P) {
+    if (P->have) return &P->tok;
+    const char *p = P->p;
+    while (*p == ' ' || *p == '\t') p++;
+
+    Token *t = &P->tok;
+    t->start = p;
+    t->len = 1;
+    if (*p == '\0') {
+        t->kind = TOK_EOF;
+        t->len = 0;
+    } else if (*p == ';' || *p == '\n') {
+        t->kind = TOK_SEMI;
+    } else if (p[0] == '&' && p[1] == '&') {
+        t->kind = TOK_AND;
+        t->len = 2;
+    } else if (p[0] == '|' && p[1] == '|') {
+        t->kind = TOK_OR;
+        t->len = 2;
+    } else if (*p == '|') {
+        t->kind = TOK_PIPE;
+    } else if (p[0] == '(' && p[1] == '(') {
+        /* (( expr )): the second '(' has to close right before the last ')',
+         * otherwise ((a)<(b)) would be read as the expression "a)<(b" */
+        int depth = 0;
+        const char *q = p, *inner = NULL;
+        for (; *q != '\0'; q++) {
+            if (*q == '(') {
+                depth++;
+            } else if (*q == ')') {
+                if (--depth == 1 && inner == NULL) inner = q;
+                if (depth == 0) break;
+            }
+        }
+        t->kind = TOK_ARITH;
+        if (*q == '\0') {
+            t->kind = TOK_ERROR;
+            t->error = "unterminated '(('";
+            q = p + strlen(p) - 1;
+        } else if (inner != q - 1) {
+            t->kind = TOK_ERROR;
+            t->error = "'((' not closed by '))' (subshells are not supported)";
+        }
+        t->len = (size_t)(q + 1 - p);
+    } else {
+        const char *q = p;
+        t->kind = TOK_WORD;
+        while (!ends_word(q)) {
+            const char *end = NULL;
+            if (*q == '\'' || *q == '"') {
+                if ((end = quote_end(q)) == NULL) {
+                    t->kind = TOK_ERROR;
+                    t->error = "unterminated quote";
+                    q += strlen(q);
+                    break;
+                }
+            } else if (*q == '\\' && q[1] != '\0') {
+                end = q + 2;
+            } else if (*q == '`' || (q[0] == '$' && q[1] == '(')) {
+                end = substitution_end(q);
+            } else if (q[0] == '$' && q[1] == '{') {
+                end = strchr(q, '}');
+                if (end != NULL) end++;
+            }
+            q = end ? end : q + 1;
+        }
+        t->len = (size_t)(q - p);
+    }
+    P->p = p + t->len;
+    P->have = 1;
+    return t;
+}
+
+static void consume(Parser *P) {
+    P->have = 0;
+}
+
+static int is_word(Parser *P, const char *text) {
+    Token *t = peek(P);
+    return t->kind == TOK_WORD && t->len == strlen(text) && strncmp(t->start, text, t->len) == 0;
+}
+
+static int expect_word(Parser *P, const char *text) {
+    if (is_word(P, text)) {
+        consume(P);
+        return 1;
+    }
+    char what[32];
+    snprintf(what, sizeof(what), "expected '%s'", text);
+    syntax_error(P, what, peek(P));
+    return 0;
+}
+
+static void skip_semis(Parser *P) {
+    while (peek(P)->kind == TOK_SEMI) consume(P);
+}
+
+/* ---- words ---- */
+
+static int add_part(Word *w, PartKind kind, const char *text, size_t len, int quoted) {
+    WordPart *parts = realloc(w->parts, (size_t)(w->nparts + 1) * sizeof(WordPart));
+    if (parts == NULL) return -1;
+    w->parts = parts;
+    WordPart *part = &parts[w->nparts++];
+    part->kind = kind;
+    part->quoted = quoted;
+    part->text = strndup(text, len);
+    part->arith = NULL;
+    if (part->text == NULL) return -1;
+    if (kind == PART_ARITH && (part->arith = arith_parse(part->text)) == NULL) return -1;
+    return 0;
+}
+
+static int is_name_start(char c) {
+    return isalpha((unsigned char)c) || c == '_';
+}
+
+static int is_name_char(char c) {
+    return isalnum((unsigned char)c) || c == '_';
+}
+
+/* Split the word s[0..len) into parts; 0 on success. Quotes are removed:
+ * inside '...' nothing expands, inside "..." only $ and ` do, and a
+ * backslash outside '...' takes the next character literally. Text from
+ * quotes or escapes is marked quoted: it is not split or globbed. */
+static int compile_word(const char *s, size_t len, Word *w) {
+    memset(w, 0, sizeof(*w));
+    w->raw = strndup(s, len);
+    char *lit = malloc(len + 1);
+    if (w->raw == NULL || lit == NULL) {
+        free(lit);
+        return -1;
+    }
+
+    size_t i = 0, lit_len = 0;
+    int lit_quoted = 0, had_quotes = 0, rc = 0;
+    char quote = '\0';
+    while (i < len && rc == 0) {
+        const char *p = s + i;
+        char c = *p;
+        int quoted = quote != '\0';
+        size_t skip = 0;
+        PartKind kind = PART_LIT;
+        const char *text = NULL;
+        size_t text_len = 0;
+
+        if ((quote == '\0' && (c == '\'' || c == '"')) || c == quote) {
+            quote = quote == '\0' ? c : '\0';
+            had_quotes = 1;
+            i++;
+            continue;
+        }
+        if (quote == '\'') {
+            /* literal */
+        } else if (c == '\\' && i + 1 < len && (quote == '\0' || strchr("$`\"\\", p[1]) != NULL)) {
+            c = p[1];
+            quoted = 1;
+            i++;
+        } else if (p[0] == '$' && p[1] == '(' && p[2] == '(') {
+            const char *end = substitution_end(p);
+            if (end != NULL && end - p >= 5 && end[-2] == ')') {
+                kind = PART_ARITH;
+                text = p + 3;
+                text_len = (size_t)(end - p) - 5;
+                skip = (size_t)(end - p);
+            }
+        }
+        if (skip == 0 && quote != '\'' && p[0] != '\\' && ((p[0] == '$' && p[1] == '(') || p[0] == '`')) {
+            const char *end = substitution_end(p);
+            if (end != NULL) {
+                size_t open = p[0] == '`' ? 1 : 2;
+                kind = PART_SUBST;
+                text = p + open;
+                text_len = (size_t)(end - p) - open - 1;
+                skip = (size_t)(end - p);
+            }
+        } else if (skip == 0 && quote != '\'' && p[0] == '$' && p[1] == '{') {
+            const char *end = memchr(p, '}', len - i);
+            if (end != NULL) {
+                kind = PART_VAR;
+                text = p + 2;
+                text_len = (size_t)(end - p) - 2;
+                skip = text_len + 3;
+            }
+        } else if (skip == 0 && quote != '\'' && p[0] == '$' && is_name_start(p[1])) {
+            size_t n = 1;
+            while (i + n < len && is_name_char(p[n])) n++;
+            kind = PART_VAR;
+            text = p + 1;
+            text_len = n - 1;
+            skip = n;
+        } else if (skip == 0 && quote != '\'' && p[0] == '$' && (p[1] == '?' || p[1] == '$')) {
+            kind = PART_VAR;
+            text = p + 1;
+            text_len = 1;
+            skip = 2;
+        }
+
+        if (skip == 0) {
+            /* Literal text: a new part where quoting changes */
+            if (lit_len > 0 && lit_quoted != quoted) {
+                rc = add_part(w, PART_LIT, lit, lit_len, lit_quoted);
+                lit_len = 0;
+            }
+            lit[lit_len++] = c;
+            lit_quoted = quoted;
+            i++;
+            continue;
+        }
+        if (lit_len > 0 && add_part(w, PART_LIT, lit, lit_len, lit_quoted) != 0) rc = -1;
+        lit_len = 0;
+        if (rc == 0) rc = add_part(w, kind, text, text_len, quoted);
+        i += skip;
+    }
+    if (rc == 0 && lit_len > 0) rc = add_part(w, PART_LIT, lit, lit_len, lit_quoted);
+    /* '' and "" are an empty word, not no word */
+    if (rc == 0 && had_quotes && w->nparts == 0) rc = add_part(w, PART_LIT, "", 0, 1);
+    free(lit);
+    return rc;
+}
+
+static void word_free(Word *w) {
+    for (int i = 0; i < w->nparts; i++) {
+        free(w->parts[i].text);
+        arith_free(w->parts[i].arith);
+    }
+    free(w->parts);
+    free(w->raw);
+}
+
+/* ---- nodes ---- */
+
+static Node *node_new(NodeKind kind) {
+    Node *n = calloc(1, sizeof(Node));
+    if (n != NULL) n->kind = kind;
+    return n;
+}
+
+static int add_kid(Node *n, Node *kid) {
+    Node **kids = realloc(n->kids, (size_t)(n->nkids + 1) * sizeof(Node *));
+    if (kids == NULL) return -1;
+    n->kids = kids;
+    n->kids[n->nkids++] = kid;
+    return 0;
+}
+
+static int add_word(Word **words, int *count, const Token *t) {
+    Word *grown = realloc(*words, (size_t)(*count + 1) * sizeof(Word));
+    if (grown == NULL) return -1;
+    *words = grown;
+    if (compile_word(t->start, t->len, &grown[*count]) != 0) {
+        word_free(&grown[*count]);
+        return -1;
+    }
+    (*count)++;
+    return 0;
+}
+
+void node_free(Node *node) {
+    if (node == NULL) return;
+    for (int i = 0; i < node->nkids; i++) node_free(node->kids[i]);
+    free(node->kids);
+    for (int i = 0; i < node->nwords; i++) word_free(&node->words[i]);
+    free(node->words);
+    for (int i = 0; i < node->nassigns; i++) {
+        free(node->assign_names[i]);
+        word_free(&node->assign_values[i]);
+    }
+    free(node->assign_names);
+    free(node->assign_values);
+    for (int i = 0; i < node->nredirs; i++) word_free(&node->redirs[i].target);
+    free(node->redirs);
+    free(node->name);
+    arith_free(node->arith);
+    free(node->source);
+    free(node);
+}
+
+static Node *parse_list(Parser *P, const char *const *stops);
+static Node *parse_and_or(Parser *P);
+
+static int is_stop(Parser *P, const char *const *stops) {
+    for (int i = 0; stops != NULL && stops[i] != NULL; i++) {
+        if (is_word(P, stops[i])) return 1;
+    }
+    return 0;
+}
+
+/* NAME=... */
+static int assignment_length(const Token *t) {
+    if (!is_name_start(t->start[0])) return 0;
+    size_t n = 1;
+    while (n < t->len && is_name_char(t->start[n])) n++;
+    return n < t->len && t->start[n] == '=' ? (int)n : 0;
+}
+
+/* An unquoted redirection operator at the start of t: its length, with
+ * the kind in *kind, or 0. The target may be attached (<<EOF, <<<$x). */
+static size_t redirect_length(const Token *t, RedirKind *kind) {
+    const char *s = t->start;
+    if (t->len == 1 && (s[0] == '<' || s[0] == '>')) {
+        *kind = s[0] == '<' ? REDIR_IN : REDIR_OUT;
+        return 1;
+    }
+    if (t->len < 2 || s[0] != '<' || s[1] != '<') return 0;
+    if (t->len > 2 && s[2] == '<') {
+        *kind = REDIR_HERESTRING;
+        return 3;
+    }
+    *kind = REDIR_HEREDOC;
+    return t->len > 2 && s[2] == '-' ? 3 : 2;
+}
+
+/* The redirection in t (and, when its target is not attached, the next
+ * word); 0 on success */
+static int parse_redirect(Parser *P, Node *n, RedirKind kind, size_t op_len) {
+    Token *t = &P->tok;
+    const char *target = t->start + op_len;
+    size_t target_len = t->len - op_len;
+    if (target_len == 0) {
+        char op[4];
+        snprintf(op, sizeof(op), "%.*s", (int)op_len, t->start);
+        consume(P);
+        t = peek(P);
+        if (t->kind != TOK_WORD) {
+            char what[48];
+            snprintf(what, sizeof(what), "expected a word after '%s'", op);
+            syntax_error(P, what, t);
+            return -1;
+        }
+        target = t->start;
+        target_len = t->len;
+    }
+    Redir *grown = realloc(n->redirs, (size_t)(n->nredirs + 1) * sizeof(Redir));
+    if (grown == NULL) return -1;
+    n->redirs = grown;
+    grown[n->nredirs].kind = kind;
+    if (compile_word(target, target_len, &grown[n->nredirs].target) != 0) {
+        word_free(&grown[n->nredirs].target);
+        return -1;
+    }
+    n->nredirs++;
+    return 0;
+}
+
+static Node *parse_simple(Parser *P) {
+    Node *n = node_new(NODE_SIMPLE);
+    if (n == NULL) return NULL;
+    const char *start = peek(P)->start, *end = start;
+
+    while (peek(P)->kind == TOK_WORD) {
+        Token *t = &P->tok;
+        int name_len = n->nwords == 0 ? assignment_length(t) : 0;
+        RedirKind kind;
+        size_t op_len = redirect_length(t, &kind);
+        if (op_len > 0) {
+            if (parse_redirect(P, n, kind, op_len) != 0) {
+                P->failed = 1;
+                break;
+            }
+        } else if (name_len > 0) {
+            char **names = realloc(n->assign_names, (size_t)(n->nassigns + 1) * sizeof(char *));
+            if (names == NULL) break;
+            n->assign_names = names;
+            Word *values = realloc(n->assign_values, (size_t)(n->nassigns + 1) * sizeof(Word));
+            if (values == NULL) break;
+            n->assign_values = values;
+            names[n->nassigns] = strndup(t->start, (size_t)name_len);
+            if (compile_word(t->start + name_len + 1, t->len - (size_t)name_len - 1,
+                             &values[n->nassigns]) != 0) {
+                n->nassigns++;
+                P->failed = 1;
+                break;
+            }
+            n->nassigns++;
+        } else if (add_word(&n->words, &n->nwords, t) != 0) {
+            P->failed = 1;
+            break;
+        }
+        end = t->start + t->len;
+        consume(P);
+    }
+    if (!P->failed && n->nwords == 0 && n->nassigns == 0 && n->nredirs == 0) syntax_error(P, "missing command", peek(P));
+    n->source = strndup(start, (size_t)(end - start));
+    if (P->failed) {
+        node_free(n);
+        return NULL;
+    }
+    return n;
+}
+
+static Node *parse_for(Parser *P) {
+    consume(P);          /* for */
+    Token *t = peek(P);
+    Node *n = node_new(NODE_FOR);
+    if (n == NULL) return NULL;
+    if (t->kind != TOK_WORD || !is_name_start(t->start[0])) {
+        syntax_error(P, "expected a variable name after 'for'", t);
+        node_free(n);
+        return NULL;
+    }
+    n->name = strndup(t->start, t->len);
+    consume(P);
+    if (!expect_word(P, "in")) {
+        node_free(n);
+        return NULL;
+    }
+    while (peek(P)->kind == TOK_WORD) {
+        if (add_word(&n->words, &n->nwords, &P->tok) != 0) P->failed = 1;
+        consume(P);
+    }
+    skip_semis(P);
+
+    static const char *const done[] = { "done", NULL };
+    Node *body = NULL;
+    if (!P->failed && expect_word(P, "do") && (body = parse_list(P, done)) != NULL) {
+        add_kid(n, body);
+        if (expect_word(P, "done")) return n;
+    }
+    node_free(n);
+    return NULL;
+}
+
+static Node *parse_while(Parser *P, NodeKind kind) {
+    static const char *const do_[] = { "do", NULL };
+    static const char *const done[] = { "done", NULL };
+    consume(P);          /* while / until */
+    Node *n = node_new(kind);
+    if (n == NULL) return NULL;
+    Node *cond = parse_list(P, do_);
+    if (cond != NULL) {
+        add_kid(n, cond);
+        Node *body = NULL;
+        if (expect_word(P, "do") && (body = parse_list(P, done)) != NULL) {
+            add_kid(n, body);
+            if (expect_word(P, "done")) return n;
+        }
+    }
+    node_free(n);
+    return NULL;
+}
+
+static Node *parse_if(Parser *P) {
+    static const char *const then[] = { "then", NULL };
+    static const char *const branch_end[] = { "elif", "else", "fi", NULL };
+    static const char *const fi[] = { "fi", NULL };
+    consume(P);          /* if */
+    Node *n = node_new(NODE_IF);
+    if (n == NULL) return NULL;
+
+    for (;;) {
+        Node *cond = parse_list(P, then);
+        if (cond == NULL) break;
+        add_kid(n, cond);
+        if (!expect_word(P, "then")) break;
+        Node *body = parse_list(P, branch_end);
+        if (body == NULL) break;
+        add_kid(n, body);
+
+        if (is_word(P, "elif")) {
+            consume(P);
+            continue;
+        }
+        if (is_word(P, "else")) {
+            consume(P);
+            Node *other = parse_list(P, fi);
+            if (other == NULL) break;
+            add_kid(n, other);
+        }
+        if (expect_word(P, "fi")) return n;
+        break;
+    }
+    node_free(n);
+    return NULL;
+}
+
+static Node *parse_command(Parser *P) {
+    Token *t = peek(P);
+    if (t->kind == TOK_ARITH) {
+        Node *n = node_new(NODE_ARITH);
+        char *expr = strndup(t->start + 2, t->len - 4);
+        consume(P);
+        if (n != NULL && expr != NULL) n->arith = arith_parse(expr);
+        free(expr);
+        if (n == NULL || n->arith == NULL) {
+            P->failed = 1;
+            node_free(n);
+            return NULL;
+        }
+        return n;
+    }
+    if (t->kind == TOK_ERROR) {
+        syntax_error(P, t->error, t);
+        return NULL;
+    }
+    if (is_word(P, "for")) return parse_for(P);
+    if (is_word(P, "while")) return parse_while(P, NODE_WHILE);
+    if (is_word(P, "until")) return parse_while(P, NODE_UNTIL);
+    if (is_word(P, "if")) return parse_if(P);
+    return parse_simple(P);
+}
+
+static Node *parse_pipeline(Parser *P) {
+    Node *first = parse_command(P);
+    if (first == NULL || peek(P)->kind != TOK_PIPE) return first;
+
+    Node *n = node_new(NODE_PIPELINE);
+    if (n == NULL || add_kid(n, first) != 0) {
+        node_free(first);
+        node_free(n);
+        return NULL;
+    }
+    while (peek(P)->kind == TOK_PIPE) {
+        consume(P);
+        Node *next = parse_command(P);
+        if (next == NULL || add_kid(n, next) != 0) {
+            node_free(next);
+            node_free(n);
+            return NULL;
+        }
+    }
+    return n;
+}
+
+static Node *parse_and_or(Parser *P) {
+    Node *left = parse_pipeline(P);
+    while (left != NULL && (peek(P)->kind == TOK_AND || peek(P)->kind == TOK_OR)) {
+        Node *n = node_new(P->tok.kind == TOK_AND ? NODE_AND : NODE_OR);
+        consume(P);
+        Node *right = parse_pipeline(P);
+        if (n == NULL || right == NULL) {
+            node_free(n);
+            node_free(left);
+            node_free(right);
+            return NULL;
+        }
+        add_kid(n, left);
+        add_kid(n, right);
+        left = n;
+    }
+    return left;
+}
+
+/* Commands up to end of line or one of the stop keywords (not consumed) */
+static Node *parse_list(Parser *P, const char *const *stops) {
+    Node *seq = node_new(NODE_SEQ);
+    if (seq == NULL) return NULL;
+    for (;;) {
+        skip_semis(P);
+        Token *t = peek(P);
+        if (t->kind == TOK_EOF || is_stop(P, stops)) break;
+        if (t->kind != TOK_WORD && t->kind != TOK_ARITH && t->kind != TOK_ERROR) {
+            syntax_error(P, "unexpected operator", t);
+            break;
+        }
+        Node *n = parse_and_or(P);
+        if (n == NULL || add_kid(seq, n) != 0) {
+            node_free(n);
+            P->failed = 1;
+            break;
+        }
+        t = peek(P);
+        if (t->kind != TOK_SEMI && t->kind != TOK_EOF && !is_stop(P, stops)) {
+            syntax_error(P, "unexpected text", t);
+            break;
+        }
+    }
+    if (P->failed) {
+        node_free(seq);
+        return NULL;
+    }
+    return seq;
+}
+
+Node *parse_line(const char *line) {
+    Parser P = { line, { TOK_EOF, line, 0, NULL }, 0, 0 };
+    Node *root = parse_list(&P, NULL);
+    if (root != NULL && peek(&P)->kind != TOK_EOF) {
+        syntax_error(&P, "unexpected keyword", peek(&P));
+        node_free(root);
+        return NULL;
+    }
+    return root;
+}
+
+/* ---- arithmetic ---- */
+
+typedef enum {
+    A_NUM, A_VAR, A_NEG, A_NOT, A_PREINC, A_PREDEC, A_POSTINC, A_POSTDEC,
+    A_ASSIGN, A_ADD, A_SUB, A_MUL, A_DIV, A_MOD,
+    A_LT, A_LE, A_GT, A_GE, A_EQ, A_NE, A_LAND, A_LOR
+} ArithOp;
+
+struct ArithNode {
+    ArithOp op;
+    ArithOp assign_op;   /* A_ASSIGN: A_NUM for '=', else the operator of op= */
+    long long value;
+    char *name;
+    ArithNode *l, *r;
+};
+
+typedef struct {
+    const char *p;
+    int failed;
+} ArithParser;
+
+static ArithNode *arith_node(ArithOp op, ArithNode *l, ArithNode *r) {
+    ArithNode *n = calloc(1, sizeof(ArithNode));
+    if (n == NULL) {
+        arith_free(l);
+        arith_free(r);
+        return NULL;
+    }
+    n->op = op;
+    n->l = l;
+    n->r = r;
+    return n;
+}
+
+void arith_free(ArithNode *node) {
+    if (node == NULL) return;
+    arith_free(node->l);
+    arith_free(node->r);
+    free(node->name);
+    free(node);
+}
+
+static void arith_skip(ArithParser *A) {
+    while (isspace((unsigned char)*A->p)) A->p++;
+}
+
+/* Consume op if it is next (and not the start of a longer operator) */
+static int arith_accept(ArithParser *A, const char *op) {
+    arith_skip(A);
+    size_t n = strlen(op);
+    if (strncmp(A->p, op, n) != 0) return 0;
+    /* "<" must not take the first half of "<=", "=" not of "==", ... */
+    if (n == 1 && A->p[1] == '=' && strchr("<>=!+-*/%", op[0]) != NULL) return 0;
+    if (n == 1 && (op[0] == '+' || op[0] == '-') && A->p[1] == op[0]) return 0;
+    if (n == 1 && (op[0] == '&' || op[0] == '|')) return 0;
+    A->p += n;
+    return 1;
+}
+
+static ArithNode *arith_expr(ArithParser *A);
+
+static ArithNode *arith_primary(ArithParser *A) {
+    arith_skip(A);
+    if (*A->p == '(') {
+        A->p++;
+        ArithNode *n = arith_expr(A);
+        arith_skip(A);
+        if (*A->p != ')') {
+            A->failed = 1;
+            arith_free(n);
+            return NULL;
+        }
+        A->p++;
+        return n;
+    }
+    if (isdigit((unsigned char)*A->p)) {
+        ArithNode *n = arith_node(A_NUM, NULL, NULL);
+        char *end;
+        if (n != NULL) n->value = strtoll(A->p, &end, 0);
+        else end = (char *)A->p + 1;
+        A->p = end;
+        return n;
+    }
+    if (*A->p == '$') A->p++;
+    if (is_name_start(*A->p)) {
+        const char *start = A->p;
+        while (is_name_char(*A->p)) A->p++;
+        ArithNode *n = arith_node(A_VAR, NULL, NULL);
+        if (n != NULL) n->name = strndup(start, (size_t)(A->p - start));
+        if (arith_accept(A, "++")) return arith_node(A_POSTINC, n, NULL);
+        if (arith_accept(A, "--")) return arith_node(A_POSTDEC, n, NULL);
+        return n;
+    }
+    A->failed = 1;
+    return NULL;
+}
+
+static ArithNode *arith_unary(ArithParser *A) {
+    if (arith_accept(A, "++")) return arith_node(A_PREINC, arith_primary(A), NULL);
+    if (arith_accept(A, "--")) return arith_node(A_PREDEC, arith_primary(A), NULL);
+    if (arith_accept(A, "-")) return arith_node(A_NEG, arith_unary(A), NULL);
+    if (arith_accept(A, "+")) return arith_unary(A);
+    if (arith_accept(A, "!")) return arith_node(A_NOT, arith_unary(A), NULL);
+    return arith_primary(A);
+}
+
+/* Binary levels, loosest first */
+static const struct {
+    const char *ops[4];
+    ArithOp codes[4];
+} LEVELS[] = {
+    { { "||" }, { A_LOR } },
+    { { "&&" }, { A_LAND } },
+    { { "==", "!=" }, { A_EQ, A_NE } },
+    { { "<=", ">=", "<", ">" }, { A_LE, A_GE, A_LT, A_GT } },
+    { { "+", "-" }, { A_ADD, A_SUB } },
+    { { "*", "/", "%" }, { A_MUL, A_DIV, A_MOD } },
+};
+#define NUM_LEVELS ((int)(sizeof(LEVELS) / sizeof(LEVELS[0])))
+
+static ArithNode *arith_binary(ArithParser *A, int level) {
+    if (level == NUM_LEVELS) return arith_unary(A);
+    ArithNode *left = arith_binary(A, level + 1);
+    for (;;) {
+        int matched = 0;
+        for (int i = 0; i < 4 && LEVELS[level].ops[i] != NULL; i++) {
+            if (arith_accept(A, LEVELS[level].ops[i])) {
+                left = arith_node(LEVELS[level].codes[i], left, arith_binary(A, level + 1));
+                matched = 1;
+                break;
+            }
+        }
+        if (!matched) return left;
+    }
+}
+
+static ArithNode *arith_expr(ArithParser *A) {
+    /* NAME = expr and NAME op= expr (right associative) */
+    static const struct {
+        const char *op;
+        ArithOp code;
+    } assigns[] = {
+        { "+=", A_ADD }, { "-=", A_SUB }, { "*=", A_MUL }, { "/=", A_DIV }, { "%=", A_MOD }, { "=", A_NUM }
+    };
+    arith_skip(A);
+    const char *save = A->p;
+    if (is_name_start(*A->p)) {
+        while (is_name_char(*A->p)) A->p++;
+        size_t name_len = (size_t)(A->p - save);
+        for (size_t i = 0; i < sizeof(assigns) / sizeof(assigns[0]); i++) {
+            if (arith_accept(A, assigns[i].op)) {
+                ArithNode *n = arith_node(A_ASSIGN, arith_expr(A), NULL);
+                if (n != NULL) {
+                    n->assign_op = assigns[i].code;
+                    n->name = strndup(save, name_len);
+                }
+                return n;
+            }
+        }
+        A->p = save;
+    }
+    return arith_binary(A, 0);
+}
+
+static int arith_complete(const ArithNode *n) {
+    if (n == NULL) return 0;
+    switch (n->op) {
+    case A_NUM:
+        return 1;
+    case A_VAR:
+        return n->name != NULL;
+    case A_NEG: case A_NOT: case A_PREINC: case A_PREDEC: case A_POSTINC: case A_POSTDEC:
+        if (n->op >= A_PREINC && (n->l == NULL || n->l->op != A_VAR)) return 0;
+        return arith_complete(n->l);
+    case A_ASSIGN:
+        return n->name != NULL && arith_complete(n->l);
+    default:
+        return arith_complete(n->l) && arith_complete(n->r);
+    }
+}
+
+ArithNode *arith_parse(const char *expr) {
+    ArithParser A = { expr, 0 };
+    ArithNode *n = arith_expr(&A);
+    arith_skip(&A);
+    if (A.failed || *A.p != '\0' || !arith_complete(n)) {
+        fprintf(stderr, "arithmetic: syntax error in '%s'\n", expr);
+        arith_free(n);
+        return NULL;
+    }
+    return n;
+}
+
+/* Sums, differences and products wrap in two's complement like the shells
+ * do; doing them unsigned keeps the overflow defined */
+static long long arith_wrap(unsigned long long v) {
+    return (long long)v;
+}
+
+static long long arith_apply(ArithOp op, long long a, long long b, int *err) {
+    switch (op) {
+    case A_ADD: return arith_wrap((unsigned long long)a + (unsigned long long)b);
+    case A_SUB: return arith_wrap((unsigned long long)a - (unsigned long long)b);
+    case A_MUL: return arith_wrap((unsigned long long)a * (unsigned long long)b);
+    case A_DIV:
+    case A_MOD:
+        if (b == 0) {
+            *err = 1;
+            return 0;
+        }
+        /* The one quotient that does not fit traps: wrap it as in two's
+         * complement instead */
+        if (b == -1 && a == LLONG_MIN) return op == A_DIV ? LLONG_MIN : 0;
+        return op == A_DIV ? a / b : a % b;
+    case A_LT: return a < b;
+    case A_LE: return a <= b;
+    case A_GT: return a > b;
+    case A_GE: return a >= b;
+    case A_EQ: return a == b;
+    case A_NE: return a != b;
+    default: return b;
+    }
+}
+
+long long arith_eval(const ArithNode *n, const ArithEnv *env, int *err) {
+    long long v;
+    switch (n->op) {
+    case A_NUM:
+        return n->value;
+    case A_VAR:
+        return env->get(n->name);
+    case A_NEG:
+        return arith_wrap(-(unsigned long long)arith_eval(n->l, env, err));
+    case A_NOT:
+        return !arith_eval(n->l, env, err);
+    case A_PREINC:
+    case A_PREDEC:
+    case A_POSTINC:
+    case A_POSTDEC:
+        v = env->get(n->l->name);
+        {
+            long long next = arith_apply(n->op == A_PREINC || n->op == A_POSTINC ? A_ADD : A_SUB, v, 1, err);
+            env->set(n->l->name, next);
+            return n->op == A_PREINC || n->op == A_PREDEC ? next : v;
+        }
+    case A_ASSIGN:
+        v = arith_eval(n->l, env, err);
+        if (n->assign_op != A_NUM) v = arith_apply(n->assign_op, env->get(n->name), v, err);
+        if (!*err) env->set(n->name, v);
+        return v;
+    case A_LAND:
+        return arith_eval(n->l, env, err) && arith_eval(n->r, env, err);
+    case A_LOR:
+        return arith_eval(n->l, env, err) || arith_eval(n->r, env, err);
+    default:
+        v = arith_eval(n->l, env, err);
+        return arith_apply(n->op, v, arith_eval(n->r, env, err), err);
+    }
+}
@@ -0,0 +1,469 @@
+// server.c
+// terminal_app --serve SOCKET: a long-lived shell daemon for automation.
+//
+// One epoll loop owns the listening socket, every client connection and the
+// result pipe of every running command. A command is run by forking the
+// daemon: the child takes the session's cwd, environment and history and
+// the client's stdin/stdout/stderr (received with SCM_RIGHTS), runs the
+// line through execute_command, then writes the new cwd, environment and
+// history back over its result pipe before exiting. The daemon never
+// blocks on a command, so hundreds of sessions can run at the same time,
+// and none of them pays for process startup or history loading.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "executor.h"
+#include "server.h"
+
+#define MAX_EVENTS 64
+
+extern char **environ;
+
+enum { TAG_LISTEN, TAG_SIGNAL, TAG_SESSION, TAG_JOB };
+
+typedef struct Session Session;
+
+typedef struct {
+    int tag;             /* TAG_JOB */
+    pid_t pid;
+    int fd;              /* read end of the result pipe */
+    char *buf;
+    size_t len, cap;
+    Session *session;
+} Job;
+
+struct Session {
+    int tag;             /* TAG_SESSION */
+    int fd;
+    char *cwd;
+    char **env;          /* NULL-terminated */
+    char **history;
+    int history_count;
+    Job *job;            /* running command, or NULL */
+    int closed;          /* client gone while its command still runs */
+};
+
+static int epfd = -1;
+static int active_sessions = 0;
+static char recv_buf[SERVE_MAX_MESSAGE];
+
+static void free_strings(char **list, int count) {
+    if (list == NULL) return;
+    for (int i = 0; count < 0 ? list[i] != NULL : i < count; i++) free(list[i]);
+    free(list);
+}
+
+static void session_free(Session *s) {
+    if (s->fd >= 0) close(s->fd);
+    free(s->cwd);
+    free_strings(s->env, -1);
+    free_strings(s->history, s->history_count);
+    free(s);
+    active_sessions--;
+}
+
+/* The client went away: drop the session now, or once its command ends */
+static void session_close(Session *s) {
+    epoll_ctl(epfd, EPOLL_CTL_DEL, s->fd, NULL);
+    if (s->job != NULL) {
+        close(s->fd);
+        s->fd = -1;
+        s->closed = 1;
+        return;
+    }
+    session_free(s);
+}
+
+static void send_status(Session *s, int status) {
+    ServeHeader hdr = { SERVE_STATUS, status };
+    if (s->fd >= 0) send(s->fd, &hdr, sizeof(hdr), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/* Split count NUL-terminated strings starting at p (within end) into a new
+ * NULL-terminated array; count < 0 takes all. Returns NULL on bad input. */
+static char **parse_strings(const char **p, const char *end, int count, int *out_count) {
+    int cap = 16, n = 0;
+    char **list = malloc((size_t)cap * sizeof(char *));
+    while (list != NULL && *p < end && (count < 0 || n < count)) {
+        const char *nul = memchr(*p, '\0', (size_t)(end - *p));
+        if (nul == NULL) break;
+        if (n + 2 > cap) {
+            cap *= 2;
+            char **grown = realloc(list, (size_t)cap * sizeof(char *));
+            if (grown == NULL) break;
+            list = grown;
+        }
+        list[n++] = strdup(*p);
+        *p = nul + 1;
+    }
+    if (list == NULL || (count >= 0 && n != count)) {
+        if (list) list[n] = NULL;
+        free_strings(list, n);
+        return NULL;
+    }
+    list[n] = NULL;
+    if (out_count) *out_count = n;
+    return list;
+}
+
+/* ---- child side ---- */
+
+static int append(char **buf, size_t *len, size_t *cap, const void *data, size_t n) {
+    if (*len + n > *cap) {
+        size_t c = *cap ? *cap : 4096;
+        while (c < *len + n) c *= 2;
+        char *grown = realloc(*buf, c);
+        if (grown == NULL) return -1;
+        *buf = grown;
+        *cap = c;
+    }
+    memcpy(*buf + *len, data, n);
+    *len += n;
+    return 0;
+}
+
+/* In the forked child: become the session, run the line, report back */
+static void run_child(Session *s, const char *command, int fds[3], int result_fd) {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigprocmask(SIG_SETMASK, &mask, NULL);
+    signal(SIGPIPE, SIG_DFL);
+
+    for (int i = 0; i < 3; i++) {
+        dup2(fds[i], i);
+        close(fds[i]);
+    }
+    if (chdir(s->cwd) != 0) perror(s->cwd);
+    clearenv();
+    for (int i = 0; s->env[i] != NULL; i++) putenv(s->env[i]);
+    history_persist(0);
+    history_set(s->history, s->history_count);
+
+    int32_t status = execute_command(command);
+    fflush(stdout);
+    fflush(stderr);
+
+    /* status, env count, history count, then cwd, env..., history... */
+    char *buf = NULL, cwd[4096];
+    size_t len = 0, cap = 0;
+    char *const *hist;
+    uint32_t nenv = 0, nhist = (uint32_t)history_get(&hist);
+    while (environ != NULL && environ[nenv] != NULL) nenv++;
+    append(&buf, &len, &cap, &status, sizeof(status));
+    append(&buf, &len, &cap, &nenv, sizeof(nenv));
+    append(&buf, &len, &cap, &nhist, sizeof(nhist));
+    if (getcwd(cwd, sizeof(cwd)) == NULL) snprintf(cwd, sizeof(cwd), "%s", s->cwd);
+    append(&buf, &len, &cap, cwd, strlen(cwd) + 1);
+    for (uint32_t i = 0; i < nenv; i++) append(&buf, &len, &cap, environ[i], strlen(environ[i]) + 1);
+    for (uint32_t i = 0; i < nhist; i++) append(&buf, &len, &cap, hist[i], strlen(hist[i]) + 1);
+
+    for (size_t off = 0; buf != NULL && off < len;) {
+        ssize_t n = write(result_fd, buf + off, len - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        off += (size_t)n;
+    }
+    _exit(0);
+}
+
+/* ---- daemon side ---- */
+
+static void start_job(Session *s, const char *command, int fds[3]) {
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) != 0) {
+        perror("pipe");
+        send_status(s, -1);
+        return;
+    }
+    Job *job = calloc(1, sizeof(Job));
+    fflush(stdout);
+    pid_t pid = job ? fork() : -1;
+    if (pid == 0) {
+        close(pfd[0]);
+        run_child(s, command, fds, pfd[1]);
+    }
+    close(pfd[1]);
+    if (pid < 0) {
+        perror("fork");
+        close(pfd[0]);
+        free(job);
+        send_status(s, -1);
+        return;
+    }
+
+    job->tag = TAG_JOB;
+    job->pid = pid;
+    job->fd = pfd[0];
+    job->session = s;
+    fcntl(job->fd, F_SETFL, O_NONBLOCK);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = job };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, job->fd, &ev);
+
+    /* One command at a time per session: stop reading its socket */
+    s->job = job;
+    struct epoll_event sev = { .events = 0, .data.ptr = s };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, s->fd, &sev);
+}
+
+/* The child closed its result pipe: apply what it reported to the session */
+static void finish_job(Job *job) {
+    Session *s = job->session;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, job->fd, NULL);
+    close(job->fd);
+    waitpid(job->pid, NULL, 0);
+    s->job = NULL;
+
+    int32_t status = -1;
+    uint32_t nenv, nhist;
+    const size_t fixed = sizeof(status) + sizeof(nenv) + sizeof(nhist);
+    if (job->len >= fixed) {
+        memcpy(&status, job->buf, sizeof(status));
+        memcpy(&nenv, job->buf + 4, sizeof(nenv));
+        memcpy(&nhist, job->buf + 8, sizeof(nhist));
+        const char *p = job->buf + fixed, *end = job->buf + job->len;
+        char **cwd = parse_strings(&p, end, 1, NULL);
+        char **env = cwd ? parse_strings(&p, end, (int)nenv, NULL) : NULL;
+        int hist_count = 0;
+        char **hist = env ? parse_strings(&p, end, (int)nhist, &hist_count) : NULL;
+        if (hist != NULL) {
+            free(s->cwd);
+            s->cwd = strdup(cwd[0]);
+            free_strings(s->env, -1);
+            s->env = env;
+            free_strings(s->history, s->history_count);
+            s->history = hist;
+            s->history_count = hist_count;
+            env = NULL;
+        }
+        free_strings(cwd, -1);
+        free_strings(env, -1);
+    }
+    free(job->buf);
+    free(job);
+
+    if (s->closed) {
+        session_free(s);
+        return;
+    }
+    send_status(s, status);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = s };
+    epoll_ctl(epfd, EPOLL_CTL_MOD, s->fd, &ev);
+}
+
+static void read_job(Job *job) {
+    for (;;) {
+        char chunk[65536];
+        ssize_t n = read(job->fd, chunk, sizeof(chunk));
+        if (n > 0) {
+            if (append(&job->buf, &job->len, &job->cap, chunk, (size_t)n) != 0) job->len = 0;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return;
+        finish_job(job);
+        return;
+    }
+}
+
+static void read_session(Session *s) {
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    struct iovec iov = { recv_buf, sizeof(recv_buf) - 1 };
+    struct msghdr msg = { 0 };
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    ssize_t n = recvmsg(s->fd, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return;
+
+    int fds[3] = { -1, -1, -1 }, nfds = 0;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c)) {
+        if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+            nfds = (int)((c->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            if (nfds > 3) nfds = 3;
+            memcpy(fds, CMSG_DATA(c), (size_t)nfds * sizeof(int));
+        }
+    }
+    if (n <= 0 || (size_t)n < sizeof(ServeHeader)) {
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+        session_close(s);
+        return;
+    }
+
+    ServeHeader hdr;
+    memcpy(&hdr, recv_buf, sizeof(hdr));
+    recv_buf[n] = '\0';
+    const char *p = recv_buf + sizeof(hdr), *end = recv_buf + n;
+
+    if (hdr.type == SERVE_HELLO) {
+        char **cwd = parse_strings(&p, end, 1, NULL);
+        char **env = parse_strings(&p, end, -1, NULL);
+        if (cwd != NULL && env != NULL) {
+            free(s->cwd);
+            s->cwd = strdup(cwd[0]);
+            free_strings(s->env, -1);
+            s->env = env;
+            env = NULL;
+        }
+        free_strings(cwd, -1);
+        free_strings(env, -1);
+    } else if (hdr.type == SERVE_RUN && nfds == 3) {
+        start_job(s, p, fds);
+    } else {
+        send_status(s, 126);
+    }
+    for (int i = 0; i < nfds; i++) close(fds[i]);
+}
+
+static void accept_clients(int lfd) {
+    for (;;) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != ECONNABORTED) perror("accept");
+            return;
+        }
+        Session *s = calloc(1, sizeof(Session));
+        char cwd[4096];
+        if (s != NULL) {
+            s->tag = TAG_SESSION;
+            s->fd = fd;
+            s->cwd = strdup(getcwd(cwd, sizeof(cwd)) ? cwd : "/");
+            s->env = calloc(1, sizeof(char *));
+        }
+        if (s == NULL || s->cwd == NULL || s->env == NULL) {
+            if (s) {
+                free(s->cwd);
+                free(s->env);
+                free(s);
+            }
+            close(fd);
+            continue;
+        }
+        active_sessions++;
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = s };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+/* Bind path, replacing a stale socket but not a live daemon */
+static int open_listener(const char *path) {
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "serve: socket path too long: %s\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 && errno == EADDRINUSE) {
+        int probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        int live = probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (live) {
+            fprintf(stderr, "serve: a daemon is already listening on %s\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            perror("bind");
+            close(fd);
+            return -1;
+        }
+    }
+    if (listen(fd, SOMAXCONN) != 0) {
+        perror("listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int serve_main(const char *path) {
+    /* Every session holds a socket, and a starting command briefly holds
+     * three more fds: allow as many as the hard limit permits */
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    int lfd = open_listener(path);
+    if (lfd < 0) return 1;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    int sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd < 0 || sfd < 0) {
+        perror("serve");
+        close(lfd);
+        return 1;
+    }
+    int listen_tag = TAG_LISTEN, signal_tag = TAG_SIGNAL;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &listen_tag };
+    epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+    ev.data.ptr = &signal_tag;
+    epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &ev);
+
+    printf("Serving on %s\n", path);
+    fflush(stdout);
+
+    int running = 1;
+    struct epoll_event events[MAX_EVENTS];
+    while (running) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            int tag = *(int *)events[i].data.ptr;
+            if (tag == TAG_LISTEN) {
+                accept_clients(lfd);
+            } else if (tag == TAG_SIGNAL) {
+                running = 0;
+            } else if (tag == TAG_JOB) {
+                read_job(events[i].data.ptr);
+            } else {
+                Session *s = events[i].data.ptr;
+                if (s->job != NULL) {
+                    /* Only hangups are reported while a command runs */
+                    if (events[i].events & (EPOLLHUP | EPOLLERR)) session_close(s);
+                } else {
+                    read_session(s);
+                }
+            }
+        }
+    }
+
+    close(lfd);
+    unlink(path);
+    printf("Daemon stopped (%d session%s open)\n", active_sessions, active_sessions == 1 ? "" : "s");
+    return 0;
+}
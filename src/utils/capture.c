@@ -0,0 +1,96 @@
+// capture.c
+// stdout capture through a pipe. The shell thread keeps running the work
+// (which may be a builtin writing to fd 1 itself) while a reader thread
+// empties the pipe into a growing buffer in 64 KB-or-larger reads; without
+// the reader a builtin printing more than the pipe holds would block
+// forever. The pipe is enlarged to 1 MB where the kernel allows it so a
+// chatty child wakes the reader less often.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "capture.h"
+
+#define CAPTURE_CHUNK (64 * 1024)
+#define CAPTURE_PIPE_SIZE (1024 * 1024)
+
+typedef struct {
+    int fd;
+    OutputBuffer *out;
+    int failed;          /* out of memory: keep draining, drop the data */
+} Reader;
+
+static void *reader_main(void *arg) {
+    Reader *r = arg;
+    OutputBuffer *out = r->out;
+    char scratch[4096];
+
+    for (;;) {
+        if (!r->failed && out->cap - out->len < CAPTURE_CHUNK) {
+            size_t cap = out->cap ? out->cap * 2 : CAPTURE_CHUNK;
+            while (cap - out->len < CAPTURE_CHUNK) cap *= 2;
+            char *data = realloc(out->data, cap);
+            if (data) {
+                out->data = data;
+                out->cap = cap;
+            } else {
+                r->failed = 1;
+            }
+        }
+        ssize_t n = r->failed ? read(r->fd, scratch, sizeof(scratch))
+                              : read(r->fd, out->data + out->len, out->cap - out->len);
+        if (n > 0) {
+            if (!r->failed) out->len += (size_t)n;
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+int capture_stdout(int (*fn)(void *), void *arg, OutputBuffer *out) {
+    int pfd[2];
+    if (pipe2(pfd, O_CLOEXEC) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    fcntl(pfd[1], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+
+    Reader reader = { pfd[0], out, 0 };
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, reader_main, &reader) != 0) {
+        fprintf(stderr, "capture: cannot start reader thread\n");
+        close(pfd[0]);
+        close(pfd[1]);
+        return -1;
+    }
+
+    /* dup2 drops O_CLOEXEC, so exec'd children write into the pipe */
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    dup2(pfd[1], STDOUT_FILENO);
+    close(pfd[1]);
+
+    int status = fn(arg);
+
+    /* Restoring fd 1 closes the shell's last write end: the reader sees
+     * EOF as soon as the (already reaped) children are gone */
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    pthread_join(tid, NULL);
+    close(pfd[0]);
+    if (reader.failed) fprintf(stderr, "capture: out of memory, output truncated\n");
+    return status;
+}
+
+void output_buffer_free(OutputBuffer *out) {
+    free(out->data);
+    out->data = NULL;
+    out->len = out->cap = 0;
+}
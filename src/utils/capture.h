@@ -0,0 +1,25 @@
+// capture.h
+// Capture everything a piece of shell work writes to stdout into memory.
+// Used by command substitution and memo: builtins run in the shell process and
+// external commands inherit the capture pipe, so neither needs a temporary
+// file.
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+
+typedef struct {
+    char *data;          /* not NUL-terminated; NULL while empty */
+    size_t len;
+    size_t cap;
+} OutputBuffer;
+
+/* Run fn(arg) with fd 1 pointed at a pipe that a reader thread drains into
+ * out (appending). Returns fn's status, or -1 if the capture could not be
+ * set up. */
+int capture_stdout(int (*fn)(void *), void *arg, OutputBuffer *out);
+
+void output_buffer_free(OutputBuffer *out);
+
+#endif // CAPTURE_H
@@ -0,0 +1,480 @@
+// completion.c
+// Tab completion for commands and paths.
+//
+// Command names live in a trie over every executable in the $PATH
+// directories plus the built-ins. It is built once, on the first Tab, and
+// then kept current from inotify events instead of rescanning the
+// directories: each name records a bitmask of the PATH directories that
+// provide it, so adding or removing a file only touches the nodes on that
+// name's path. Each node also counts the live names below it, which makes
+// "how many matches" and the common prefix a walk down the trie.
+//
+// Paths are completed from a small cache of sorted directory listings,
+// revalidated with one stat() of the directory (mtime) per completion.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "completion.h"
+#include "executor.h"
+
+#define MAX_PATH_DIRS 63
+#define BUILTIN_BIT (1ULL << 63)
+#define WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                    IN_DELETE_SELF | IN_MOVE_SELF)
+#define DIR_CACHE_SIZE 16
+
+typedef struct {
+    uint32_t child;      /* first child (0 = none; node 0 is the root) */
+    uint32_t sibling;    /* next sibling, siblings sorted by ch */
+    uint32_t count;      /* live names in this subtree, including this node */
+    uint64_t dirs;       /* PATH directories (and BUILTIN_BIT) providing this name */
+    unsigned char ch;
+} TrieNode;
+
+typedef struct {
+    TrieNode *nodes;
+    uint32_t nnodes;
+    uint32_t cap;
+    char *path_env;                  /* $PATH the trie was built from */
+    char *dirs[MAX_PATH_DIRS];
+    int wds[MAX_PATH_DIRS];
+    int ndirs;
+    int inotify_fd;
+    int built;
+} CommandTrie;
+
+typedef struct {
+    char path[PATH_MAX];
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    char **names;                    /* sorted; directories end in '/' */
+    int count;
+    unsigned long last_used;
+} DirListing;
+
+static CommandTrie trie = { .inotify_fd = -1 };
+static DirListing dir_cache[DIR_CACHE_SIZE];
+static unsigned long dir_cache_clock;
+
+/* ---- command trie ---- */
+
+static uint32_t trie_new_node(unsigned char ch) {
+    if (trie.nnodes == trie.cap) {
+        uint32_t cap = trie.cap ? trie.cap * 2 : 4096;
+        TrieNode *nodes = realloc(trie.nodes, cap * sizeof(TrieNode));
+        if (!nodes) return 0;
+        trie.nodes = nodes;
+        trie.cap = cap;
+    }
+    TrieNode *n = &trie.nodes[trie.nnodes];
+    memset(n, 0, sizeof(*n));
+    n->ch = ch;
+    return trie.nnodes++;
+}
+
+/* Find the child of parent for ch, creating it in sorted position if asked */
+static uint32_t trie_child(uint32_t parent, unsigned char ch, int create) {
+    uint32_t prev = 0, cur = trie.nodes[parent].child;
+    while (cur && trie.nodes[cur].ch < ch) {
+        prev = cur;
+        cur = trie.nodes[cur].sibling;
+    }
+    if (cur && trie.nodes[cur].ch == ch) return cur;
+    if (!create) return 0;
+
+    uint32_t n = trie_new_node(ch);
+    if (!n) return 0;
+    trie.nodes[n].sibling = cur;
+    if (prev) trie.nodes[prev].sibling = n;
+    else trie.nodes[parent].child = n;
+    return n;
+}
+
+/* Set or clear one provider bit of a name, keeping subtree counts in step */
+static void trie_update(const char *name, uint64_t bit, int present) {
+    uint32_t path[256];
+    int depth = 0;
+    uint32_t node = 0;
+
+    path[depth++] = 0;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        if (depth == 256) return;
+        node = trie_child(node, *p, present);
+        if (!node) return;
+        path[depth++] = node;
+    }
+    if (node == 0) return;
+
+    uint64_t before = trie.nodes[node].dirs;
+    if (present) trie.nodes[node].dirs |= bit;
+    else trie.nodes[node].dirs &= ~bit;
+    uint64_t after = trie.nodes[node].dirs;
+
+    if ((before == 0) == (after == 0)) return;
+    for (int i = 0; i < depth; i++) {
+        if (after) trie.nodes[path[i]].count++;
+        else trie.nodes[path[i]].count--;
+    }
+}
+
+static int is_executable_file(const char *dir, const char *name) {
+    char full[PATH_MAX];
+    struct stat st;
+    if (snprintf(full, sizeof(full), "%s/%s", dir, name) >= (int)sizeof(full)) return 0;
+    if (stat(full, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    return access(full, X_OK) == 0;
+}
+
+static void scan_path_dir(int i) {
+    DIR *d = opendir(trie.dirs[i]);
+    if (!d) return;
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        if (e->d_name[0] == '.') continue;
+        if (e->d_type != DT_REG && e->d_type != DT_LNK && e->d_type != DT_UNKNOWN) continue;
+        if (is_executable_file(trie.dirs[i], e->d_name)) {
+            trie_update(e->d_name, 1ULL << i, 1);
+        }
+    }
+    closedir(d);
+}
+
+static void trie_free(void) {
+    if (trie.inotify_fd >= 0) close(trie.inotify_fd);
+    for (int i = 0; i < trie.ndirs; i++) free(trie.dirs[i]);
+    free(trie.nodes);
+    free(trie.path_env);
+    memset(&trie, 0, sizeof(trie));
+    trie.inotify_fd = -1;
+}
+
+static void trie_build(void) {
+    const char *path = getenv("PATH");
+    if (!path) path = "";
+
+    trie_free();
+    trie.path_env = strdup(path);
+    trie_new_node(0);    /* the root is node 0 */
+    if (!trie.nodes) return;
+    trie.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    trie.built = 1;
+
+    for (int b = 0; builtin_commands[b]; b++) {
+        trie_update(builtin_commands[b], BUILTIN_BIT, 1);
+    }
+
+    char *copy = strdup(path);
+    if (!copy) return;
+    char *save = NULL;
+    for (char *dir = strtok_r(copy, ":", &save); dir && trie.ndirs < MAX_PATH_DIRS;
+         dir = strtok_r(NULL, ":", &save)) {
+        int dup = 0;
+        for (int i = 0; i < trie.ndirs; i++) {
+            if (strcmp(trie.dirs[i], dir) == 0) dup = 1;
+        }
+        if (dup) continue;
+
+        int i = trie.ndirs;
+        trie.dirs[i] = strdup(dir);
+        if (!trie.dirs[i]) break;
+        trie.ndirs++;
+        /* Watch before scanning so nothing created in between is missed */
+        trie.wds[i] = trie.inotify_fd >= 0 ? inotify_add_watch(trie.inotify_fd, dir, WATCH_MASK) : -1;
+        scan_path_dir(i);
+    }
+    free(copy);
+}
+
+/* Apply pending inotify events. Returns -1 if the trie must be rebuilt. */
+static int trie_apply_events(void) {
+    char buf[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    if (trie.inotify_fd < 0) return 0;
+    for (;;) {
+        ssize_t n = read(trie.inotify_fd, buf, sizeof(buf));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return 0;    /* EAGAIN: drained */
+        }
+        for (char *p = buf; p < buf + n;) {
+            struct inotify_event *ev = (struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) return -1;
+            int i = 0;
+            while (i < trie.ndirs && trie.wds[i] != ev->wd) i++;
+            if (i == trie.ndirs) continue;
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) return -1;
+            if (ev->len == 0 || ev->name[0] == '.') continue;
+
+            int present = 0;
+            if (ev->mask & (IN_CREATE | IN_MOVED_TO | IN_ATTRIB)) {
+                present = is_executable_file(trie.dirs[i], ev->name);
+            }
+            trie_update(ev->name, 1ULL << i, present);
+        }
+    }
+}
+
+/* Bring the trie up to date: build on first use or when $PATH changed */
+static void trie_refresh(void) {
+    const char *path = getenv("PATH");
+    if (!path) path = "";
+    if (!trie.built || !trie.path_env || strcmp(trie.path_env, path) != 0 ||
+        trie_apply_events() < 0) {
+        trie_build();
+    }
+}
+
+static int list_add(CompletionList *out, const char *word, size_t len) {
+    if (out->nitems == out->cap) {
+        int cap = out->cap ? out->cap * 2 : 64;
+        char **items = realloc(out->items, cap * sizeof(char *));
+        if (!items) return -1;
+        out->items = items;
+        out->cap = cap;
+    }
+    char *item = malloc(len + 1);
+    if (!item) return -1;
+    memcpy(item, word, len);
+    item[len] = '\0';
+    out->items[out->nitems++] = item;
+    return 0;
+}
+
+/* Depth-first walk collecting live names in sorted order */
+static void trie_collect(uint32_t node, char *word, size_t len, CompletionList *out) {
+    if (trie.nodes[node].dirs && list_add(out, word, len) < 0) return;
+    if (len + 1 >= COMPLETION_MAX_WORD) return;
+    for (uint32_t c = trie.nodes[node].child; c; c = trie.nodes[c].sibling) {
+        if (trie.nodes[c].count == 0) continue;
+        word[len] = (char)trie.nodes[c].ch;
+        trie_collect(c, word, len + 1, out);
+    }
+}
+
+static void complete_command(const char *prefix, size_t len, int want_items, CompletionList *out) {
+    trie_refresh();
+    if (!trie.nodes) return;
+
+    uint32_t node = 0;
+    for (size_t i = 0; i < len; i++) {
+        node = trie_child(node, (unsigned char)prefix[i], 0);
+        if (!node) return;
+    }
+    out->count = (int)trie.nodes[node].count;
+    if (out->count == 0) return;
+
+    /* Common prefix: follow the only live child until a name ends */
+    size_t n = len;
+    memcpy(out->common, prefix, len);
+    while (!trie.nodes[node].dirs && n + 1 < COMPLETION_MAX_WORD) {
+        uint32_t only = 0;
+        for (uint32_t c = trie.nodes[node].child; c; c = trie.nodes[c].sibling) {
+            if (trie.nodes[c].count == 0) continue;
+            if (only) { only = 0; break; }
+            only = c;
+            if (trie.nodes[c].count == trie.nodes[node].count) break;
+        }
+        if (!only) break;
+        node = only;
+        out->common[n++] = (char)trie.nodes[node].ch;
+    }
+    out->common[n] = '\0';
+
+    if (want_items) {
+        char word[COMPLETION_MAX_WORD];
+        memcpy(word, out->common, n);
+        trie_collect(node, word, n, out);
+    }
+}
+
+void completion_init(void) {
+    trie_refresh();
+}
+
+/* ---- directory listings ---- */
+
+static int cmp_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static void listing_clear(DirListing *l) {
+    for (int i = 0; i < l->count; i++) free(l->names[i]);
+    free(l->names);
+    l->names = NULL;
+    l->count = 0;
+    l->path[0] = '\0';
+}
+
+static int listing_load(DirListing *l, const char *dir, const struct stat *st) {
+    DIR *d = opendir(dir);
+    if (!d) return -1;
+
+    int cap = 64;
+    l->names = malloc(cap * sizeof(char *));
+    l->count = 0;
+    struct dirent *e;
+    while (l->names && (e = readdir(d)) != NULL) {
+        if (strcmp(e->d_name, ".") == 0 || strcmp(e->d_name, "..") == 0) continue;
+
+        int is_dir = e->d_type == DT_DIR;
+        if (e->d_type == DT_LNK || e->d_type == DT_UNKNOWN) {
+            char full[PATH_MAX];
+            struct stat target;
+            snprintf(full, sizeof(full), "%s/%s", dir, e->d_name);
+            is_dir = stat(full, &target) == 0 && S_ISDIR(target.st_mode);
+        }
+
+        if (l->count == cap) {
+            cap *= 2;
+            char **names = realloc(l->names, cap * sizeof(char *));
+            if (!names) break;
+            l->names = names;
+        }
+        size_t len = strlen(e->d_name);
+        char *name = malloc(len + 2);
+        if (!name) break;
+        memcpy(name, e->d_name, len);
+        if (is_dir) name[len++] = '/';
+        name[len] = '\0';
+        l->names[l->count++] = name;
+    }
+    closedir(d);
+    if (!l->names) return -1;
+
+    qsort(l->names, l->count, sizeof(char *), cmp_names);
+    snprintf(l->path, sizeof(l->path), "%s", dir);
+    l->dev = st->st_dev;
+    l->ino = st->st_ino;
+    l->mtime = st->st_mtim;
+    return 0;
+}
+
+/* Sorted listing of dir, reloaded only when the directory changed */
+static DirListing *dir_listing(const char *dir) {
+    struct stat st;
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) return NULL;
+
+    DirListing *victim = &dir_cache[0];
+    for (int i = 0; i < DIR_CACHE_SIZE; i++) {
+        DirListing *l = &dir_cache[i];
+        if (l->path[0] && strcmp(l->path, dir) == 0) {
+            if (l->dev == st.st_dev && l->ino == st.st_ino &&
+                l->mtime.tv_sec == st.st_mtim.tv_sec && l->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                l->last_used = ++dir_cache_clock;
+                return l;
+            }
+            victim = l;
+            break;
+        }
+        if (l->last_used < victim->last_used) victim = l;
+    }
+
+    listing_clear(victim);
+    if (listing_load(victim, dir, &st) != 0) {
+        listing_clear(victim);
+        return NULL;
+    }
+    victim->last_used = ++dir_cache_clock;
+    return victim;
+}
+
+static void complete_path(const char *word, size_t len, int want_items, CompletionList *out) {
+    /* Split into the directory part (kept as typed) and the name prefix */
+    size_t dir_len = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (word[i] == '/') dir_len = i + 1;
+    }
+    const char *base = word + dir_len;
+    size_t base_len = len - dir_len;
+
+    char dir[PATH_MAX];
+    if (dir_len == 0) {
+        strcpy(dir, ".");
+    } else if (word[0] == '~' && (dir_len == 2 || word[1] == '/')) {
+        const char *home = getenv("HOME");
+        snprintf(dir, sizeof(dir), "%s%.*s", home ? home : "", (int)(dir_len - 1), word + 1);
+    } else {
+        snprintf(dir, sizeof(dir), "%.*s", (int)dir_len, word);
+    }
+
+    DirListing *l = dir_listing(dir);
+    if (!l) return;
+
+    /* Binary search for the first name >= prefix */
+    int lo = 0, hi = l->count;
+    char key[NAME_MAX + 2];
+    snprintf(key, sizeof(key), "%.*s", (int)base_len, base);
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (strcmp(l->names[mid], key) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+
+    size_t common_len = 0;
+    for (int i = lo; i < l->count && strncmp(l->names[i], key, base_len) == 0; i++) {
+        const char *name = l->names[i];
+        if (name[0] == '.' && base[0] != '.') continue;
+
+        if (out->count == 0) {
+            snprintf(out->common, sizeof(out->common), "%.*s%s", (int)dir_len, word, name);
+            common_len = strlen(out->common);
+        } else {
+            size_t k = dir_len;
+            while (k < common_len && out->common[k] == name[k - dir_len]) k++;
+            common_len = k;
+            out->common[common_len] = '\0';
+        }
+        out->count++;
+
+        if (want_items) {
+            char item[COMPLETION_MAX_WORD];
+            int n = snprintf(item, sizeof(item), "%.*s%s", (int)dir_len, word, name);
+            if (n < (int)sizeof(item)) list_add(out, item, n);
+        }
+    }
+}
+
+/* ---- entry point ---- */
+
+/* A word is in command position when only separators precede it */
+static int is_command_position(const char *line, int start) {
+    int i = start - 1;
+    while (i >= 0 && (line[i] == ' ' || line[i] == '\t')) i--;
+    return i < 0 || line[i] == '|' || line[i] == '&' || line[i] == ';';
+}
+
+void complete_word(const char *line, int start, int end, int want_items, CompletionList *out) {
+    for (int i = 0; i < out->nitems; i++) free(out->items[i]);
+    out->count = 0;
+    out->nitems = 0;
+    out->common[0] = '\0';
+    if (end < start || end - start >= COMPLETION_MAX_WORD) return;
+
+    const char *word = line + start;
+    size_t len = (size_t)(end - start);
+    if (is_command_position(line, start) && memchr(word, '/', len) == NULL) {
+        complete_command(word, len, want_items, out);
+    } else {
+        complete_path(word, len, want_items, out);
+    }
+}
+
+void completion_list_free(CompletionList *list) {
+    for (int i = 0; i < list->nitems; i++) free(list->items[i]);
+    free(list->items);
+    list->items = NULL;
+    list->nitems = 0;
+    list->cap = 0;
+}
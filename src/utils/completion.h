@@ -0,0 +1,28 @@
+// completion.h
+// Tab completion for the line editor. Command names come from a trie built
+// once over the $PATH directories and kept current with inotify; paths come
+// from a small per-directory listing cache keyed by the directory's mtime.
+
+#ifndef COMPLETION_H
+#define COMPLETION_H
+
+#define COMPLETION_MAX_WORD 1024
+
+typedef struct {
+    char **items;        /* full replacement words; directories end in '/' */
+    int count;           /* number of matches (items may hold fewer) */
+    int nitems;
+    int cap;
+    char common[COMPLETION_MAX_WORD];  /* longest common prefix of all matches */
+} CompletionList;
+
+/* Complete the word line[start..end) where end is the cursor. With
+ * want_items == 0 only count and common are filled (cheap for commands). */
+void complete_word(const char *line, int start, int end, int want_items, CompletionList *out);
+
+void completion_list_free(CompletionList *list);
+
+/* Build the $PATH trie now instead of on the first Tab */
+void completion_init(void);
+
+#endif // COMPLETION_H
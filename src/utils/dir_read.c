@@ -0,0 +1,94 @@
+// dir_read.c
+// getdents64 directory reader: one 64 KB syscall buffer per read, names
+// copied into a single growing buffer (no per-entry allocation, no
+// readdir() bookkeeping), so directories with 100k+ entries stay cheap.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "dir_read.h"
+
+#define GETDENTS_BUF (64 * 1024)
+
+/* Record layout returned by getdents64 */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+int dir_read_fd(int fd, DirList *out, int include_dots) {
+    size_t names_cap = 4096, entries_cap = 64;
+    memset(out, 0, sizeof(*out));
+
+    char *buf = malloc(GETDENTS_BUF);
+    out->names = malloc(names_cap);
+    out->entries = malloc(entries_cap * sizeof(DirEntry));
+    if (!buf || !out->names || !out->entries) {
+        free(buf);
+        dir_list_free(out);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, buf, GETDENTS_BUF)) > 0) {
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(buf + off);
+            off += d->d_reclen;
+
+            const char *name = d->d_name;
+            if (!include_dots && name[0] == '.' &&
+                (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            size_t len = strlen(name) + 1;
+
+            if (out->names_len + len > names_cap) {
+                while (out->names_len + len > names_cap) names_cap *= 2;
+                char *names = realloc(out->names, names_cap);
+                if (!names) {
+                    n = -1;
+                    errno = ENOMEM;
+                    break;
+                }
+                out->names = names;
+            }
+            if (out->count == entries_cap) {
+                entries_cap *= 2;
+                DirEntry *entries = realloc(out->entries, entries_cap * sizeof(DirEntry));
+                if (!entries) {
+                    n = -1;
+                    errno = ENOMEM;
+                    break;
+                }
+                out->entries = entries;
+            }
+            memcpy(out->names + out->names_len, name, len);
+            out->entries[out->count].name = (uint32_t)out->names_len;
+            out->entries[out->count].type = d->d_type;
+            out->count++;
+            out->names_len += len;
+        }
+        if (n < 0) break;
+    }
+    free(buf);
+    if (n < 0) {
+        int saved = errno;
+        dir_list_free(out);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+void dir_list_free(DirList *list) {
+    free(list->names);
+    free(list->entries);
+    memset(list, 0, sizeof(*list));
+}
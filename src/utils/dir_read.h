@@ -0,0 +1,33 @@
+// dir_read.h
+// Whole-directory reads with getdents64: every name of a directory lands in
+// one buffer, with the d_type the kernel reported. Shared by wildcard
+// expansion and the ls builtin.
+
+#ifndef DIR_READ_H
+#define DIR_READ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <dirent.h>     /* DT_* */
+
+typedef struct {
+    uint32_t name;       /* offset into DirList.names */
+    unsigned char type;  /* DT_* (DT_UNKNOWN on filesystems that do not say) */
+} DirEntry;
+
+typedef struct {
+    char *names;         /* NUL-terminated names, back to back */
+    size_t names_len;
+    DirEntry *entries;
+    size_t count;
+} DirList;
+
+#define DIR_ENTRY_NAME(list, i) ((list)->names + (list)->entries[i].name)
+
+/* Read all entries of the open directory fd into out ("." and ".." only
+ * with include_dots). Returns 0, or -1 with errno set. */
+int dir_read_fd(int fd, DirList *out, int include_dots);
+
+void dir_list_free(DirList *list);
+
+#endif // DIR_READ_H
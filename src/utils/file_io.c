@@ -0,0 +1,462 @@
+// file_io.c
+// io_uring file reader. One ring and a fixed set of 64 KB buffers
+// (registered with the kernel when RLIMIT_MEMLOCK allows) serve a whole
+// call: up to READS_PER_FILE reads per file and ACTIVE_FILES files are kept
+// in flight, so files on cold caches or network filesystems overlap their
+// I/O instead of waiting on each other. Completions can arrive out of order;
+// a buffer is held until every earlier piece of its file has been handed
+// over.
+//
+// The ring is created per call rather than kept for the life of the shell:
+// its memory is shared across fork(), and builtins may run in pipeline
+// children at the same time. Where io_uring is missing or disabled every
+// file is read with read() into one buffer instead.
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "file_io.h"
+
+#define CHUNK_SIZE      (64 * 1024)
+#define NUM_BUFFERS     16
+#define READS_PER_FILE  4
+#define ACTIVE_FILES    8
+
+typedef struct {
+    int index;           /* position in the caller's paths, -1 when free */
+    int fd;
+    off_t size;          /* st_size when opened (0 when unknown) */
+    off_t submit_off;    /* next offset to read */
+    off_t deliver_off;   /* next offset to hand to the caller */
+    off_t eof_off;       /* valid once eof is set */
+    int eof;
+    int err;
+    int inflight;        /* buffers held: submitted or waiting for delivery */
+} FileState;
+
+typedef struct {
+    FileState *file;     /* NULL when the buffer is free */
+    off_t off;
+    size_t len;          /* bytes read so far */
+    int ready;
+    struct iovec iov;    /* the whole buffer */
+    struct iovec rest;   /* what is left of it, for READV */
+} Slot;
+
+typedef struct {
+    int fd;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ptr, *cq_ptr;
+    size_t sq_len, cq_len, sqes_len;
+    int fixed;           /* buffers registered: use READ_FIXED */
+    unsigned to_submit;
+} Ring;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_close(Ring *r) {
+    if (r->sqes) munmap(r->sqes, r->sqes_len);
+    if (r->cq_ptr && r->cq_ptr != r->sq_ptr) munmap(r->cq_ptr, r->cq_len);
+    if (r->sq_ptr) munmap(r->sq_ptr, r->sq_len);
+    if (r->fd >= 0) close(r->fd);
+}
+
+static int ring_open(Ring *r, unsigned entries) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(r, 0, sizeof(*r));
+    r->fd = sys_io_uring_setup(entries, &p);
+    if (r->fd < 0) return -1;
+
+    r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single && r->cq_len > r->sq_len) r->sq_len = r->cq_len;
+
+    r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    if (r->sq_ptr == MAP_FAILED) {
+        r->sq_ptr = NULL;
+        ring_close(r);
+        return -1;
+    }
+    if (single) {
+        r->cq_ptr = r->sq_ptr;
+    } else {
+        r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_CQ_RING);
+        if (r->cq_ptr == MAP_FAILED) {
+            r->cq_ptr = NULL;
+            ring_close(r);
+            return -1;
+        }
+    }
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        r->sqes = NULL;
+        ring_close(r);
+        return -1;
+    }
+
+    char *sq = r->sq_ptr, *cq = r->cq_ptr;
+    r->sq_head = (unsigned *)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned *)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned *)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)(sq + p.sq_off.array);
+    r->cq_head = (unsigned *)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned *)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned *)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+/* Queue a read of the rest of slot's buffer (all of it unless a short
+ * read is being continued); submitted by the next ring_wait */
+static void ring_queue_read(Ring *r, Slot *slots, int s) {
+    unsigned tail = *r->sq_tail;
+    unsigned idx = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[idx];
+    Slot *slot = &slots[s];
+    char *dst = (char *)slot->iov.iov_base + slot->len;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = slot->file->fd;
+    sqe->off = (unsigned long long)(slot->off + (off_t)slot->len);
+    sqe->user_data = (unsigned long long)s;
+    if (r->fixed) {
+        sqe->opcode = IORING_OP_READ_FIXED;
+        sqe->addr = (unsigned long long)(uintptr_t)dst;
+        sqe->len = (unsigned)(CHUNK_SIZE - slot->len);
+        sqe->buf_index = (unsigned short)s;
+    } else {
+        /* READV is the one read opcode every io_uring kernel has */
+        slot->rest.iov_base = dst;
+        slot->rest.iov_len = CHUNK_SIZE - slot->len;
+        sqe->opcode = IORING_OP_READV;
+        sqe->addr = (unsigned long long)(uintptr_t)&slot->rest;
+        sqe->len = 1;
+    }
+    r->sq_array[idx] = idx;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->to_submit++;
+}
+
+/* Submit queued reads and wait for at least one completion */
+static int ring_wait(Ring *r) {
+    for (;;) {
+        int n = sys_io_uring_enter(r->fd, r->to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (n >= 0) {
+            r->to_submit -= (unsigned)n < r->to_submit ? (unsigned)n : r->to_submit;
+            return 0;
+        }
+        if (errno != EINTR) return -1;
+    }
+}
+
+/* ---- sequential fallback ---- */
+
+/* Read fd to the end with read(); a short read is not the end, only 0 is */
+static int read_fd_plain(int fd, int i, char *buf, const FileIoHandler *h) {
+    int err = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf, CHUNK_SIZE);
+        if (n > 0) {
+            h->chunk(h->ctx, i, buf, (size_t)n);
+        } else if (n == 0) {
+            break;
+        } else if (errno != EINTR) {
+            err = errno;
+            break;
+        }
+    }
+    return err;
+}
+
+static int read_one_plain(const char *path, int i, char *buf, const FileIoHandler *h) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return errno;
+    int err = read_fd_plain(fd, i, buf, h);
+    close(fd);
+    return err;
+}
+
+static int read_all_plain(const char *const *paths, int count, const FileIoHandler *h) {
+    char *buf = malloc(CHUNK_SIZE);
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        int err = buf ? read_one_plain(paths[i], i, buf, h) : ENOMEM;
+        if (err) failed++;
+        h->done(h->ctx, i, err);
+    }
+    free(buf);
+    return failed;
+}
+
+/* ---- io_uring path ---- */
+
+typedef struct {
+    Ring ring;
+    Slot slots[NUM_BUFFERS];
+    FileState files[ACTIVE_FILES];
+    char *buffers;
+    const char *const *paths;
+    int count;
+    int next_path;       /* next path to open */
+    int active;          /* files with index != -1 */
+    int failed;
+    const FileIoHandler *h;
+} Batch;
+
+static void finish_file(Batch *b, FileState *f) {
+    if (f->fd >= 0) close(f->fd);
+    if (f->err) b->failed++;
+    b->h->done(b->h->ctx, f->index, f->err);
+    f->index = -1;
+    f->fd = -1;
+    b->active--;
+}
+
+/* Open the next path into a free file state; failures finish right away */
+static void open_next(Batch *b) {
+    while (b->next_path < b->count && b->active < ACTIVE_FILES) {
+        FileState *f = NULL;
+        for (int k = 0; k < ACTIVE_FILES; k++) {
+            if (b->files[k].index == -1) {
+                f = &b->files[k];
+                break;
+            }
+        }
+        if (f == NULL) break;
+
+        int i = b->next_path++;
+        int fd = open(b->paths[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            int err = errno;
+            b->failed++;
+            b->h->done(b->h->ctx, i, err);
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            /* Pipes, FIFOs and terminals have no offsets to read at: read
+             * them through to EOF here */
+            char *buf = malloc(CHUNK_SIZE);
+            int err = buf ? read_fd_plain(fd, i, buf, b->h) : ENOMEM;
+            free(buf);
+            close(fd);
+            if (err) b->failed++;
+            b->h->done(b->h->ctx, i, err);
+            continue;
+        }
+        memset(f, 0, sizeof(*f));
+        f->index = i;
+        f->fd = fd;
+        f->size = st.st_size;
+        b->active++;
+    }
+}
+
+static int can_submit(const FileState *f) {
+    if (f->index == -1 || f->eof || f->err || f->inflight >= READS_PER_FILE) return 0;
+    /* Past the known size (or for /proc files, which report 0) read one
+     * at a time until a read returns 0 */
+    return f->submit_off < f->size || f->inflight == 0;
+}
+
+/* Hand over every buffer of f that is next in order; drop what lies past
+ * the end or behind an error. */
+static void deliver(Batch *b, FileState *f) {
+    int progress = 1;
+    while (progress) {
+        progress = 0;
+        for (int s = 0; s < NUM_BUFFERS; s++) {
+            Slot *slot = &b->slots[s];
+            if (slot->file != f || !slot->ready) continue;
+            int drop = f->err || (f->eof && slot->off >= f->eof_off);
+            if (!drop && slot->off != f->deliver_off) continue;
+            if (!drop) {
+                if (slot->len > 0) b->h->chunk(b->h->ctx, f->index, slot->iov.iov_base, slot->len);
+                f->deliver_off += (off_t)slot->len;
+                progress = 1;
+            }
+            slot->file = NULL;
+            slot->ready = 0;
+            f->inflight--;
+        }
+    }
+    if ((f->eof || f->err) && f->inflight == 0) finish_file(b, f);
+}
+
+static void complete(Batch *b, int s, int res) {
+    Slot *slot = &b->slots[s];
+    FileState *f = slot->file;
+    if (res < 0) {
+        if (!f->err) f->err = -res;
+        slot->len = 0;
+    } else {
+        slot->len += (size_t)res;
+        off_t end = slot->off + (off_t)slot->len;
+        if (slot->off >= f->size) {
+            /* One read at a time here: a short read (a /proc file, a file
+             * still growing) is not the end, only an empty one is */
+            f->submit_off = end;
+            if (res == 0) {
+                f->eof_off = slot->off;
+                f->eof = 1;
+            }
+        } else if (res == 0) {
+            /* The file shrank since fstat */
+            if (!f->eof || end < f->eof_off) f->eof_off = end;
+            f->eof = 1;
+        } else if (slot->len < CHUNK_SIZE && end < f->size) {
+            /* A short read inside the file (io_uring may return one, on
+             * network filesystems especially): read the rest */
+            ring_queue_read(&b->ring, b->slots, s);
+            return;
+        }
+    }
+    slot->ready = 1;
+    deliver(b, f);
+}
+
+static int read_all_uring(Batch *b) {
+    Ring *r = &b->ring;
+    int pos = 0;         /* round-robin start over the active files */
+
+    for (;;) {
+        open_next(b);
+
+        /* Give each free buffer to the next file that can use one */
+        for (int s = 0; s < NUM_BUFFERS; s++) {
+            if (b->slots[s].file) continue;
+            FileState *f = NULL;
+            for (int k = 0; k < ACTIVE_FILES && !f; k++) {
+                FileState *cand = &b->files[(pos + k) % ACTIVE_FILES];
+                if (can_submit(cand)) f = cand;
+            }
+            if (!f) break;
+            pos = (int)(f - b->files) + 1;
+            Slot *slot = &b->slots[s];
+            slot->file = f;
+            slot->off = f->submit_off;
+            slot->len = 0;
+            slot->ready = 0;
+            f->submit_off += CHUNK_SIZE;
+            f->inflight++;
+            ring_queue_read(r, b->slots, s);
+        }
+
+        if (b->active == 0 && b->next_path >= b->count) return 0;
+        if (ring_wait(r) != 0) return -1;
+
+        unsigned head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            int s = (int)cqe->user_data;
+            int res = cqe->res;
+            head++;
+            __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+            complete(b, s, res);
+        }
+    }
+}
+
+static int batch_init(Batch *b) {
+    memset(b, 0, sizeof(*b));
+    b->buffers = mmap(NULL, (size_t)NUM_BUFFERS * CHUNK_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->buffers == MAP_FAILED) return -1;
+    if (ring_open(&b->ring, NUM_BUFFERS) != 0) {
+        munmap(b->buffers, (size_t)NUM_BUFFERS * CHUNK_SIZE);
+        return -1;
+    }
+    for (int s = 0; s < NUM_BUFFERS; s++) {
+        b->slots[s].iov.iov_base = b->buffers + (size_t)s * CHUNK_SIZE;
+        b->slots[s].iov.iov_len = CHUNK_SIZE;
+    }
+    for (int k = 0; k < ACTIVE_FILES; k++) {
+        b->files[k].index = -1;
+        b->files[k].fd = -1;
+    }
+
+    /* Registered buffers skip the per-read page pinning; they count
+     * against RLIMIT_MEMLOCK, so carry on with READV when refused */
+    struct iovec iovs[NUM_BUFFERS];
+    for (int s = 0; s < NUM_BUFFERS; s++) iovs[s] = b->slots[s].iov;
+    b->ring.fixed = sys_io_uring_register(b->ring.fd, IORING_REGISTER_BUFFERS,
+                                          iovs, NUM_BUFFERS) == 0;
+    return 0;
+}
+
+static void batch_free(Batch *b) {
+    ring_close(&b->ring);
+    munmap(b->buffers, (size_t)NUM_BUFFERS * CHUNK_SIZE);
+}
+
+/* -1 unknown, 0 unavailable, 1 available */
+static int uring_state = -1;
+
+int file_io_read(const char *const *paths, int count, const FileIoHandler *h) {
+    if (count <= 0) return 0;
+    if (uring_state != 0) {
+        Batch b;
+        if (batch_init(&b) == 0) {
+            uring_state = 1;
+            b.paths = paths;
+            b.count = count;
+            b.h = h;
+            int rc = read_all_uring(&b);
+            if (rc != 0) {
+                /* The ring broke mid-way: fail what was still open */
+                for (int k = 0; k < ACTIVE_FILES; k++) {
+                    FileState *f = &b.files[k];
+                    if (f->index == -1) continue;
+                    if (!f->err) f->err = errno ? errno : EIO;
+                    finish_file(&b, f);
+                }
+                for (int i = b.next_path; i < count; i++) {
+                    b.failed++;
+                    h->done(h->ctx, i, EIO);
+                }
+            }
+            batch_free(&b);
+            return b.failed;
+        }
+        uring_state = 0;
+    }
+    return read_all_plain(paths, count, h);
+}
+
+const char *file_io_backend(void) {
+    if (uring_state == -1) {
+        Ring r;
+        uring_state = ring_open(&r, 1) == 0;
+        if (uring_state) ring_close(&r);
+    }
+    return uring_state ? "io_uring" : "read";
+}
@@ -0,0 +1,27 @@
+// file_io.h
+// Batched whole-file reads for the file-reading builtins. Several files are
+// read at once with a few reads in flight per file, through io_uring when the
+// kernel allows it and plain read() otherwise; each file's data still reaches
+// the caller in order.
+
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stddef.h>
+
+typedef struct {
+    /* Next piece of file i, in file order (never called with len 0) */
+    void (*chunk)(void *ctx, int i, const char *data, size_t len);
+    /* File i is finished; err is 0 or the errno of the failed open/read */
+    void (*done)(void *ctx, int i, int err);
+    void *ctx;
+} FileIoHandler;
+
+/* Read every file of paths to the end. Files may finish in any order.
+ * Returns the number of files that failed. */
+int file_io_read(const char *const *paths, int count, const FileIoHandler *h);
+
+/* "io_uring" or "read": the backend file_io_read would use right now */
+const char *file_io_backend(void);
+
+#endif // FILE_IO_H
@@ -0,0 +1,426 @@
+// glob_expand.c
+// Wildcard expansion for command words.
+//
+// Directories are read with getdents64 (dir_read.c) into one name buffer
+// per directory and kept in a hash table for the rest of the command line, so `*.c *.h`
+// or `src/*/x src/*/y` read each directory once. Matches are appended to
+// the ArgList arena and sorted once per pattern.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "glob_expand.h"
+#include "dir_read.h"
+
+#define MAX_COMPONENTS 128
+
+typedef struct {
+    char *path;          /* key: directory as opened ("." for the cwd) */
+    int ok;              /* 0 if the directory could not be read */
+    DirList list;
+} DirListing;
+
+struct GlobCache {
+    DirListing **slots;  /* open addressing, power-of-two size */
+    size_t cap;
+    size_t used;
+};
+
+typedef struct {
+    GlobCache *cache;
+    ArgList *out;
+    char *comps[MAX_COMPONENTS];
+    int ncomps;
+    int absolute;
+    int must_dir;        /* pattern ended in '/' */
+    int failed;
+} Expansion;
+
+/* ---- argv arena ---- */
+
+void arglist_init(ArgList *list) {
+    memset(list, 0, sizeof(*list));
+}
+
+int arglist_add(ArgList *list, const char *word, size_t len) {
+    if (list->used + len + 1 > list->cap) {
+        size_t cap = list->cap ? list->cap : 4096;
+        while (cap < list->used + len + 1) cap *= 2;
+        char *arena = realloc(list->arena, cap);
+        if (!arena) return -1;
+        list->arena = arena;
+        list->cap = cap;
+    }
+    if (list->count == list->offsets_cap) {
+        int cap = list->offsets_cap ? list->offsets_cap * 2 : 64;
+        size_t *offsets = realloc(list->offsets, cap * sizeof(size_t));
+        if (!offsets) return -1;
+        list->offsets = offsets;
+        list->offsets_cap = cap;
+    }
+    list->offsets[list->count++] = list->used;
+    memcpy(list->arena + list->used, word, len);
+    list->arena[list->used + len] = '\0';
+    list->used += len + 1;
+    return 0;
+}
+
+char **arglist_finish(ArgList *list) {
+    free(list->argv);
+    list->argv = malloc((list->count + 1) * sizeof(char *));
+    if (!list->argv) return NULL;
+    for (int i = 0; i < list->count; i++) {
+        list->argv[i] = list->arena + list->offsets[i];
+    }
+    list->argv[list->count] = NULL;
+    return list->argv;
+}
+
+void arglist_free(ArgList *list) {
+    free(list->arena);
+    free(list->offsets);
+    free(list->argv);
+    arglist_init(list);
+}
+
+/* ---- directory cache ---- */
+
+GlobCache *glob_cache_new(void) {
+    GlobCache *cache = calloc(1, sizeof(GlobCache));
+    if (!cache) return NULL;
+    cache->cap = 64;
+    cache->slots = calloc(cache->cap, sizeof(DirListing *));
+    if (!cache->slots) {
+        free(cache);
+        return NULL;
+    }
+    return cache;
+}
+
+static void listing_free(DirListing *l) {
+    free(l->path);
+    dir_list_free(&l->list);
+    free(l);
+}
+
+void glob_cache_free(GlobCache *cache) {
+    if (!cache) return;
+    for (size_t i = 0; i < cache->cap; i++) {
+        if (cache->slots[i]) listing_free(cache->slots[i]);
+    }
+    free(cache->slots);
+    free(cache);
+}
+
+static size_t hash_path(const char *s) {
+    size_t h = 1469598103934665603ULL;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static int cache_grow(GlobCache *cache) {
+    size_t cap = cache->cap * 2;
+    DirListing **slots = calloc(cap, sizeof(DirListing *));
+    if (!slots) return -1;
+    for (size_t i = 0; i < cache->cap; i++) {
+        DirListing *l = cache->slots[i];
+        if (!l) continue;
+        size_t j = hash_path(l->path) & (cap - 1);
+        while (slots[j]) j = (j + 1) & (cap - 1);
+        slots[j] = l;
+    }
+    free(cache->slots);
+    cache->slots = slots;
+    cache->cap = cap;
+    return 0;
+}
+
+static void listing_read(DirListing *l) {
+    int fd = open(l->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return;
+    l->ok = dir_read_fd(fd, &l->list, 0) == 0;
+    close(fd);
+}
+
+/* Listing of dir, read at most once per cache (failures are cached too) */
+static DirListing *cache_lookup(GlobCache *cache, const char *dir) {
+    if (cache->used * 2 >= cache->cap && cache_grow(cache) != 0) return NULL;
+
+    size_t i = hash_path(dir) & (cache->cap - 1);
+    while (cache->slots[i]) {
+        if (strcmp(cache->slots[i]->path, dir) == 0) return cache->slots[i];
+        i = (i + 1) & (cache->cap - 1);
+    }
+
+    DirListing *l = calloc(1, sizeof(DirListing));
+    if (!l) return NULL;
+    l->path = strdup(dir);
+    if (!l->path) {
+        free(l);
+        return NULL;
+    }
+    listing_read(l);
+    cache->slots[i] = l;
+    cache->used++;
+    return l;
+}
+
+/* ---- matching ---- */
+
+int glob_has_magic(const char *word) {
+    for (const char *p = word; *p; p++) {
+        if (*p == '*' || *p == '?') return 1;
+        if (*p == '[' && strchr(p + 1, ']')) return 1;
+    }
+    return 0;
+}
+
+/* Match c against the class starting at *pp ('[' already consumed).
+ * Returns 1/0, or -1 if the class is unterminated (then '[' is literal). */
+static int match_class(const char **pp, unsigned char c) {
+    const char *p = *pp;
+    int negate = 0, matched = 0;
+    if (*p == '!' || *p == '^') {
+        negate = 1;
+        p++;
+    }
+    int first = 1;
+    while (*p && (first || *p != ']')) {
+        unsigned char lo = (unsigned char)*p;
+        if (lo == '\\' && p[1]) lo = (unsigned char)*++p;
+        unsigned char hi = lo;
+        if (p[1] == '-' && p[2] && p[2] != ']') {
+            hi = (unsigned char)p[2];
+            p += 2;
+        }
+        if (c >= lo && c <= hi) matched = 1;
+        p++;
+        first = 0;
+    }
+    if (*p != ']') return -1;
+    *pp = p + 1;
+    return matched != negate;
+}
+
+/* Match name against one path component pattern. Single backtracking
+ * point for '*', so the cost stays linear for typical patterns. */
+int glob_match(const char *p, const char *s) {
+    const char *star_p = NULL, *star_s = NULL;
+
+    while (*s) {
+        if (*p == '*') {
+            while (*p == '*') p++;
+            if (!*p) return 1;
+            star_p = p;
+            star_s = s;
+            continue;
+        }
+        if (*p == '?') {
+            p++;
+            s++;
+            continue;
+        }
+        if (*p == '[') {
+            const char *q = p + 1;
+            int r = match_class(&q, (unsigned char)*s);
+            if (r == 1) {
+                p = q;
+                s++;
+                continue;
+            }
+            if (r == -1 && *s == '[') {
+                p++;
+                s++;
+                continue;
+            }
+        } else {
+            const char *lit = p;
+            if (*lit == '\\' && lit[1]) lit++;
+            if (*lit && *lit == *s) {
+                p = lit + 1;
+                s++;
+                continue;
+            }
+        }
+        if (!star_p) return 0;
+        p = star_p;
+        s = ++star_s;
+    }
+    while (*p == '*') p++;
+    return *p == '\0';
+}
+
+/* ---- expansion ---- */
+
+static int is_dir_entry(const char *path, const DirEntry *e, int follow) {
+    if (e->type == DT_DIR) return 1;
+    if (e->type != DT_UNKNOWN && !(follow && e->type == DT_LNK)) return 0;
+    struct stat st;
+    int r = follow ? stat(path, &st) : lstat(path, &st);
+    return r == 0 && S_ISDIR(st.st_mode);
+}
+
+static void emit(Expansion *x, const char *path, size_t len) {
+    if (x->must_dir) {
+        char with_slash[PATH_MAX + 1];
+        if (len + 1 >= sizeof(with_slash)) return;
+        memcpy(with_slash, path, len);
+        with_slash[len] = '/';
+        if (arglist_add(x->out, with_slash, len + 1) != 0) x->failed = 1;
+        return;
+    }
+    if (arglist_add(x->out, path, len) != 0) x->failed = 1;
+}
+
+/* Append a component to path; returns the new length or 0 if too long */
+static size_t path_join(char *path, size_t len, const char *name) {
+    size_t n = strlen(name);
+    size_t sep = (len > 0 && path[len - 1] != '/') ? 1 : 0;
+    if (len + sep + n + 1 > PATH_MAX) return 0;
+    if (sep) path[len] = '/';
+    memcpy(path + len + sep, name, n + 1);
+    return len + sep + n;
+}
+
+static void expand_from(Expansion *x, char *path, size_t len, int ci);
+
+/* ** : zero or more directory levels, hidden directories excluded */
+static void expand_globstar(Expansion *x, char *path, size_t len, int ci) {
+    int last = ci == x->ncomps - 1;
+    if (!last) {
+        expand_from(x, path, len, ci + 1);
+        path[len] = '\0';
+    }
+
+    DirListing *l = cache_lookup(x->cache, len ? path : ".");
+    if (!l || !l->ok) return;
+    for (size_t i = 0; i < l->list.count && !x->failed; i++) {
+        const DirEntry *e = &l->list.entries[i];
+        const char *name = l->list.names + e->name;
+        if (name[0] == '.') continue;
+        size_t n = path_join(path, len, name);
+        if (!n) continue;
+        int dir = is_dir_entry(path, e, 0);
+        if (last && (dir || !x->must_dir)) emit(x, path, n);
+        if (dir) expand_globstar(x, path, n, ci);
+        path[len] = '\0';
+    }
+}
+
+static void expand_from(Expansion *x, char *path, size_t len, int ci) {
+    if (x->failed) return;
+
+    /* Literal components need no directory read */
+    int literal_tail = 0;
+    while (ci < x->ncomps && !glob_has_magic(x->comps[ci])) {
+        size_t n = path_join(path, len, x->comps[ci]);
+        if (!n) return;
+        len = n;
+        ci++;
+        literal_tail = 1;
+    }
+
+    if (ci == x->ncomps) {
+        struct stat st;
+        if (literal_tail && (x->must_dir ? stat(path, &st) != 0 || !S_ISDIR(st.st_mode)
+                                         : lstat(path, &st) != 0)) {
+            return;
+        }
+        emit(x, path, len);
+        return;
+    }
+
+    if (strcmp(x->comps[ci], "**") == 0) {
+        expand_globstar(x, path, len, ci);
+        return;
+    }
+
+    DirListing *l = cache_lookup(x->cache, len ? path : ".");
+    if (!l || !l->ok) return;
+
+    int last = ci == x->ncomps - 1;
+    for (size_t i = 0; i < l->list.count && !x->failed; i++) {
+        const DirEntry *e = &l->list.entries[i];
+        const char *name = l->list.names + e->name;
+        /* Wildcards never match a leading dot */
+        if (name[0] == '.' && x->comps[ci][0] != '.') continue;
+        if (!glob_match(x->comps[ci], name)) continue;
+
+        /* Entries known not to be directories cannot lead anywhere */
+        if (!last && e->type != DT_DIR && e->type != DT_LNK && e->type != DT_UNKNOWN) continue;
+
+        size_t n = path_join(path, len, name);
+        if (!n) continue;
+        if (last) {
+            if (!x->must_dir || is_dir_entry(path, e, 1)) emit(x, path, n);
+        } else {
+            expand_from(x, path, n, ci + 1);
+        }
+        path[len] = '\0';
+    }
+}
+
+static const char *sort_arena;
+
+static int cmp_offsets(const void *a, const void *b) {
+    return strcmp(sort_arena + *(const size_t *)a, sort_arena + *(const size_t *)b);
+}
+
+int glob_expand_word(GlobCache *cache, const char *pattern, ArgList *list) {
+    size_t plen = strlen(pattern);
+    if (!cache || !glob_has_magic(pattern) || plen >= PATH_MAX) {
+        return arglist_add(list, pattern, plen) == 0 ? 1 : -1;
+    }
+
+    /* Split into components; runs of '/' collapse */
+    char *copy = strdup(pattern);
+    if (!copy) return -1;
+    Expansion x = { .cache = cache, .out = list };
+    x.absolute = pattern[0] == '/';
+    x.must_dir = plen > 1 && pattern[plen - 1] == '/';
+    char *save = NULL;
+    for (char *c = strtok_r(copy, "/", &save); c; c = strtok_r(NULL, "/", &save)) {
+        if (x.ncomps == MAX_COMPONENTS) {
+            free(copy);
+            return arglist_add(list, pattern, plen) == 0 ? 1 : -1;
+        }
+        x.comps[x.ncomps++] = c;
+    }
+
+    char path[PATH_MAX + 1];
+    size_t len = 0;
+    if (x.absolute) path[len++] = '/';
+    path[len] = '\0';
+
+    int first = list->count;
+    expand_from(&x, path, len, 0);
+    free(copy);
+    if (x.failed) return -1;
+
+    int added = list->count - first;
+    if (added == 0) {
+        return arglist_add(list, pattern, plen) == 0 ? 1 : -1;
+    }
+
+    /* Sorted, and without the duplicates several ** can produce */
+    sort_arena = list->arena;
+    qsort(list->offsets + first, added, sizeof(size_t), cmp_offsets);
+    int kept = first + 1;
+    for (int i = first + 1; i < list->count; i++) {
+        if (strcmp(list->arena + list->offsets[i], list->arena + list->offsets[kept - 1]) != 0) {
+            list->offsets[kept++] = list->offsets[i];
+        }
+    }
+    list->count = kept;
+    return kept - first;
+}
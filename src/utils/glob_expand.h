@@ -0,0 +1,47 @@
+// glob_expand.h
+// Wildcard expansion for command words (*, ?, [...] and ** across
+// directories) and the argv builder it fills.
+//
+// All words of a command are stored back to back in one arena; argv is
+// built once at the end, so a pattern matching 100k files costs one growing
+// buffer rather than 100k small allocations.
+
+#ifndef GLOB_EXPAND_H
+#define GLOB_EXPAND_H
+
+#include <stddef.h>
+
+typedef struct {
+    char *arena;         /* NUL-terminated words, back to back */
+    size_t used;
+    size_t cap;
+    size_t *offsets;     /* start of each word in the arena */
+    int count;
+    int offsets_cap;
+    char **argv;         /* filled by arglist_finish */
+} ArgList;
+
+/* Directory listings read while expanding one command line. Patterns that
+ * touch the same directory share a single read of it. */
+typedef struct GlobCache GlobCache;
+
+GlobCache *glob_cache_new(void);
+void glob_cache_free(GlobCache *cache);
+
+void arglist_init(ArgList *list);
+int arglist_add(ArgList *list, const char *word, size_t len);
+/* NULL-terminated argv pointing into the arena (valid until arglist_free) */
+char **arglist_finish(ArgList *list);
+void arglist_free(ArgList *list);
+
+/* Does word contain wildcard characters? */
+int glob_has_magic(const char *word);
+
+/* Match one name against a pattern without '/' (no leading-dot rule) */
+int glob_match(const char *pattern, const char *name);
+
+/* Append the sorted matches of pattern to list, or the pattern itself when
+ * nothing matches. Returns the number of words added, -1 on allocation failure. */
+int glob_expand_word(GlobCache *cache, const char *pattern, ArgList *list);
+
+#endif // GLOB_EXPAND_H
@@ -0,0 +1,126 @@
+// heredoc.c
+// Here-document parsing and the memfd they are served from. The memfd is
+// sealed against writes and resizing before anyone else sees it, so the
+// command reads exactly the text the shell wrote.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "heredoc.h"
+
+/* One past the (( ... )) starting at p, as the parser reads it: balanced
+ * parentheses (the end of the line if they never close) */
+static const char *arith_end(const char *p) {
+    int depth = 0;
+    for (; *p != '\0'; p++) {
+        if (*p == '(') depth++;
+        else if (*p == ')' && --depth == 0) return p + 1;
+    }
+    return p;
+}
+
+int heredoc_scan(const char *line, HereDocSpec *specs, int max) {
+    int n = 0;
+    for (const char *p = line; *p != '\0' && n < max;) {
+        /* << inside $(( )) or (( )) is a shift, inside quotes text */
+        if (p[0] == '(' && p[1] == '(') {
+            p = arith_end(p);
+            continue;
+        }
+        if (p[0] == '\'' || p[0] == '"') {
+            const char *close = strchr(p + 1, p[0]);
+            p = close != NULL ? close + 1 : p + strlen(p);
+            continue;
+        }
+        if (p[0] != '<' || p[1] != '<') {
+            p++;
+            continue;
+        }
+        if (p[2] == '<') {
+            /* Here-string: skip the whole <<< operator */
+            p += 3;
+            while (*p == '<') p++;
+            continue;
+        }
+        p += 2;
+        HereDocSpec *spec = &specs[n];
+        spec->strip_tabs = *p == '-';
+        if (spec->strip_tabs) p++;
+        while (*p == ' ' || *p == '\t') p++;
+
+        /* The delimiter is one word; quotes around it are dropped */
+        size_t len = 0;
+        while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '|' && *p != '&' && *p != ';') {
+            if (*p != '\'' && *p != '"' && len + 1 < sizeof(spec->delim)) spec->delim[len++] = *p;
+            p++;
+        }
+        spec->delim[len] = '\0';
+        if (len > 0) n++;
+    }
+    return n;
+}
+
+void heredoc_split(const char *line, char *text, HereDocs *docs) {
+    HereDocSpec specs[HEREDOC_MAX];
+    int n = heredoc_scan(line, specs, HEREDOC_MAX);
+    char *r = text, *w = text;
+    char end_of_text = '\0';
+
+    docs->count = 0;
+    docs->next = 0;
+    for (int i = 0; i < n; i++) {
+        char *start = w;
+        while (*r != '\0') {
+            char *nl = strchr(r, '\n');
+            size_t len = nl ? (size_t)(nl - r) : strlen(r);
+            if (specs[i].strip_tabs) {
+                while (len > 0 && *r == '\t') {
+                    r++;
+                    len--;
+                }
+            }
+            int is_delim = len == strlen(specs[i].delim) && strncmp(r, specs[i].delim, len) == 0;
+            char *next = nl ? nl + 1 : &end_of_text;
+            if (!is_delim) {
+                /* Compact in place: w never runs ahead of r (the newline
+                 * added to an unterminated last line may land on its NUL,
+                 * hence next is taken first) */
+                memmove(w, r, len);
+                w += len;
+                *w++ = '\n';
+            }
+            r = next;
+            if (is_delim) break;
+        }
+        docs->data[i] = start;
+        docs->len[i] = (size_t)(w - start);
+        docs->count++;
+    }
+}
+
+int heredoc_memfd(const char *data, size_t len) {
+    int fd = memfd_create("heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        perror("memfd_create");
+        return -1;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write(fd, data + done, len - done);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("heredoc");
+            close(fd);
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    /* Sealing is best effort: the data is already complete either way */
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
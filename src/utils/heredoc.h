@@ -0,0 +1,42 @@
+// heredoc.h
+// Here-documents (<<WORD, <<-WORD) and here-strings (<<<word). The input
+// text is placed in a sealed memfd that becomes the command's stdin, so
+// inline data never touches the disk and needs no extra "echo |" process.
+//
+// A command line with here-documents arrives at the executor as one string:
+// the command on the first line, followed by each document's lines and its
+// closing delimiter line, in the order the << operators appear.
+
+#ifndef HEREDOC_H
+#define HEREDOC_H
+
+#include <stddef.h>
+
+#define HEREDOC_MAX 8
+
+typedef struct {
+    char delim[64];
+    int strip_tabs;      /* <<- removes leading tabs from every line */
+} HereDocSpec;
+
+typedef struct HereDocs {
+    const char *data[HEREDOC_MAX];
+    size_t len[HEREDOC_MAX];
+    int count;
+    int next;            /* next document to hand out */
+} HereDocs;
+
+/* Find the << operators (not <<<) of one command line. Returns how many
+ * were stored in specs (at most max). */
+int heredoc_scan(const char *line, HereDocSpec *specs, int max);
+
+/* Cut text (everything after the command line) into the documents opened
+ * by line, in place. A missing delimiter ends the document at the end of
+ * text. */
+void heredoc_split(const char *line, char *text, HereDocs *docs);
+
+/* Sealed, read-only memfd holding data, positioned at the start.
+ * Returns the fd (close-on-exec) or -1 with a message printed. */
+int heredoc_memfd(const char *data, size_t len);
+
+#endif // HEREDOC_H
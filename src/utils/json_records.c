@@ -0,0 +1,292 @@
+// json_records.c
+// --json records (see json_records.h). fd 1 and 2 are replaced by pipes at
+// open; the relay thread moves what arrives to the original descriptors and
+// counts it. At the end of a command the shell waits until both pipes are
+// empty and the relay idle, so the byte counts cover exactly that command.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "json_records.h"
+
+#define RECORD_MAX 8192
+#define COMMAND_MAX 4096     /* escaped command text kept in a record */
+#define RESULTS_MAX 8
+#define RELAY_CHUNK 65536
+
+typedef struct {
+    int in;              /* read end of the pipe now on fd 1 or 2 */
+    int out;             /* where the output really goes */
+    int use_splice;
+    unsigned long long bytes;
+} Stream;
+
+static int record_fd = -1;
+static Stream streams[2];
+static pthread_mutex_t relay_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t relay_idle = PTHREAD_COND_INITIALIZER;
+static int relay_busy = 0;
+
+/* The record being built */
+static char record[RECORD_MAX];
+static char command_text[COMMAND_MAX];
+static size_t command_len;
+static struct {
+    const char *key;
+    long long value;
+} results[RESULTS_MAX];
+static int nresults;
+static unsigned long long seq;
+static struct timespec started;
+static unsigned long long bytes_at_begin[2];
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Forward what is readable on s; bytes moved, 0 at EOF */
+static ssize_t relay_once(Stream *s) {
+    static char buf[RELAY_CHUNK];
+    if (s->use_splice) {
+        ssize_t n = splice(s->in, NULL, s->out, NULL, RELAY_CHUNK, SPLICE_F_MOVE);
+        if (n >= 0 || errno == EINTR) return n < 0 ? 1 : n;
+        /* Terminals and some files cannot be spliced to */
+        s->use_splice = 0;
+    }
+    ssize_t n = read(s->in, buf, sizeof(buf));
+    if (n < 0) return errno == EINTR ? 1 : 0;
+    if (n > 0) write_all(s->out, buf, (size_t)n);
+    return n;
+}
+
+static void *relay_main(void *arg) {
+    (void)arg;
+    struct pollfd fds[2] = { { streams[0].in, POLLIN, 0 }, { streams[1].in, POLLIN, 0 } };
+    int open_streams = 2;
+    while (open_streams > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].revents == 0) continue;
+            pthread_mutex_lock(&relay_lock);
+            relay_busy = 1;
+            pthread_mutex_unlock(&relay_lock);
+            ssize_t n = relay_once(&streams[i]);
+            pthread_mutex_lock(&relay_lock);
+            if (n > 0) streams[i].bytes += (unsigned long long)n;
+            relay_busy = 0;
+            pthread_cond_broadcast(&relay_idle);
+            pthread_mutex_unlock(&relay_lock);
+            if (n == 0) {
+                fds[i].fd = -1;
+                open_streams--;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Point fd (1 or 2) at a new pipe drained by the relay */
+static int redirect_stream(Stream *s, int fd) {
+    int p[2];
+    if (pipe2(p, O_CLOEXEC) != 0) return -1;
+    s->out = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+    if (s->out < 0 || dup2(p[1], fd) < 0) {
+        close(p[0]);
+        close(p[1]);
+        return -1;
+    }
+    close(p[1]);
+    s->in = p[0];
+    s->use_splice = 1;
+    s->bytes = 0;
+    return 0;
+}
+
+int json_records_open(int fd) {
+    if (fcntl(fd, F_GETFD) < 0) {
+        fprintf(stderr, "--json: fd %d is not open\n", fd);
+        return -1;
+    }
+    /* The record fd is the shell's, not the commands': keep a close-on-exec
+     * copy above 2, so --json=1 still records to the original stdout */
+    int copy = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+    if (copy < 0) {
+        perror("--json");
+        return -1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    if (redirect_stream(&streams[0], STDOUT_FILENO) != 0 || redirect_stream(&streams[1], STDERR_FILENO) != 0) {
+        perror("--json");
+        close(copy);
+        return -1;
+    }
+    if (fd > STDERR_FILENO) close(fd);
+    pthread_t relay;
+    if (pthread_create(&relay, NULL, relay_main, NULL) != 0) {
+        perror("--json: pthread_create");
+        return -1;
+    }
+    pthread_detach(relay);
+    record_fd = copy;
+    return 0;
+}
+
+int json_records_enabled(void) {
+    return record_fd >= 0;
+}
+
+/* Wait until everything written so far has been forwarded */
+static void relay_sync(void) {
+    fflush(stdout);
+    fflush(stderr);
+    pthread_mutex_lock(&relay_lock);
+    for (;;) {
+        int pending = 0, n;
+        for (int i = 0; i < 2; i++) {
+            if (ioctl(streams[i].in, FIONREAD, &n) == 0 && n > 0) pending = 1;
+        }
+        if (!pending && !relay_busy) break;
+        /* The relay may not have woken yet: re-check after a short wait */
+        struct timespec until;
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += 200000;
+        if (until.tv_nsec >= 1000000000L) {
+            until.tv_sec++;
+            until.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&relay_idle, &relay_lock, &until);
+    }
+    pthread_mutex_unlock(&relay_lock);
+}
+
+static unsigned long long stream_bytes(int i) {
+    pthread_mutex_lock(&relay_lock);
+    unsigned long long n = streams[i].bytes;
+    pthread_mutex_unlock(&relay_lock);
+    return n;
+}
+
+/* Bytes in the valid UTF-8 sequence at s (s[0] >= 0x80); 0 when s does
+ * not start one (a stray, overlong, surrogate or cut-off sequence) */
+static size_t utf8_length(const char *s) {
+    unsigned char c = (unsigned char)*s, c1 = (unsigned char)s[1];
+    size_t n = c >= 0xf0 && c <= 0xf4 ? 4 : c >= 0xe0 && c < 0xf0 ? 3 : c >= 0xc2 && c < 0xe0 ? 2 : 0;
+    /* Second-byte ranges that rule out overlong forms, surrogates and
+     * code points past U+10FFFF */
+    if ((c == 0xe0 && c1 < 0xa0) || (c == 0xed && c1 >= 0xa0) || (c == 0xf0 && c1 < 0x90) ||
+        (c == 0xf4 && c1 >= 0x90)) {
+        return 0;
+    }
+    for (size_t k = 1; k < n; k++) {
+        if (((unsigned char)s[k] & 0xc0) != 0x80) return 0;
+    }
+    return n;
+}
+
+/* JSON string body for s, cut to fit COMMAND_MAX at a character boundary */
+static void escape_command(const char *s) {
+    size_t len = 0;
+    for (; *s != '\0' && len + 8 < COMMAND_MAX; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x80) {
+            /* Invalid bytes would make the record invalid JSON */
+            size_t n = utf8_length(s);
+            if (n == 0) {
+                len += (size_t)snprintf(command_text + len, COMMAND_MAX - len, "\\ufffd");
+                continue;
+            }
+            if (len + n + 8 >= COMMAND_MAX) break;
+            memcpy(command_text + len, s, n);
+            len += n;
+            s += n - 1;
+            continue;
+        }
+        if (c == '"' || c == '\\') {
+            command_text[len++] = '\\';
+            command_text[len++] = (char)c;
+        } else if (c == '\n') {
+            command_text[len++] = '\\';
+            command_text[len++] = 'n';
+        } else if (c == '\t') {
+            command_text[len++] = '\\';
+            command_text[len++] = 't';
+        } else if (c < 0x20) {
+            len += (size_t)snprintf(command_text + len, COMMAND_MAX - len, "\\u%04x", c);
+        } else {
+            command_text[len++] = (char)c;
+        }
+    }
+    command_len = len;
+}
+
+void json_records_begin(const char *command) {
+    if (record_fd < 0) return;
+    escape_command(command);
+    nresults = 0;
+    relay_sync();
+    bytes_at_begin[0] = stream_bytes(0);
+    bytes_at_begin[1] = stream_bytes(1);
+    clock_gettime(CLOCK_MONOTONIC, &started);
+}
+
+void json_records_add(const char *key, long long value) {
+    if (record_fd < 0) return;
+    for (int i = 0; i < nresults; i++) {
+        if (strcmp(results[i].key, key) == 0) {
+            results[i].value += value;
+            return;
+        }
+    }
+    if (nresults < RESULTS_MAX) {
+        results[nresults].key = key;
+        results[nresults++].value = value;
+    }
+}
+
+void json_records_end(int status) {
+    if (record_fd < 0) return;
+    struct timespec done;
+    clock_gettime(CLOCK_MONOTONIC, &done);
+    relay_sync();
+    long long us = (done.tv_sec - started.tv_sec) * 1000000LL + (done.tv_nsec - started.tv_nsec) / 1000;
+
+    int len = snprintf(record, sizeof(record),
+                       "{\"seq\":%llu,\"command\":\"%.*s\",\"status\":%d,\"duration_us\":%lld,"
+                       "\"stdout_bytes\":%llu,\"stderr_bytes\":%llu",
+                       ++seq, (int)command_len, command_text, status < 0 ? 1 : status, us,
+                       stream_bytes(0) - bytes_at_begin[0], stream_bytes(1) - bytes_at_begin[1]);
+    if (nresults > 0) {
+        len += snprintf(record + len, sizeof(record) - (size_t)len, ",\"result\":{");
+        for (int i = 0; i < nresults; i++) {
+            len += snprintf(record + len, sizeof(record) - (size_t)len, "%s\"%s\":%lld", i ? "," : "",
+                            results[i].key, results[i].value);
+        }
+        len += snprintf(record + len, sizeof(record) - (size_t)len, "}");
+    }
+    len += snprintf(record + len, sizeof(record) - (size_t)len, "}\n");
+    if (write_all(record_fd, record, (size_t)len) != 0) {
+        perror("--json");
+        record_fd = -1;
+    }
+}
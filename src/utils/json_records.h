@@ -0,0 +1,29 @@
+// json_records.h
+// Structured results for automation (--json): one compact JSON object per
+// executed command line, written to a dedicated fd (3 unless chosen):
+//
+//   {"seq":1,"command":"count a.txt","status":0,"duration_us":412,
+//    "stdout_bytes":74,"stderr_bytes":0,"result":{"lines":3,"words":9,...}}
+//
+// stdout and stderr keep going where they went, through pipes that a relay
+// thread forwards (splice() where the target allows it) and counts. Records
+// are formatted in a fixed buffer: no allocation per command.
+
+#ifndef JSON_RECORDS_H
+#define JSON_RECORDS_H
+
+/* Start recording to fd; 0 on success */
+int json_records_open(int fd);
+
+/* Is --json active? */
+int json_records_enabled(void);
+
+/* Bracket one command line */
+void json_records_begin(const char *command);
+void json_records_end(int status);
+
+/* Attach a builtin's result to the current record ("lines", 42); ignored
+ * outside --json. key must outlive the record (a string literal). */
+void json_records_add(const char *key, long long value);
+
+#endif // JSON_RECORDS_H
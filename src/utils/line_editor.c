@@ -0,0 +1,367 @@
+// line_editor.c
+// Minimal raw-mode line editor. The whole line is redrawn from the prompt on
+// every change (one write per refresh), scrolling horizontally when it does
+// not fit the terminal width.
+//
+// Keys: printable insert, Backspace/Delete, Left/Right, Home/End,
+// Ctrl-A/E (start/end), Ctrl-U/K (kill to start/end), Ctrl-W (kill word),
+// Ctrl-L (clear screen), Ctrl-C (discard line), Ctrl-D (EOF on empty line),
+// Tab (complete; a second Tab lists the candidates).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include "line_editor.h"
+#include "completion.h"
+
+#define MAX_LISTED 200
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    size_t pos;
+    const char *prompt;
+    size_t prompt_width;
+    int cols;
+} LineState;
+
+static struct termios saved_termios;
+static int raw_enabled = 0;
+static int atexit_registered = 0;
+
+static void disable_raw_mode(void) {
+    if (raw_enabled) {
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &saved_termios);
+        raw_enabled = 0;
+    }
+}
+
+static int enable_raw_mode(void) {
+    struct termios raw;
+    if (tcgetattr(STDIN_FILENO, &saved_termios) != 0) return -1;
+    if (!atexit_registered) {
+        atexit(disable_raw_mode);
+        atexit_registered = 1;
+    }
+    raw = saved_termios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) != 0) return -1;
+    raw_enabled = 1;
+    return 0;
+}
+
+static int terminal_columns(void) {
+    struct winsize ws;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
+    return 80;
+}
+
+/* Columns the prompt occupies: escape sequences and UTF-8 continuation bytes
+ * take no space */
+static size_t visible_width(const char *s) {
+    size_t w = 0;
+    while (*s) {
+        if (*s == '\033' && s[1] == '[') {
+            s += 2;
+            while (*s && !(*s >= '@' && *s <= '~')) s++;
+            if (*s) s++;
+            continue;
+        }
+        if (((unsigned char)*s & 0xc0) != 0x80) w++;
+        s++;
+    }
+    return w;
+}
+
+static void write_all(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void refresh_line(LineState *ls) {
+    char out[8192];
+    size_t n = 0;
+
+    /* Slide the visible window so the cursor stays on screen */
+    size_t avail = ls->cols > (int)ls->prompt_width + 1 ? ls->cols - ls->prompt_width - 1 : 1;
+    size_t start = ls->pos >= avail ? ls->pos - avail + 1 : 0;
+    size_t shown = ls->len - start < avail ? ls->len - start : avail;
+
+    n += snprintf(out + n, sizeof(out) - n, "\r%s", ls->prompt);
+    if (n + shown + 32 < sizeof(out)) {
+        memcpy(out + n, ls->buf + start, shown);
+        n += shown;
+    }
+    n += snprintf(out + n, sizeof(out) - n, "\033[0K\r");
+    size_t col = ls->prompt_width + (ls->pos - start);
+    if (col > 0 && n < sizeof(out)) {
+        n += snprintf(out + n, sizeof(out) - n, "\033[%zuC", col);
+    }
+    write_all(out, n < sizeof(out) ? n : sizeof(out) - 1);
+}
+
+static void insert_text(LineState *ls, const char *text, size_t n) {
+    if (ls->len + n >= ls->size) n = ls->size - 1 - ls->len;
+    memmove(ls->buf + ls->pos + n, ls->buf + ls->pos, ls->len - ls->pos);
+    memcpy(ls->buf + ls->pos, text, n);
+    ls->pos += n;
+    ls->len += n;
+    ls->buf[ls->len] = '\0';
+}
+
+static void delete_range(LineState *ls, size_t from, size_t to) {
+    memmove(ls->buf + from, ls->buf + to, ls->len - to);
+    ls->len -= to - from;
+    ls->buf[ls->len] = '\0';
+    if (ls->pos > to) ls->pos -= to - from;
+    else if (ls->pos > from) ls->pos = from;
+}
+
+/* Print candidates in columns below the line, like bash's second Tab */
+static void list_candidates(LineState *ls, const CompletionList *list, size_t word_len) {
+    /* Show names relative to the directory being completed */
+    size_t skip = 0;
+    for (size_t i = 0; i < word_len; i++) {
+        if (ls->buf[ls->pos - word_len + i] == '/') skip = i + 1;
+    }
+
+    int shown = list->nitems < MAX_LISTED ? list->nitems : MAX_LISTED;
+    size_t width = 0;
+    for (int i = 0; i < shown; i++) {
+        size_t w = strlen(list->items[i]) - skip;
+        if (w > width) width = w;
+    }
+    width += 2;
+    int per_row = ls->cols / (int)width;
+    if (per_row < 1) per_row = 1;
+    int rows = (shown + per_row - 1) / per_row;
+
+    char *out = malloc((size_t)rows * (per_row * width + 4) + 128);
+    if (!out) return;
+    size_t n = 0;
+    out[n++] = '\r';
+    out[n++] = '\n';
+    for (int r = 0; r < rows; r++) {
+        for (int c = 0; c < per_row; c++) {
+            int i = c * rows + r;
+            if (i >= shown) break;
+            const char *name = list->items[i] + skip;
+            size_t w = strlen(name);
+            memcpy(out + n, name, w);
+            n += w;
+            if (c + 1 < per_row && (c + 1) * rows + r < shown) {
+                memset(out + n, ' ', width - w);
+                n += width - w;
+            }
+        }
+        out[n++] = '\r';
+        out[n++] = '\n';
+    }
+    if (list->count > shown) {
+        n += sprintf(out + n, "... and %d more\r\n", list->count - shown);
+    }
+    write_all(out, n);
+    free(out);
+}
+
+/* Tab: insert the single match or the longest common prefix; on a repeated
+ * Tab with nothing to add, list the candidates */
+static void complete_line(LineState *ls, int repeated) {
+    size_t start = ls->pos;
+    while (start > 0 && ls->buf[start - 1] != ' ' && ls->buf[start - 1] != '\t') start--;
+    size_t word_len = ls->pos - start;
+
+    CompletionList list = { 0 };
+    complete_word(ls->buf, (int)start, (int)ls->pos, 0, &list);
+    if (list.count == 0) {
+        write_all("\a", 1);
+        return;
+    }
+
+    size_t common_len = strlen(list.common);
+    if (common_len > word_len || list.count == 1) {
+        delete_range(ls, start, ls->pos);
+        insert_text(ls, list.common, common_len);
+        if (list.count == 1 && common_len > 0 && list.common[common_len - 1] != '/') {
+            insert_text(ls, " ", 1);
+        }
+        refresh_line(ls);
+        return;
+    }
+
+    if (!repeated) {
+        write_all("\a", 1);
+        return;
+    }
+    complete_word(ls->buf, (int)start, (int)ls->pos, 1, &list);
+    list_candidates(ls, &list, word_len);
+    completion_list_free(&list);
+    refresh_line(ls);
+}
+
+/* Read the rest of an escape sequence and return a key code, 0 if unknown */
+enum { KEY_LEFT = 1000, KEY_RIGHT, KEY_HOME, KEY_END, KEY_DELETE };
+
+static int read_escape(void) {
+    char seq[3];
+    if (read(STDIN_FILENO, &seq[0], 1) != 1) return 0;
+    if (read(STDIN_FILENO, &seq[1], 1) != 1) return 0;
+
+    if (seq[0] == '[') {
+        if (seq[1] >= '0' && seq[1] <= '9') {
+            if (read(STDIN_FILENO, &seq[2], 1) != 1 || seq[2] != '~') return 0;
+            switch (seq[1]) {
+            case '1': case '7': return KEY_HOME;
+            case '4': case '8': return KEY_END;
+            case '3': return KEY_DELETE;
+            }
+            return 0;
+        }
+        switch (seq[1]) {
+        case 'C': return KEY_RIGHT;
+        case 'D': return KEY_LEFT;
+        case 'H': return KEY_HOME;
+        case 'F': return KEY_END;
+        }
+    } else if (seq[0] == 'O') {
+        if (seq[1] == 'H') return KEY_HOME;
+        if (seq[1] == 'F') return KEY_END;
+    }
+    return 0;
+}
+
+static int edit_raw(LineState *ls) {
+    int last_was_tab = 0;
+
+    refresh_line(ls);
+    for (;;) {
+        char c;
+        ssize_t n = read(STDIN_FILENO, &c, 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return ls->len > 0 ? (int)ls->len : -1;
+
+        int key = (unsigned char)c;
+        if (key == 27) key = read_escape();
+        int is_tab = key == '\t';
+
+        switch (key) {
+        case '\r':
+        case '\n':
+            write_all("\r\n", 2);
+            return (int)ls->len;
+        case '\t':
+            complete_line(ls, last_was_tab);
+            break;
+        case 3:     /* Ctrl-C */
+            write_all("^C\r\n", 4);
+            ls->len = ls->pos = 0;
+            ls->buf[0] = '\0';
+            return 0;
+        case 4:     /* Ctrl-D */
+            if (ls->len == 0) {
+                write_all("\r\n", 2);
+                return -1;
+            }
+            /* fall through */
+        case KEY_DELETE:
+            if (ls->pos < ls->len) delete_range(ls, ls->pos, ls->pos + 1);
+            refresh_line(ls);
+            break;
+        case 127:
+        case 8:     /* Backspace */
+            if (ls->pos > 0) delete_range(ls, ls->pos - 1, ls->pos);
+            refresh_line(ls);
+            break;
+        case 2:     /* Ctrl-B */
+        case KEY_LEFT:
+            if (ls->pos > 0) ls->pos--;
+            refresh_line(ls);
+            break;
+        case 6:     /* Ctrl-F */
+        case KEY_RIGHT:
+            if (ls->pos < ls->len) ls->pos++;
+            refresh_line(ls);
+            break;
+        case 1:     /* Ctrl-A */
+        case KEY_HOME:
+            ls->pos = 0;
+            refresh_line(ls);
+            break;
+        case 5:     /* Ctrl-E */
+        case KEY_END:
+            ls->pos = ls->len;
+            refresh_line(ls);
+            break;
+        case 21:    /* Ctrl-U */
+            delete_range(ls, 0, ls->pos);
+            refresh_line(ls);
+            break;
+        case 11:    /* Ctrl-K */
+            delete_range(ls, ls->pos, ls->len);
+            refresh_line(ls);
+            break;
+        case 23: {  /* Ctrl-W */
+            size_t from = ls->pos;
+            while (from > 0 && ls->buf[from - 1] == ' ') from--;
+            while (from > 0 && ls->buf[from - 1] != ' ') from--;
+            delete_range(ls, from, ls->pos);
+            refresh_line(ls);
+            break;
+        }
+        case 12:    /* Ctrl-L */
+            write_all("\033[H\033[2J", 7);
+            refresh_line(ls);
+            break;
+        default:
+            if (key >= 32 && key < 256 && key != 127) {
+                insert_text(ls, &c, 1);
+                refresh_line(ls);
+            }
+            break;
+        }
+        last_was_tab = is_tab;
+    }
+}
+
+/* Not a terminal (or raw mode unavailable): plain line-buffered read */
+static int read_plain(const char *prompt, char *buf, size_t size) {
+    fputs(prompt, stdout);
+    fflush(stdout);
+    if (fgets(buf, (int)size, stdin) == NULL) return -1;
+    buf[strcspn(buf, "\n")] = '\0';
+    return (int)strlen(buf);
+}
+
+int line_edit(const char *prompt, char *buf, size_t size) {
+    if (size == 0) return -1;
+    buf[0] = '\0';
+
+    if (!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO)) {
+        return read_plain(prompt, buf, size);
+    }
+    fflush(stdout);
+    if (enable_raw_mode() != 0) {
+        return read_plain(prompt, buf, size);
+    }
+
+    LineState ls = { buf, size, 0, 0, prompt, visible_width(prompt), terminal_columns() };
+    int len = edit_raw(&ls);
+    disable_raw_mode();
+    return len;
+}
@@ -0,0 +1,14 @@
+// line_editor.h
+// Interactive line input: raw-mode editing with Tab completion when stdin is
+// a terminal, plain fgets otherwise (pipes, the GUI front ends, scripts).
+
+#ifndef LINE_EDITOR_H
+#define LINE_EDITOR_H
+
+#include <stddef.h>
+
+/* Print prompt and read one line into buf (without the newline).
+ * Returns the line length, or -1 on end of input. */
+int line_edit(const char *prompt, char *buf, size_t size);
+
+#endif // LINE_EDITOR_H
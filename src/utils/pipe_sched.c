@@ -0,0 +1,217 @@
+// pipe_sched.c
+// Pipeline scheduling settings (see pipe_sched.h). "adjacent" affinity
+// orders the CPUs this process may use by the L3 and L2 cache they sit
+// on, read from /sys/devices/system/cpu/cpuN/cache, so stage i and stage
+// i+1 land on CPUs that share a cache where possible.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "pipe_sched.h"
+
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+/* "1M", "512K", "65536"; -1 if malformed */
+static long parse_size(const char *s) {
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (end == s || v <= 0 || errno != 0) return -1;
+    if (*end == 'K' || *end == 'k') {
+        v <<= 10;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        v <<= 20;
+        end++;
+    }
+    return *end == '\0' && v <= (1L << 30) ? v : -1;
+}
+
+static int read_int_file(const char *path, int *value) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) return -1;
+    int ok = fscanf(f, "%d", value) == 1;
+    fclose(f);
+    return ok ? 0 : -1;
+}
+
+typedef struct {
+    int cpu;
+    int l3, l2;          /* cache ids, -1 when unknown */
+} CpuPlace;
+
+static int cmp_place(const void *a, const void *b) {
+    const CpuPlace *x = a, *y = b;
+    if (x->l3 != y->l3) return x->l3 < y->l3 ? -1 : 1;
+    if (x->l2 != y->l2) return x->l2 < y->l2 ? -1 : 1;
+    return x->cpu - y->cpu;
+}
+
+/* Allowed CPUs, neighbours sharing caches next to each other */
+static int adjacent_cpus(int *cpus, int max) {
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return 0;
+    CpuPlace places[PIPE_SCHED_MAX_CPUS];
+    int n = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE && n < max; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        CpuPlace *p = &places[n++];
+        p->cpu = cpu;
+        p->l3 = p->l2 = -1;
+        for (int k = 0; k < 8; k++) {
+            char path[128];
+            int level, id;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/level", cpu, k);
+            if (read_int_file(path, &level) != 0) break;
+            snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cache/index%d/id", cpu, k);
+            if (read_int_file(path, &id) != 0) continue;
+            if (level == 2) p->l2 = id;
+            else if (level == 3) p->l3 = id;
+        }
+    }
+    qsort(places, (size_t)n, sizeof(CpuPlace), cmp_place);
+    for (int i = 0; i < n; i++) cpus[i] = places[i].cpu;
+    return n;
+}
+
+/* "0-3,8" */
+static int parse_cpu_list(const char *s, int *cpus, int max) {
+    int n = 0;
+    while (*s != '\0') {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s || lo < 0) return -1;
+        if (*end == '-') {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s || hi < lo) return -1;
+        }
+        for (long c = lo; c <= hi && n < max; c++) cpus[n++] = (int)c;
+        if (*end == ',') end++;
+        else if (*end != '\0') return -1;
+        s = end;
+    }
+    return n;
+}
+
+/* "be:4" / "idle" / "rt:0" -> ioprio value; 0 on success */
+static int parse_ioprio(const char *s, size_t len, int *value) {
+    static const struct {
+        const char *name;
+        int cls;
+    } classes[] = { { "rt", 1 }, { "be", 2 }, { "idle", 3 } };
+    size_t name_len = len;
+    const char *colon = memchr(s, ':', len);
+    int level = 4;
+    if (colon != NULL) {
+        name_len = (size_t)(colon - s);
+        if (colon + 2 != s + len || colon[1] < '0' || colon[1] > '7') return -1;
+        level = colon[1] - '0';
+    }
+    for (size_t i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+        if (strlen(classes[i].name) == name_len && strncmp(s, classes[i].name, name_len) == 0) {
+            *value = classes[i].cls << IOPRIO_CLASS_SHIFT | (classes[i].cls == 3 ? 0 : level);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* "-5" .. "19"; 0 on success */
+static int parse_nice(const char *s, size_t len, int *value) {
+    char buf[16];
+    char *end;
+    if (len == 0 || len >= sizeof(buf)) return -1;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    long v = strtol(buf, &end, 10);
+    if (*end != '\0' || v < -20 || v > 19) return -1;
+    *value = (int)v;
+    return 0;
+}
+
+/* Comma-separated per-stage list, each item through parse; the number of
+ * items, or -1 if one is malformed */
+static int parse_stage_list(const char *s, int *out, int (*parse)(const char *, size_t, int *)) {
+    int n = 0;
+    while (n < PIPE_SCHED_MAX_STAGES) {
+        size_t len = strcspn(s, ",");
+        if (parse(s, len, &out[n]) != 0) return -1;
+        n++;
+        if (s[len] == '\0') break;
+        s += len + 1;
+    }
+    return n;
+}
+
+int pipe_sched_load(PipeSched *ps, const char *(*get)(const char *name)) {
+    const char *buffer = get("PIPE_BUFFER"), *affinity = get("PIPE_AFFINITY");
+    const char *nice = get("PIPE_NICE"), *ioprio = get("PIPE_IOPRIO");
+    ps->pipe_size = 0;
+    ps->ncpus = ps->nnice = ps->nioprio = 0;
+
+    if (buffer != NULL && *buffer != '\0') {
+        long size = parse_size(buffer);
+        if (size < 0) fprintf(stderr, "PIPE_BUFFER: invalid size '%s'\n", buffer);
+        else ps->pipe_size = (int)size;
+    }
+    if (affinity != NULL && *affinity != '\0') {
+        ps->ncpus = strcmp(affinity, "adjacent") == 0
+                        ? adjacent_cpus(ps->cpus, PIPE_SCHED_MAX_CPUS)
+                        : parse_cpu_list(affinity, ps->cpus, PIPE_SCHED_MAX_CPUS);
+        if (ps->ncpus < 0) {
+            fprintf(stderr, "PIPE_AFFINITY: expected 'adjacent' or a CPU list, got '%s'\n", affinity);
+            ps->ncpus = 0;
+        }
+    }
+    if (nice != NULL && *nice != '\0') {
+        ps->nnice = parse_stage_list(nice, ps->nice, parse_nice);
+        if (ps->nnice < 0) {
+            fprintf(stderr, "PIPE_NICE: expected values from -20 to 19, got '%s'\n", nice);
+            ps->nnice = 0;
+        }
+    }
+    if (ioprio != NULL && *ioprio != '\0') {
+        ps->nioprio = parse_stage_list(ioprio, ps->ioprio, parse_ioprio);
+        if (ps->nioprio < 0) {
+            fprintf(stderr, "PIPE_IOPRIO: expected rt|be|idle[:0-7] per stage, got '%s'\n", ioprio);
+            ps->nioprio = 0;
+        }
+    }
+    return ps->pipe_size > 0 || ps->ncpus > 0 || ps->nnice > 0 || ps->nioprio > 0;
+}
+
+void pipe_sched_pipe(const PipeSched *ps, int fd) {
+    if (ps->pipe_size <= 0) return;
+    if (fcntl(fd, F_SETPIPE_SZ, ps->pipe_size) >= 0) return;
+    /* Unprivileged users are capped at fs/pipe-max-size: use the cap */
+    int max;
+    if (errno == EPERM && read_int_file("/proc/sys/fs/pipe-max-size", &max) == 0 && max < ps->pipe_size) {
+        fcntl(fd, F_SETPIPE_SZ, max);
+    }
+}
+
+void pipe_sched_stage(const PipeSched *ps, int stage) {
+    if (ps->ncpus > 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(ps->cpus[stage % ps->ncpus], &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) perror("PIPE_AFFINITY");
+    }
+    if (ps->nnice > 0) {
+        int value = ps->nice[stage < ps->nnice ? stage : ps->nnice - 1];
+        if (setpriority(PRIO_PROCESS, 0, value) != 0) perror("PIPE_NICE");
+    }
+    if (ps->nioprio > 0) {
+        int value = ps->ioprio[stage < ps->nioprio ? stage : ps->nioprio - 1];
+        if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, value) != 0) perror("PIPE_IOPRIO");
+    }
+}
@@ -0,0 +1,45 @@
+// pipe_sched.h
+// Per-pipeline scheduling settings, read when a pipeline starts from
+// PIPE_* prefixes on its first command, else from shell variables (or the
+// environment):
+//
+//   PIPE_BUFFER=1M            size of every pipe between stages (F_SETPIPE_SZ;
+//                             K/M suffixes, capped at fs/pipe-max-size)
+//   PIPE_AFFINITY=adjacent    pin stage i to the i-th allowed CPU in cache
+//                             order, so neighbouring stages share L2/L3
+//   PIPE_AFFINITY=0-3,8       pin stage i to the i-th CPU of the list
+//   PIPE_NICE=0,5,10          nice value per stage (the last one repeats)
+//   PIPE_IOPRIO=be:4,idle     I/O class[:level] per stage (rt, be, idle)
+//
+// e.g.  PIPE_BUFFER=1M PIPE_AFFINITY=adjacent cat big.log | gzip | wc -c
+//       (prefixes: this pipeline only; `PIPE_BUFFER=1M;` alone sets it for
+//       every later pipeline)
+
+#ifndef PIPE_SCHED_H
+#define PIPE_SCHED_H
+
+#define PIPE_SCHED_MAX_CPUS 256
+#define PIPE_SCHED_MAX_STAGES 32
+
+typedef struct {
+    int pipe_size;       /* bytes; 0 = kernel default */
+    int cpus[PIPE_SCHED_MAX_CPUS];
+    int ncpus;           /* 0 = no pinning */
+    int nice[PIPE_SCHED_MAX_STAGES];
+    int nnice;
+    int ioprio[PIPE_SCHED_MAX_STAGES];   /* ioprio_set values */
+    int nioprio;
+} PipeSched;
+
+/* Fill ps from the PIPE_* settings, looked up with get. Returns 1 when any
+ * is set, 0 when the pipeline runs with defaults. Malformed values are
+ * reported and ignored. */
+int pipe_sched_load(PipeSched *ps, const char *(*get)(const char *name));
+
+/* Apply PIPE_BUFFER to a new pipe (either end) */
+void pipe_sched_pipe(const PipeSched *ps, int fd);
+
+/* Apply affinity, nice and I/O priority for stage in the forked child */
+void pipe_sched_stage(const PipeSched *ps, int stage);
+
+#endif // PIPE_SCHED_H
@@ -0,0 +1,109 @@
+// session_log.c
+// Session recording and replay (format in session_log.h). Records are
+// flushed one at a time so a session that ends abruptly still leaves a
+// usable file.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "session_log.h"
+
+#define SESSION_MAGIC "TRS1"
+#define SESSION_MAX_LINE (16 * 1024 * 1024)
+
+struct SessionLog {
+    FILE *f;
+    unsigned long long last_us;  /* recording: time of the previous record */
+    char *line;                  /* replay: current record */
+    size_t cap;
+};
+
+static unsigned long long now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ull + (unsigned long long)ts.tv_nsec / 1000;
+}
+
+static void put_varint(FILE *f, unsigned long long v) {
+    while (v >= 0x80) {
+        putc((int)(v & 0x7f) | 0x80, f);
+        v >>= 7;
+    }
+    putc((int)v, f);
+}
+
+static int get_varint(FILE *f, unsigned long long *v) {
+    *v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = getc(f);
+        if (c == EOF) return shift == 0 ? 0 : -1;
+        *v |= (unsigned long long)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return 1;
+    }
+    return -1;
+}
+
+SessionLog *session_record_open(const char *path) {
+    SessionLog *log = calloc(1, sizeof(SessionLog));
+    if (log == NULL || (log->f = fopen(path, "wb")) == NULL) {
+        perror(path);
+        free(log);
+        return NULL;
+    }
+    fputs(SESSION_MAGIC, log->f);
+    fflush(log->f);
+    log->last_us = now_us();
+    return log;
+}
+
+int session_record(SessionLog *log, const char *command) {
+    unsigned long long t = now_us();
+    size_t len = strlen(command);
+    put_varint(log->f, t - log->last_us);
+    put_varint(log->f, len);
+    fwrite(command, 1, len, log->f);
+    log->last_us = t;
+    return fflush(log->f) == 0 && !ferror(log->f) ? 0 : -1;
+}
+
+SessionLog *session_replay_open(const char *path) {
+    SessionLog *log = calloc(1, sizeof(SessionLog));
+    char magic[4];
+    if (log == NULL || (log->f = fopen(path, "rb")) == NULL) {
+        perror(path);
+        free(log);
+        return NULL;
+    }
+    if (fread(magic, 1, 4, log->f) != 4 || memcmp(magic, SESSION_MAGIC, 4) != 0) {
+        fprintf(stderr, "%s: not a recorded session\n", path);
+        session_log_close(log);
+        return NULL;
+    }
+    return log;
+}
+
+int session_replay_next(SessionLog *log, const char **command, unsigned long long *delay_us) {
+    unsigned long long len;
+    int rc = get_varint(log->f, delay_us);
+    if (rc <= 0) return rc;
+    if (get_varint(log->f, &len) != 1 || len > SESSION_MAX_LINE) return -1;
+    if (len + 1 > log->cap) {
+        char *line = realloc(log->line, len + 1);
+        if (line == NULL) return -1;
+        log->line = line;
+        log->cap = len + 1;
+    }
+    if (fread(log->line, 1, len, log->f) != len) return -1;
+    log->line[len] = '\0';
+    *command = log->line;
+    return 1;
+}
+
+void session_log_close(SessionLog *log) {
+    if (log == NULL) return;
+    if (log->f != NULL) fclose(log->f);
+    free(log->line);
+    free(log);
+}
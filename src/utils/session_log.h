@@ -0,0 +1,32 @@
+// session_log.h
+// Recorded sessions: the command lines of an interactive session with the
+// time between them, for replaying later as a realistic workload (the
+// training run of `make pgo`).
+//
+// File format: the magic "TRS1", then one record per command line:
+// varint microseconds since the previous record, varint length, and the
+// line itself (here-document bodies included, so it may contain '\n').
+// Varints are 7 bits per byte, low bits first, high bit = more.
+
+#ifndef SESSION_LOG_H
+#define SESSION_LOG_H
+
+typedef struct SessionLog SessionLog;
+
+/* Start a new recording at path (truncated); NULL with a message on error */
+SessionLog *session_record_open(const char *path);
+
+/* Append one command line; 0 on success */
+int session_record(SessionLog *log, const char *command);
+
+/* Open a recording for reading; NULL with a message on error */
+SessionLog *session_replay_open(const char *path);
+
+/* Next recorded line (valid until the next call) and the delay before it
+ * in microseconds. Returns 1, 0 at the end, -1 if the file is corrupt. */
+int session_replay_next(SessionLog *log, const char **command, unsigned long long *delay_us);
+
+/* Finish a recording or a replay */
+void session_log_close(SessionLog *log);
+
+#endif // SESSION_LOG_H
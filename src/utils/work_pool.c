@@ -0,0 +1,184 @@
+// work_pool.c
+// Work-stealing pool. Deques are small mutex-protected rings: the owner
+// pushes and pops at the tail, thieves take from the head, so a worker
+// keeps walking down its own subtree while idle workers take the oldest
+// (largest) pending subtrees from the others.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "work_pool.h"
+
+#define MAX_WORKERS 64
+
+typedef struct {
+    pthread_mutex_t lock;
+    void **items;
+    size_t head;         /* next to steal */
+    size_t count;
+    size_t cap;
+} Deque;
+
+typedef struct {
+    WorkPool *pool;
+    int id;
+} WorkerArg;
+
+struct WorkPool {
+    int nworkers;
+    WorkFn fn;
+    void *ctx;
+    Deque deques[MAX_WORKERS];
+    pthread_t threads[MAX_WORKERS];
+    WorkerArg args[MAX_WORKERS];
+    int started;
+    atomic_int closing;      /* set by work_pool_finish */
+    atomic_long pending;     /* pushed but not yet fully processed */
+    atomic_int idle;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+int work_pool_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n < 1) return 1;
+    return n > MAX_WORKERS ? MAX_WORKERS : (int)n;
+}
+
+WorkPool *work_pool_new(int nworkers, WorkFn fn, void *ctx) {
+    WorkPool *pool = calloc(1, sizeof(WorkPool));
+    if (!pool) return NULL;
+    if (nworkers < 1) nworkers = 1;
+    if (nworkers > MAX_WORKERS) nworkers = MAX_WORKERS;
+    pool->nworkers = nworkers;
+    pool->fn = fn;
+    pool->ctx = ctx;
+    for (int i = 0; i < nworkers; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    return pool;
+}
+
+int work_pool_push(WorkPool *pool, int worker, void *task) {
+    Deque *d = &pool->deques[worker];
+    pthread_mutex_lock(&d->lock);
+    if (d->count == d->cap) {
+        size_t cap = d->cap ? d->cap * 2 : 64;
+        void **items = malloc(cap * sizeof(void *));
+        if (!items) {
+            pthread_mutex_unlock(&d->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < d->count; i++) {
+            items[i] = d->items[(d->head + i) % d->cap];
+        }
+        free(d->items);
+        d->items = items;
+        d->head = 0;
+        d->cap = cap;
+    }
+    d->items[(d->head + d->count) % d->cap] = task;
+    d->count++;
+    atomic_fetch_add(&pool->pending, 1);
+    pthread_mutex_unlock(&d->lock);
+
+    if (atomic_load(&pool->idle) > 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return 0;
+}
+
+static void *take(Deque *d, int own) {
+    void *task = NULL;
+    pthread_mutex_lock(&d->lock);
+    if (d->count > 0) {
+        if (own) {
+            task = d->items[(d->head + d->count - 1) % d->cap];
+        } else {
+            task = d->items[d->head];
+            d->head = (d->head + 1) % d->cap;
+        }
+        d->count--;
+    }
+    pthread_mutex_unlock(&d->lock);
+    return task;
+}
+
+static void *find_work(WorkPool *pool, int id) {
+    void *task = take(&pool->deques[id], 1);
+    for (int i = 1; !task && i < pool->nworkers; i++) {
+        task = take(&pool->deques[(id + i) % pool->nworkers], 0);
+    }
+    return task;
+}
+
+static void *worker_main(void *arg) {
+    WorkerArg *wa = arg;
+    WorkPool *pool = wa->pool;
+
+    for (;;) {
+        void *task = find_work(pool, wa->id);
+        if (task) {
+            pool->fn(pool, wa->id, task, pool->ctx);
+            atomic_fetch_sub(&pool->pending, 1);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->idle_lock);
+        if (atomic_load(&pool->closing) && atomic_load(&pool->pending) == 0) {
+            pthread_mutex_unlock(&pool->idle_lock);
+            break;
+        }
+        /* Timed so a push that raced with going idle is picked up */
+        atomic_fetch_add(&pool->idle, 1);
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        ts.tv_nsec += 1000000;
+        if (ts.tv_nsec >= 1000000000) {
+            ts.tv_sec++;
+            ts.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&pool->idle_cond, &pool->idle_lock, &ts);
+        atomic_fetch_sub(&pool->idle, 1);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+    return NULL;
+}
+
+int work_pool_start(WorkPool *pool) {
+    for (int i = 0; i < pool->nworkers; i++) {
+        pool->args[i].pool = pool;
+        pool->args[i].id = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->args[i]) != 0) {
+            if (i == 0) return -1;
+            /* Fewer threads still drain every deque by stealing */
+            break;
+        }
+        pool->started = i + 1;
+    }
+    return 0;
+}
+
+void work_pool_finish(WorkPool *pool) {
+    pthread_mutex_lock(&pool->idle_lock);
+    atomic_store(&pool->closing, 1);
+    pthread_cond_broadcast(&pool->idle_cond);
+    pthread_mutex_unlock(&pool->idle_lock);
+    for (int i = 0; i < pool->started; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    for (int i = 0; i < pool->nworkers; i++) {
+        free(pool->deques[i].items);
+        pthread_mutex_destroy(&pool->deques[i].lock);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    free(pool);
+}
@@ -0,0 +1,31 @@
+// work_pool.h
+// Work-stealing thread pool for tree-shaped jobs (directory walks): each
+// worker keeps its own deque, takes new work from its own end (depth first)
+// and steals from the other end of a busy worker's deque when it runs dry.
+// Workers sleep while there is nothing to do and exit once the pool is
+// finished and every pushed task has been processed.
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+typedef struct WorkPool WorkPool;
+
+/* Called on a worker thread for every task; may push more tasks */
+typedef void (*WorkFn)(WorkPool *pool, int worker, void *task, void *ctx);
+
+WorkPool *work_pool_new(int nworkers, WorkFn fn, void *ctx);
+
+/* Queue a task on the given worker's deque (worker 0 from outside the
+ * pool). Returns 0, or -1 if the task could not be queued. */
+int work_pool_push(WorkPool *pool, int worker, void *task);
+
+/* Start the worker threads (returns immediately); -1 if none started */
+int work_pool_start(WorkPool *pool);
+
+/* Wait for all tasks and threads to finish, then free the pool */
+void work_pool_finish(WorkPool *pool);
+
+/* Number of online CPUs, at least 1 */
+int work_pool_cpus(void);
+
+#endif // WORK_POOL_H